@@ -0,0 +1,646 @@
+/*
+https://github.com/jpcy/objzero
+
+Copyright (c) 2018 Jonathan Young
+
+The MIT License (MIT)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+/*
+Usage: benchmark [file.obj]
+A large obj file is generated if one isn't given.
+*/
+#include "objzero.c" // First, it sets feature test macros.
+#include <stdio.h>
+#include <time.h>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define BENCHMARK_REPEAT 5
+
+static double getTime() {
+#ifdef _WIN32
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return counter.QuadPart / (double)frequency.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+static double megabytesPerSecond(size_t _bytes, double _seconds) {
+	return _bytes / (1024.0 * 1024.0) / _seconds;
+}
+
+typedef struct {
+	char *data;
+	size_t length, capacity;
+} Buffer;
+
+static void bufferPrintf(Buffer *_buffer, const char *_format, ...) {
+	if (_buffer->capacity - _buffer->length < 256) {
+		_buffer->capacity = OBJZ_LARGEST(_buffer->capacity * 2, 1024);
+		_buffer->data = realloc(_buffer->data, _buffer->capacity);
+	}
+	va_list args;
+	va_start(args, _format);
+	_buffer->length += (size_t)vsnprintf(&_buffer->data[_buffer->length], _buffer->capacity - _buffer->length, _format, args);
+	va_end(args);
+}
+
+// A grid of quads with positions, texcoords and normals. Without normals, they are generated from smoothing group 1.
+static Buffer generateObj(uint32_t _gridSize, bool _normals) {
+	Buffer buffer = { 0 };
+	bufferPrintf(&buffer, "o grid\n");
+	for (uint32_t y = 0; y <= _gridSize; y++) {
+		for (uint32_t x = 0; x <= _gridSize; x++) {
+			bufferPrintf(&buffer, "v %f %f %f\n", x * 0.1f, y * 0.1f, ((x * 7 + y * 13) % 100) * 0.001f);
+			bufferPrintf(&buffer, "vt %f %f\n", x / (float)_gridSize, y / (float)_gridSize);
+			if (_normals)
+				bufferPrintf(&buffer, "vn %f %f %f\n", 0.0f, 0.0f, 1.0f);
+		}
+	}
+	if (!_normals)
+		bufferPrintf(&buffer, "s 1\n");
+	for (uint32_t y = 0; y < _gridSize; y++) {
+		for (uint32_t x = 0; x < _gridSize; x++) {
+			const uint32_t a = y * (_gridSize + 1) + x + 1, b = a + 1, c = a + _gridSize + 2, d = a + _gridSize + 1;
+			if (_normals)
+				bufferPrintf(&buffer, "f %u/%u/%u %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, c, c, c, d, d, d);
+			else
+				bufferPrintf(&buffer, "f %u/%u %u/%u %u/%u %u/%u\n", a, a, b, b, c, c, d, d);
+		}
+	}
+	return buffer;
+}
+
+static Buffer readFile(const char *_filename) {
+	Buffer buffer = { 0 };
+	FILE *f;
+	OBJZ_FOPEN(f, _filename, "rb");
+	if (!f)
+		return buffer;
+	fseek(f, 0, SEEK_END);
+	buffer.length = buffer.capacity = (size_t)ftell(f);
+	fseek(f, 0, SEEK_SET);
+	buffer.data = malloc(buffer.length);
+	if (fread(buffer.data, 1, buffer.length, f) != buffer.length)
+		buffer.length = 0;
+	fclose(f);
+	return buffer;
+}
+
+// Byte at a time line scanning and tokens copied into a fixed size buffer, for comparison.
+static const char *scalarReadLine(File *_file, size_t *_length) {
+	if (_file->pos >= _file->length)
+		return NULL;
+	const char *start = &_file->buffer[_file->pos];
+	size_t length = 0;
+	while (_file->pos < _file->length && _file->buffer[_file->pos] != '\n') {
+		_file->pos++;
+		length++;
+	}
+	_file->pos++;
+	if (length > 0 && start[length - 1] == '\r')
+		length--;
+	*_length = length;
+	return start;
+}
+
+typedef struct {
+	const char *buf;
+	const char *end;
+	uint32_t line, column;
+} ScalarLexer;
+
+typedef struct {
+	char text[256];
+	uint32_t line, column;
+} ScalarToken;
+
+static void scalarTokenize(ScalarLexer *_lexer, ScalarToken *_token) {
+	uint32_t i = 0;
+	while (_lexer->buf < _lexer->end && isWhitespaceChar(_lexer->buf[0])) {
+		_lexer->buf++;
+		_lexer->column++;
+	}
+	_token->line = _lexer->line;
+	_token->column = _lexer->column;
+	while (_lexer->buf < _lexer->end && !isWhitespaceChar(_lexer->buf[0])) {
+		if (i < sizeof(_token->text) - 1)
+			_token->text[i++] = _lexer->buf[0];
+		_lexer->buf++;
+		_lexer->column++;
+	}
+	_token->text[i] = 0;
+}
+
+static uint32_t scanScalar(const char *_data, size_t _length) {
+	File file;
+	fileOpenMemory(&file, _data, _length);
+	ScalarLexer lexer;
+	lexer.line = 0;
+	ScalarToken token;
+	uint32_t numTokens = 0;
+	for (;;) {
+		size_t lineLength;
+		const char *line = scalarReadLine(&file, &lineLength);
+		if (!line)
+			break;
+		lexer.buf = line;
+		lexer.end = line + lineLength;
+		lexer.line++;
+		lexer.column = 1;
+		for (;;) {
+			scalarTokenize(&lexer, &token);
+			if (!token.text[0])
+				break;
+			numTokens++;
+		}
+	}
+	return numTokens;
+}
+
+static uint32_t scan(const char *_data, size_t _length) {
+	File file;
+	fileOpenMemory(&file, _data, _length);
+	Lexer lexer;
+	initLexer(&lexer);
+	Token token;
+	uint32_t numTokens = 0;
+	for (;;) {
+		size_t lineLength;
+		const char *line = fileReadLine(&file, &lineLength);
+		if (!line)
+			break;
+		lexerSetLine(&lexer, line, lineLength, file.buffer + file.length);
+		for (;;) {
+			tokenize(&lexer, &token, false);
+			if (!token.length)
+				break;
+			numTokens++;
+		}
+	}
+	return numTokens;
+}
+
+static void benchmarkScan(const Buffer *_obj) {
+	double scalarTime = DBL_MAX, time = DBL_MAX;
+	uint32_t scalarTokens = 0, tokens = 0;
+	for (int i = 0; i < BENCHMARK_REPEAT; i++) {
+		double start = getTime();
+		scalarTokens = scanScalar(_obj->data, _obj->length);
+		scalarTime = OBJZ_SMALLEST(scalarTime, getTime() - start);
+		start = getTime();
+		tokens = scan(_obj->data, _obj->length);
+		time = OBJZ_SMALLEST(time, getTime() - start);
+	}
+	printf("Line and token scanning (%u tokens)\n", tokens);
+	if (tokens != scalarTokens)
+		printf("   [FAIL] scalar scanning found %u tokens\n", scalarTokens);
+	printf("   byte at a time: %.1f MB/s\n", megabytesPerSecond(_obj->length, scalarTime));
+	printf("   %s: %.1f MB/s (%.2fx)\n", OBJZ_SIMD_WIDTH == 32 ? "AVX2" : (OBJZ_SIMD_WIDTH == 16 ? "SSE2" : "scalar"), megabytesPerSecond(_obj->length, time), scalarTime / time);
+}
+
+// Typical obj values, e.g. -12.345678, and floats printed with enough digits to round trip.
+static void benchmarkFloats() {
+	Buffer text = { 0 };
+	const uint32_t count = 1000000;
+	uint32_t seed = 1;
+	for (uint32_t i = 0; i < count; i++) {
+		seed = seed * 1664525 + 1013904223;
+		const float f = (float)((int32_t)seed / 65536) * 0.001f;
+		bufferPrintf(&text, i & 1 ? "%.9g\n" : "%f\n", f);
+	}
+	double libcTime = DBL_MAX, time = DBL_MAX;
+	float libcSum = 0, sum = 0;
+	for (int i = 0; i < BENCHMARK_REPEAT; i++) {
+		double start = getTime();
+		libcSum = 0;
+		for (const char *s = text.data; s < text.data + text.length;) {
+			char *end;
+			libcSum += (float)strtod(s, &end);
+			s = end + 1;
+		}
+		libcTime = OBJZ_SMALLEST(libcTime, getTime() - start);
+		start = getTime();
+		sum = 0;
+		for (const char *s = text.data; s < text.data + text.length;) {
+			const char *end = memchr(s, '\n', (size_t)(text.data + text.length - s));
+			float value;
+			parseFloat(s, end, &value);
+			sum += value;
+			s = end + 1;
+		}
+		time = OBJZ_SMALLEST(time, getTime() - start);
+	}
+	printf("Float parsing (%u floats)\n", count);
+	if (sum != libcSum)
+		printf("   [FAIL] strtod sum %g, parseFloat sum %g\n", libcSum, sum);
+	printf("   strtod: %.1f MB/s, %.1f M floats/s\n", megabytesPerSecond(text.length, libcTime), count / libcTime * 1e-6);
+	printf("   parseFloat: %.1f MB/s, %.1f M floats/s (%.2fx)\n", megabytesPerSecond(text.length, time), count / time * 1e-6, libcTime / time);
+	free(text.data);
+}
+
+static void benchmarkLoad(const Buffer *_obj) {
+	double time = DBL_MAX;
+	for (int i = 0; i < BENCHMARK_REPEAT; i++) {
+		const double start = getTime();
+		objzModel *model = objz_loadFromMemory(_obj->data, _obj->length, NULL, NULL);
+		time = OBJZ_SMALLEST(time, getTime() - start);
+		if (!model) {
+			printf("[FAIL] %s\n", objz_getError());
+			return;
+		}
+		objz_destroy(model);
+	}
+	printf("objz_loadFromMemory: %.1f MB/s\n", megabytesPerSecond(_obj->length, time));
+}
+
+// Load a directory of small generated obj files, one at a time with objz_load, then with objz_loadBatch.
+static void benchmarkBatch() {
+	const uint32_t numFiles = 500;
+	const char *directory = "benchmark_batch";
+	char (*filenames)[64] = malloc(sizeof(*filenames) * numFiles);
+	size_t totalBytes = 0;
+#ifdef _WIN32
+	_mkdir(directory);
+#else
+	mkdir(directory, 0755);
+#endif
+	for (uint32_t i = 0; i < numFiles; i++) {
+		Buffer obj = generateObj(8 + i % 32, i & 1);
+		snprintf(filenames[i], sizeof(*filenames), "%s/%u.obj", directory, i);
+		FILE *f;
+		OBJZ_FOPEN(f, filenames[i], "wb");
+		if (f) {
+			fwrite(obj.data, 1, obj.length, f);
+			fclose(f);
+		}
+		totalBytes += obj.length;
+		free(obj.data);
+	}
+	printf("Batch (%u files, %.1f MB)\n", numFiles, totalBytes / (1024.0 * 1024.0));
+	double time = DBL_MAX;
+	for (int i = 0; i < BENCHMARK_REPEAT; i++) {
+		const double start = getTime();
+		for (uint32_t j = 0; j < numFiles; j++)
+			objz_destroy(objz_load(filenames[j]));
+		time = OBJZ_SMALLEST(time, getTime() - start);
+	}
+	printf("   objz_load: %.0f files/s, %.1f MB/s\n", numFiles / time, megabytesPerSecond(totalBytes, time));
+	objzBatchFile *files = calloc(numFiles, sizeof(objzBatchFile));
+	for (uint32_t numThreads = 1; numThreads <= 8; numThreads *= 2) {
+		time = DBL_MAX;
+		for (int i = 0; i < BENCHMARK_REPEAT; i++) {
+			for (uint32_t j = 0; j < numFiles; j++)
+				files[j].filename = filenames[j];
+			const double start = getTime();
+			const uint32_t numLoaded = objz_loadBatch(files, numFiles, numThreads);
+			time = OBJZ_SMALLEST(time, getTime() - start);
+			objz_destroyBatch(files, numFiles);
+			if (numLoaded != numFiles) {
+				printf("   [FAIL] %u of %u files loaded\n", numLoaded, numFiles);
+				break;
+			}
+		}
+		printf("   objz_loadBatch, %u thread%s: %.0f files/s, %.1f MB/s\n", numThreads, numThreads > 1 ? "s" : "", numFiles / time, megabytesPerSecond(totalBytes, time));
+	}
+	// Many small batches, e.g. streaming in assets as they're needed. Each call reuses the worker contexts of the last one.
+	const uint32_t batchSize = 10;
+	time = DBL_MAX;
+	for (int i = 0; i < BENCHMARK_REPEAT; i++) {
+		for (uint32_t j = 0; j < numFiles; j++)
+			files[j].filename = filenames[j];
+		const double start = getTime();
+		for (uint32_t j = 0; j < numFiles; j += batchSize)
+			objz_loadBatch(&files[j], OBJZ_SMALLEST(batchSize, numFiles - j), 4);
+		time = OBJZ_SMALLEST(time, getTime() - start);
+		objz_destroyBatch(files, numFiles);
+	}
+	printf("   objz_loadBatch, 4 threads, %u files per call: %.0f files/s, %.1f MB/s\n", batchSize, numFiles / time, megabytesPerSecond(totalBytes, time));
+	free(files);
+	for (uint32_t i = 0; i < numFiles; i++)
+		remove(filenames[i]);
+	free(filenames);
+#ifdef _WIN32
+	_rmdir(directory);
+#else
+	rmdir(directory);
+#endif
+}
+
+// The faces of a generated grid in a random order, like some exporters write them.
+static Buffer generateShuffledObj(uint32_t _gridSize) {
+	Buffer obj = generateObj(_gridSize, true);
+	const char **lines = malloc(sizeof(char *) * (obj.length / 8 + 1));
+	uint32_t numLines = 0, numFaces = 0;
+	for (char *line = strtok(obj.data, "\n"); line; line = strtok(NULL, "\n"))
+		lines[numLines++] = line;
+	for (uint32_t i = 0; i < numLines; i++) {
+		if (lines[i][0] == 'f')
+			numFaces++;
+	}
+	const char **faces = &lines[numLines - numFaces]; // Faces are last.
+	uint32_t random = 1;
+	for (uint32_t i = numFaces - 1; i > 0; i--) {
+		random = random * 1664525 + 1013904223;
+		const uint32_t j = (random >> 8) % (i + 1);
+		const char *swap = faces[i];
+		faces[i] = faces[j];
+		faces[j] = swap;
+	}
+	Buffer buffer = { 0 };
+	for (uint32_t i = 0; i < numLines; i++)
+		bufferPrintf(&buffer, "%s\n", lines[i]);
+	free(lines);
+	free(obj.data);
+	return buffer;
+}
+
+static void benchmarkVertexCache(const Buffer *_obj, const char *_name) {
+	objzModel *model = objz_loadFromMemory(_obj->data, _obj->length, NULL, NULL);
+	if (!model) {
+		printf("[FAIL] %s\n", objz_getError());
+		return;
+	}
+	const float before = objz_getACMR(model, 16);
+	const double start = getTime();
+	objz_optimizeVertexCache(model, 16);
+	const double time = getTime() - start;
+	printf("   %s (%u triangles): ACMR %.3f -> %.3f, %.1f ms, %.1f M triangles/s\n", _name, model->numIndices / 3, before, objz_getACMR(model, 16), time * 1000.0, model->numIndices / 3 / time * 1e-6);
+	objz_destroy(model);
+}
+
+static uint32_t sdbmHash(const uint8_t *_data, uint32_t _size)
+{
+	uint32_t hash = 0;
+	for (uint32_t i = 0; i < _size; i++)
+		hash = (uint32_t)_data[i] + (hash << 6) + (hash << 16) - hash;
+	return hash;
+}
+
+// The previous vertex dedup table, for comparison: fixed number of slots, sdbm hash and chaining.
+typedef struct {
+	uint32_t key[4];
+	uint32_t next;
+} ChainedVertex;
+
+typedef struct {
+	uint32_t *slots;
+	uint32_t numSlots;
+	ChainedVertex *vertices;
+	uint32_t numVertices, capacity;
+} ChainedVertexHashMap;
+
+static uint32_t chainedVertexHashMapInsert(ChainedVertexHashMap *_map, const uint32_t *_key, uint64_t *_probes) {
+	uint32_t hashData[4];
+	for (int i = 0; i < 4; i++)
+		hashData[i] = _key[i] == UINT32_MAX ? 0 : _key[i];
+	const uint32_t hash = sdbmHash((const uint8_t *)hashData, sizeof(hashData)) % _map->numSlots;
+	(*_probes)++; // The slot, then each vertex in its chain.
+	for (uint32_t i = _map->slots[hash]; i != UINT32_MAX; i = _map->vertices[i].next) {
+		(*_probes)++;
+		if (memcmp(_map->vertices[i].key, _key, sizeof(hashData)) == 0)
+			return i;
+	}
+	if (_map->numVertices == _map->capacity) {
+		_map->capacity = OBJZ_LARGEST(_map->capacity * 2, 1024);
+		_map->vertices = realloc(_map->vertices, sizeof(ChainedVertex) * _map->capacity);
+	}
+	ChainedVertex *v = &_map->vertices[_map->numVertices];
+	memcpy(v->key, _key, sizeof(v->key));
+	v->next = _map->slots[hash];
+	_map->slots[hash] = _map->numVertices;
+	return _map->numVertices++;
+}
+
+// Same as vertexHashMapInsert, but only counts the slots looked at.
+static uint32_t countVertexHashMapProbes(const VertexHashMap *_map, const uint32_t *_key) {
+	const uint32_t hash = hashKey(_key[0], _key[1], _key[2], _key[3]), mask = _map->numSlots - 1;
+	uint32_t slot = hash & mask, probes = 1;
+	for (uint64_t entry = _map->slots[slot]; entry != UINT64_MAX; entry = _map->slots[slot], probes++) {
+		const uint32_t i = (uint32_t)entry;
+		if ((uint32_t)(entry >> 32) == hash && ((const uint32_t *)_map->objects.data)[i] == _key[0] && ((const uint32_t *)_map->positions.data)[i] == _key[1] && ((const uint32_t *)_map->texcoords.data)[i] == _key[2] && ((const uint32_t *)_map->normals.data)[i] == _key[3])
+			break;
+		slot = (slot + 1) & mask;
+	}
+	return probes;
+}
+
+// Vertex keys (object, position, texcoord, normal) for each triangle corner of a grid of quads.
+// Seams: every quad has its own texcoords and every triangle its own normal, so there are 6 vertices per position, 3 times the capacity guess.
+static uint32_t *generateVertexKeys(uint32_t _gridSize, bool _seams, uint32_t *_numKeys) {
+	*_numKeys = _gridSize * _gridSize * 6;
+	uint32_t *keys = malloc(sizeof(uint32_t) * 4 * *_numKeys), *key = keys;
+	static const uint32_t corners[6][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 0 }, { 1, 1 }, { 0, 1 } };
+	for (uint32_t y = 0; y < _gridSize; y++) {
+		for (uint32_t x = 0; x < _gridSize; x++) {
+			const uint32_t quad = y * _gridSize + x;
+			for (uint32_t i = 0; i < 6; i++, key += 4) {
+				const uint32_t pos = (y + corners[i][1]) * (_gridSize + 1) + x + corners[i][0];
+				key[0] = 0;
+				key[1] = pos;
+				key[2] = _seams ? quad * 4 + corners[i][1] * 2 + corners[i][0] : pos;
+				key[3] = _seams ? quad * 2 + i / 3 : UINT32_MAX;
+			}
+		}
+	}
+	return keys;
+}
+
+static void benchmarkVertexHashMap() {
+	printf("Vertex dedup\n");
+	for (int seams = 0; seams < 2; seams++) {
+		const uint32_t gridSize = 1000, numPositions = (gridSize + 1) * (gridSize + 1);
+		uint32_t numKeys;
+		const uint32_t *keys = generateVertexKeys(gridSize, seams != 0, &numKeys);
+		double chainedTime = DBL_MAX, time = DBL_MAX;
+		uint64_t chainedProbes = 0, probes = 0;
+		uint32_t chainedVertices = 0, vertices = 0;
+		for (int i = 0; i < BENCHMARK_REPEAT; i++) {
+			// Same capacity guess as objz_load.
+			ChainedVertexHashMap chained = { 0 };
+			chained.numSlots = (uint32_t)(numPositions * 2 * 1.3f);
+			chained.slots = malloc(sizeof(uint32_t) * chained.numSlots);
+			memset(chained.slots, 0xff, sizeof(uint32_t) * chained.numSlots);
+			chainedProbes = 0;
+			double start = getTime();
+			for (uint32_t j = 0; j < numKeys; j++)
+				chainedVertexHashMapInsert(&chained, &keys[j * 4], &chainedProbes);
+			chainedTime = OBJZ_SMALLEST(chainedTime, getTime() - start);
+			chainedVertices = chained.numVertices;
+			free(chained.slots);
+			free(chained.vertices);
+			VertexHashMap map;
+			vertexHashMapInit(&map, &s_defaultContext, numPositions * 2, numKeys);
+			start = getTime();
+			for (uint32_t j = 0; j < numKeys; j++)
+				vertexHashMapInsert(&map, keys[j * 4], keys[j * 4 + 1], keys[j * 4 + 2], keys[j * 4 + 3]);
+			time = OBJZ_SMALLEST(time, getTime() - start);
+			vertexHashMapDestroy(&map);
+		}
+		// Count probes in a separate, untimed pass.
+		VertexHashMap map;
+		vertexHashMapInit(&map, &s_defaultContext, numPositions * 2, numKeys);
+		for (uint32_t j = 0; j < numKeys; j++) {
+			probes += countVertexHashMapProbes(&map, &keys[j * 4]);
+			vertexHashMapInsert(&map, keys[j * 4], keys[j * 4 + 1], keys[j * 4 + 2], keys[j * 4 + 3]);
+		}
+		vertices = map.positions.length;
+		vertexHashMapDestroy(&map);
+		printf("   %s (%u inserts, %u vertices)\n", seams ? "seams" : "no seams", numKeys, vertices);
+		if (vertices != chainedVertices)
+			printf("   [FAIL] chained hash map found %u vertices\n", chainedVertices);
+		printf("      sdbm chained: %.1f ns/insert, %.2f probes/insert\n", chainedTime * 1e9 / numKeys, chainedProbes / (double)numKeys);
+		printf("      open addressing: %.1f ns/insert, %.2f probes/insert (%.2fx)\n", time * 1e9 / numKeys, probes / (double)numKeys, chainedTime / time);
+		free((void *)keys);
+	}
+}
+
+// Smooth normal generation should scale linearly with the number of faces.
+static void benchmarkSmoothNormals() {
+	printf("Smoothing group normals\n");
+	for (uint32_t gridSize = 125; gridSize <= 1000; gridSize *= 2) {
+		Buffer obj = generateObj(gridSize, false);
+		double time = DBL_MAX;
+		for (int i = 0; i < BENCHMARK_REPEAT; i++) {
+			const double start = getTime();
+			objzModel *model = objz_loadFromMemory(obj.data, obj.length, NULL, NULL);
+			time = OBJZ_SMALLEST(time, getTime() - start);
+			if (!model) {
+				printf("[FAIL] %s\n", objz_getError());
+				break;
+			}
+			objz_destroy(model);
+		}
+		const uint32_t numTriangles = gridSize * gridSize * 2;
+		printf("   %u triangles: %.1f ms, %.1f ns/triangle\n", numTriangles, time * 1e3, time * 1e9 / numTriangles);
+		free(obj.data);
+	}
+}
+
+// Scalar face normals and the generic vertex format path, to compare with calculateFaceNormals and the default vertex format path of writeVertices.
+static void benchmarkPostProcessKernels() {
+	objzContext *ctx = &s_defaultContext;
+	const uint32_t gridSize = 1000;
+	ChunkedArray positions, texcoords, normals, faces;
+	chunkedArrayInit(&positions, ctx, sizeof(vec3), 100000);
+	chunkedArrayInit(&texcoords, ctx, sizeof(float) * 2, 100000);
+	chunkedArrayInit(&normals, ctx, sizeof(vec3), 100000);
+	chunkedArrayInit(&faces, ctx, sizeof(Face), 100000);
+	VertexHashMap map;
+	vertexHashMapInit(&map, ctx, (gridSize + 1) * (gridSize + 1), (gridSize + 1) * (gridSize + 1));
+	for (uint32_t y = 0; y <= gridSize; y++) {
+		for (uint32_t x = 0; x <= gridSize; x++) {
+			const vec3 pos = { (float)x, (float)y, (float)((x * y) % 7) };
+			const float texcoord[2] = { x / (float)gridSize, y / (float)gridSize };
+			chunkedArrayAppend(&positions, &pos);
+			chunkedArrayAppend(&texcoords, texcoord);
+			const uint32_t v = positions.length - 1;
+			vertexHashMapInsert(&map, 0, v, v, UINT32_MAX);
+		}
+	}
+	for (uint32_t y = 0; y < gridSize; y++) {
+		for (uint32_t x = 0; x < gridSize; x++) {
+			const uint32_t v = y * (gridSize + 1) + x;
+			Face face;
+			memset(&face, 0, sizeof(face));
+			face.indices[0].v = v;
+			face.indices[1].v = v + 1;
+			face.indices[2].v = v + gridSize + 2;
+			chunkedArrayAppend(&faces, &face);
+			face.indices[1].v = v + gridSize + 2;
+			face.indices[2].v = v + gridSize + 1;
+			chunkedArrayAppend(&faces, &face);
+		}
+	}
+	vec3 *faceNormals = malloc(sizeof(vec3) * faces.length);
+	uint8_t *vertices = malloc(sizeof(float) * 8 * map.positions.length);
+	const VertexFormat defaultFormat = OBJZ_DEFAULT_VERTEX_FORMAT;
+	const VertexFormat otherFormat = { sizeof(float) * 8, sizeof(float) * 5, sizeof(float) * 3, 0 }; // Same size, different order.
+	double scalarNormalsTime = DBL_MAX, normalsTime = DBL_MAX, otherVerticesTime = DBL_MAX, verticesTime = DBL_MAX;
+	for (int i = 0; i < BENCHMARK_REPEAT; i++) {
+		double start = getTime();
+		for (uint32_t j = 0; j < faces.length; j++) {
+			const Face *face = chunkedArrayElement(&faces, j);
+			vec3 edge0, edge1;
+			const vec3 *p0 = chunkedArrayElement(&positions, face->indices[0].v);
+			const vec3 *p1 = chunkedArrayElement(&positions, face->indices[1].v);
+			const vec3 *p2 = chunkedArrayElement(&positions, face->indices[2].v);
+			OBJZ_VEC3_SUB(edge0, *p1, *p0);
+			OBJZ_VEC3_SUB(edge1, *p2, *p0);
+			OBJZ_VEC3_CROSS(faceNormals[j], edge0, edge1);
+			vec3Normalize(&faceNormals[j], &faceNormals[j]);
+		}
+		scalarNormalsTime = OBJZ_SMALLEST(scalarNormalsTime, getTime() - start);
+		start = getTime();
+		calculateFaceNormals(&faces, &positions, faceNormals);
+		normalsTime = OBJZ_SMALLEST(normalsTime, getTime() - start);
+		start = getTime();
+		writeVertices(&otherFormat, vertices, &map, &positions, &texcoords, &normals, NULL);
+		otherVerticesTime = OBJZ_SMALLEST(otherVerticesTime, getTime() - start);
+		start = getTime();
+		writeVertices(&defaultFormat, vertices, &map, &positions, &texcoords, &normals, NULL);
+		verticesTime = OBJZ_SMALLEST(verticesTime, getTime() - start);
+	}
+	printf("Post-processing kernels (%u faces, %u vertices)\n", faces.length, map.positions.length);
+	printf("   Scalar face normals: %.1f ms\n", scalarNormalsTime * 1e3);
+	printf("   calculateFaceNormals: %.1f ms (%.2fx)\n", normalsTime * 1e3, scalarNormalsTime / normalsTime);
+	printf("   writeVertices, other format: %.1f ms\n", otherVerticesTime * 1e3);
+	printf("   writeVertices, default format: %.1f ms (%.2fx)\n", verticesTime * 1e3, otherVerticesTime / verticesTime);
+	free(faceNormals);
+	free(vertices);
+	vertexHashMapDestroy(&map);
+	chunkedArrayDestroy(&positions);
+	chunkedArrayDestroy(&texcoords);
+	chunkedArrayDestroy(&normals);
+	chunkedArrayDestroy(&faces);
+}
+
+int main(int argc, char **argv) {
+	Buffer obj = argc > 1 ? readFile(argv[1]) : generateObj(1000, true);
+	if (!obj.length) {
+		printf("Error reading '%s'\n", argv[1]);
+		return 1;
+	}
+	printf("%.1f MB\n", obj.length / (1024.0 * 1024.0));
+	benchmarkScan(&obj);
+	benchmarkFloats();
+	benchmarkLoad(&obj);
+	benchmarkBatch();
+	printf("Vertex cache optimization (16 vertex FIFO)\n");
+	benchmarkVertexCache(&obj, "Input");
+	Buffer shuffled = generateShuffledObj(300);
+	benchmarkVertexCache(&shuffled, "Shuffled faces");
+	free(shuffled.data);
+	benchmarkVertexHashMap();
+	benchmarkSmoothNormals();
+	benchmarkPostProcessKernels();
+	free(obj.data);
+	return 0;
+}
@@ -24,10 +24,13 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 /*
-Ear clipping triangulation and tryParseDouble from tinyobjloader, also under MIT license.
+Ear clipping triangulation from tinyobjloader, also under MIT license.
 https://github.com/syoyo/tinyobjloader
 Copyright (c) 2012-2018 Syoyo Fujita and many contributors.
 */
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L // mmap, posix_madvise, pthreads, st_mtim
+#endif
 #include <float.h>
 #include <math.h>
 #include <stdarg.h>
@@ -39,27 +42,174 @@ Copyright (c) 2012-2018 Syoyo Fujita and many contributors.
 #include <limits.h>
 #include "objzero.h"
 
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <process.h>
+#endif
+
+#if !defined(OBJZ_NO_MMAP) && defined(_WIN32)
+#define OBJZ_MMAP 1
+#elif !defined(OBJZ_NO_MMAP) && (defined(__unix__) || defined(__APPLE__))
+#define OBJZ_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#else
+#define OBJZ_MMAP 0
+#endif
+
+// Define OBJZ_NO_THREADS to always parse on the calling thread.
+#if !defined(OBJZ_NO_THREADS) && defined(_WIN32)
+#define OBJZ_THREADS 1
+#elif !defined(OBJZ_NO_THREADS) && (defined(__unix__) || defined(__APPLE__))
+#define OBJZ_THREADS 1
+#include <pthread.h>
+#else
+#define OBJZ_THREADS 0
+#endif
+
+// Define OBJZ_NO_PRESCAN to guess array sizes instead of counting statements before parsing a file.
+#ifndef OBJZ_NO_PRESCAN
+#define OBJZ_PRESCAN 1
+#else
+#define OBJZ_PRESCAN 0
+#endif
+
+// Define OBJZ_NO_SIMD to scan lines and tokens one byte at a time, and to generate normals and write vertices one at a time.
+#if !defined(OBJZ_NO_SIMD) && defined(__AVX2__)
+#define OBJZ_SIMD_WIDTH 32
+#include <immintrin.h>
+#elif !defined(OBJZ_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define OBJZ_SIMD_WIDTH 16
+#include <emmintrin.h>
+#else
+#define OBJZ_SIMD_WIDTH 0
+#endif
+#if OBJZ_SIMD_WIDTH && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 #ifdef _MSC_VER
 #define OBJZ_FOPEN(_file, _filename, _mode) { if (fopen_s(&_file, _filename, _mode) != 0) _file = NULL; }
-#define OBJZ_STRICMP _stricmp
+#define OBJZ_STRNICMP _strnicmp
 #define OBJZ_STRTOK(_str, _delim, _context) strtok_s(_str, _delim, _context)
 #else
 #include <strings.h>
 #define OBJZ_FOPEN(_file, _filename, _mode) _file = fopen(_filename, _mode)
-#define OBJZ_STRICMP strcasecmp
+#define OBJZ_STRNICMP strncasecmp
 #define OBJZ_STRTOK(_str, _delim, _context) strtok(_str, _delim)
 #endif
 
 #define OBJZ_MAX_ERROR_LENGTH 1024
-#define OBJZ_MAX_TOKEN_LENGTH 256
 #define OBJZ_RAW_ARRAY_LEN(_x) (sizeof(_x) / sizeof((_x)[0]))
 #define OBJZ_SMALLEST(_a, _b) ((_a) < (_b) ? (_a) : (_b))
 #define OBJZ_LARGEST(_a, _b) ((_a) > (_b) ? (_a) : (_b))
 
-static char s_error[OBJZ_MAX_ERROR_LENGTH] = { 0 };
-static objzReallocFunc s_realloc = NULL;
-static objzProgressFunc s_progress = NULL;
-static uint32_t s_indexFormat = OBJZ_INDEX_FORMAT_AUTO;
+typedef struct {
+#if OBJZ_THREADS && defined(_WIN32)
+	CRITICAL_SECTION handle;
+#elif OBJZ_THREADS
+	pthread_mutex_t handle;
+#else
+	int unused;
+#endif
+} Mutex;
+
+static void mutexInit(Mutex *_mutex) {
+#if OBJZ_THREADS && defined(_WIN32)
+	InitializeCriticalSection(&_mutex->handle);
+#elif OBJZ_THREADS
+	pthread_mutex_init(&_mutex->handle, NULL);
+#else
+	(void)_mutex;
+#endif
+}
+
+static void mutexDestroy(Mutex *_mutex) {
+#if OBJZ_THREADS && defined(_WIN32)
+	DeleteCriticalSection(&_mutex->handle);
+#elif OBJZ_THREADS
+	pthread_mutex_destroy(&_mutex->handle);
+#else
+	(void)_mutex;
+#endif
+}
+
+static void mutexLock(Mutex *_mutex) {
+#if OBJZ_THREADS && defined(_WIN32)
+	EnterCriticalSection(&_mutex->handle);
+#elif OBJZ_THREADS
+	pthread_mutex_lock(&_mutex->handle);
+#else
+	(void)_mutex;
+#endif
+}
+
+static void mutexUnlock(Mutex *_mutex) {
+#if OBJZ_THREADS && defined(_WIN32)
+	LeaveCriticalSection(&_mutex->handle);
+#elif OBJZ_THREADS
+	pthread_mutex_unlock(&_mutex->handle);
+#else
+	(void)_mutex;
+#endif
+}
+
+// Flags set on one thread and polled on others without a lock, e.g. to cancel a load. Memory written before setting a flag is visible to a thread that sees it set.
+static bool atomicFlagGet(const int32_t *_flag) {
+#if OBJZ_THREADS && defined(_MSC_VER)
+	return InterlockedCompareExchange((volatile LONG *)_flag, 0, 0) != 0;
+#elif OBJZ_THREADS && defined(__GNUC__)
+	return __atomic_load_n(_flag, __ATOMIC_ACQUIRE) != 0;
+#else
+	return *(const volatile int32_t *)_flag != 0;
+#endif
+}
+
+static void atomicFlagStore(int32_t *_flag, int32_t _value) {
+#if OBJZ_THREADS && defined(_MSC_VER)
+	InterlockedExchange((volatile LONG *)_flag, _value);
+#elif OBJZ_THREADS && defined(__GNUC__)
+	__atomic_store_n(_flag, _value, __ATOMIC_RELEASE);
+#else
+	*(volatile int32_t *)_flag = _value;
+#endif
+}
+
+static void atomicFlagSet(int32_t *_flag) {
+	atomicFlagStore(_flag, 1);
+}
+
+static void atomicFlagClear(int32_t *_flag) {
+	atomicFlagStore(_flag, 0);
+}
+
+// Temporary memory for one load. See objz_setArenaSize.
+// Small allocations are bumped off blocks allocated with the context realloc function. They are rounded up to a size class, and freed ones go on a free list for their class, so they are reused by the same load. All of them are released at once when the last load using the arena finishes.
+// Larger allocations, e.g. arrays that grow by doubling, use the realloc function directly, so they can grow in place and their memory is returned as soon as they are freed.
+// There are no locks: an arena is only used by one thread at a time. Worker threads allocate from their own arenas, see arenaWorkerContext.
+typedef struct ArenaBlock {
+	struct ArenaBlock *next; // Older block.
+	size_t size; // Bytes after the header.
+	size_t used;
+} ArenaBlock;
+
+#define OBJZ_ARENA_NUM_SIZES 36 // 16 bytes to OBJZ_ARENA_MAX_ALLOCATION, see arenaSizeClass.
+
+typedef struct Arena {
+	ArenaBlock *blocks; // Newest first.
+	void *freeLists[OBJZ_ARENA_NUM_SIZES]; // Freed allocations of each size. The first bytes of each point to the next.
+	size_t used; // Bytes bumped off all blocks. Freed allocations are still counted: they stay on the free lists.
+	size_t highWater; // Most bytes used by one load.
+	size_t nextBlockSize; // At least this much for the next block.
+	uint32_t numLoads; // Loads in progress, including parsers that haven't been finished or destroyed. Only changed on the thread that starts and ends the loads.
+	struct Arena *nextWorker; // Worker arenas are a list, allocated when first needed and kept with the context.
+} Arena;
 
 typedef struct {
 	size_t stride;
@@ -68,19 +218,49 @@ typedef struct {
 	size_t normalOffset;
 } VertexFormat;
 
-static VertexFormat s_vertexDecl = {
-	.stride = sizeof(float) * (3 + 2 + 3),
-	.positionOffset = 0,
-	.texcoordOffset = sizeof(float) * 3,
-	.normalOffset = sizeof(float) * (3 + 2)
+#define OBJZ_DEFAULT_VERTEX_FORMAT { sizeof(float) * (3 + 2 + 3), 0, sizeof(float) * 3, sizeof(float) * (3 + 2) }
+
+// All loader configuration and state. Nothing is shared between contexts, so loads using different contexts can run concurrently.
+struct objzContext {
+	objzReallocFunc reallocFunc;
+	objzProgressFunc progressFunc;
+	uint32_t indexFormat;
+	VertexFormat vertexDecl;
+	uint32_t numThreads;
+	float normalWeldEpsilon;
+	Arena *arena; // NULL: temporary memory comes from the realloc function. See arenaRealloc.
+	objzMaterialCache *materialCache; // Optional.
+	const int32_t *cancel; // Optional: set by objz_asyncLoadCancel. See loadCancelled.
+	int32_t asyncLoading; // An async load is using the context. Set by objz_loadAsync, cleared on the loading thread. See atomicFlagGet.
+	struct objzContext **batchWorkers; // Created by objz_loadBatch and kept, so later batches reuse their arenas.
+	uint32_t numBatchWorkers;
+	char error[OBJZ_MAX_ERROR_LENGTH];
 };
 
-static void *objz_realloc(void *_ptr, size_t _size, char *_file, int _line) {
+static Arena s_defaultArena;
+
+// Used by the functions that don't take a context.
+static objzContext s_defaultContext = {
+	.reallocFunc = NULL,
+	.progressFunc = NULL,
+	.indexFormat = OBJZ_INDEX_FORMAT_AUTO,
+	.vertexDecl = OBJZ_DEFAULT_VERTEX_FORMAT,
+	.numThreads = 1,
+	.normalWeldEpsilon = FLT_EPSILON,
+	.arena = &s_defaultArena,
+	.materialCache = NULL,
+	.cancel = NULL,
+	.asyncLoading = 0,
+	.batchWorkers = NULL,
+	.numBatchWorkers = 0
+};
+
+static void *callRealloc(objzReallocFunc _realloc, void *_ptr, size_t _size, char *_file, int _line) {
 	if (!_ptr && !_size)
 		return NULL;
 	void *result;
-	if (s_realloc)
-		result = s_realloc(_ptr, _size);
+	if (_realloc)
+		result = _realloc(_ptr, _size);
 	else
 		result = realloc(_ptr, _size);
 	if (_size > 0 && !result) {
@@ -90,15 +270,351 @@ static void *objz_realloc(void *_ptr, size_t _size, char *_file, int _line) {
 	return result;
 }
 
-#define OBJZ_MALLOC(_size) objz_realloc(NULL, (_size), __FILE__, __LINE__)
-#define OBJZ_REALLOC(_ptr, _size) objz_realloc((_ptr), (_size), __FILE__, __LINE__)
-#define OBJZ_FREE(_ptr) objz_realloc((_ptr), 0, __FILE__, __LINE__)
+static void *objz_realloc(objzContext *_ctx, void *_ptr, size_t _size, char *_file, int _line) {
+	return callRealloc(_ctx->reallocFunc, _ptr, _size, _file, _line);
+}
+
+// Memory returned to the user: the model and the context.
+#define OBJZ_OUTPUT_MALLOC(_ctx, _size) objz_realloc((_ctx), NULL, (_size), __FILE__, __LINE__)
+#define OBJZ_OUTPUT_FREE(_ctx, _ptr) objz_realloc((_ctx), (_ptr), 0, __FILE__, __LINE__)
+
+#define OBJZ_ARENA_ALIGNMENT 16
+#define OBJZ_ARENA_HEADER_SIZE OBJZ_ARENA_ALIGNMENT // Each allocation is preceded by an ArenaHeader.
+#define OBJZ_ARENA_MIN_BLOCK_SIZE (256 * 1024)
+#define OBJZ_ARENA_MAX_ALLOCATION (16 * 1024) // Larger ones are usually arrays that will grow, or per object arrays that would waste more memory rounded up to a size class.
+
+typedef struct {
+	size_t size;
+	Arena *arena; // NULL if it was allocated with the realloc function.
+} ArenaHeader;
+
+static size_t arenaAlign(size_t _size) {
+	return (_size + OBJZ_ARENA_ALIGNMENT - 1) & ~(size_t)(OBJZ_ARENA_ALIGNMENT - 1);
+}
+
+static uint8_t *arenaBlockData(ArenaBlock *_block) {
+	return (uint8_t *)_block + arenaAlign(sizeof(ArenaBlock));
+}
+
+// The free list for allocations of _size bytes. The sizes are 16, 32, 48 and 64, then four for each power of two: 80, 96, 112, 128, 160 and so on. Rounding up wastes at most a quarter.
+static uint32_t arenaSizeClass(size_t _size) {
+	if (_size <= 64)
+		return _size ? (uint32_t)((_size - 1) / 16) : 0;
+	uint32_t shift = 6;
+	while (((size_t)1 << (shift + 1)) < _size)
+		shift++;
+	return 4 + (shift - 6) * 4 + (uint32_t)((_size - ((size_t)1 << shift) - 1) >> (shift - 2));
+}
+
+static size_t arenaClassSize(uint32_t _sizeClass) {
+	if (_sizeClass < 4)
+		return 16 * (_sizeClass + 1);
+	const uint32_t shift = 6 + (_sizeClass - 4) / 4;
+	return ((size_t)1 << shift) + ((size_t)((_sizeClass - 4) % 4 + 1) << (shift - 2));
+}
+
+static void arenaAddBlock(objzContext *_ctx, Arena *_arena, size_t _size) {
+	ArenaBlock *block = OBJZ_OUTPUT_MALLOC(_ctx, arenaAlign(sizeof(ArenaBlock)) + _size);
+	block->next = _arena->blocks;
+	block->size = _size;
+	block->used = 0;
+	_arena->blocks = block;
+}
+
+static void arenaFreeBlocks(objzContext *_ctx, Arena *_arena) {
+	while (_arena->blocks) {
+		ArenaBlock *next = _arena->blocks->next;
+		OBJZ_OUTPUT_FREE(_ctx, _arena->blocks);
+		_arena->blocks = next;
+	}
+	_arena->used = 0;
+	memset(_arena->freeLists, 0, sizeof(_arena->freeLists));
+}
+
+// Free the blocks of the context's arena and its worker arenas, and the worker arenas.
+static void arenaRelease(objzContext *_ctx) {
+	Arena *arena = _ctx->arena;
+	while (arena->nextWorker) {
+		Arena *worker = arena->nextWorker;
+		arena->nextWorker = worker->nextWorker;
+		arenaFreeBlocks(_ctx, worker);
+		OBJZ_OUTPUT_FREE(_ctx, worker);
+	}
+	arenaFreeBlocks(_ctx, arena);
+}
+
+static void *arenaAllocate(objzContext *_ctx, size_t _size, char *_file, int _line) {
+	Arena *arena = _ctx->arena;
+	ArenaHeader header;
+	header.size = _size;
+	header.arena = NULL;
+	uint8_t *result;
+	if (!arena || arena->numLoads == 0 || _size > OBJZ_ARENA_MAX_ALLOCATION)
+		result = objz_realloc(_ctx, NULL, OBJZ_ARENA_HEADER_SIZE + _size, _file, _line);
+	else {
+		header.arena = arena;
+		const uint32_t sizeClass = arenaSizeClass(_size);
+		if (arena->freeLists[sizeClass]) {
+			result = (uint8_t *)arena->freeLists[sizeClass] - OBJZ_ARENA_HEADER_SIZE;
+			memcpy(&arena->freeLists[sizeClass], result + OBJZ_ARENA_HEADER_SIZE, sizeof(void *));
+		} else {
+			const size_t required = OBJZ_ARENA_HEADER_SIZE + arenaClassSize(sizeClass);
+			ArenaBlock *block = arena->blocks;
+			if (!block || block->size - block->used < required) {
+				// Grow the arena by an eighth each time. The newest block is partly unused until the load finishes, so larger blocks would raise the peak memory use.
+				arenaAddBlock(_ctx, arena, OBJZ_LARGEST(OBJZ_LARGEST(required, (size_t)OBJZ_ARENA_MIN_BLOCK_SIZE), OBJZ_LARGEST(arena->used / 8, arena->nextBlockSize)));
+				arena->nextBlockSize = 0;
+				block = arena->blocks;
+			}
+			result = arenaBlockData(block) + block->used;
+			block->used += required;
+			arena->used += required;
+			arena->highWater = OBJZ_LARGEST(arena->highWater, arena->used);
+		}
+	}
+	memcpy(result, &header, sizeof(header));
+	return result + OBJZ_ARENA_HEADER_SIZE;
+}
+
+// Like objz_realloc. Small temporary memory comes from the arena while a load is in progress, everything else from the realloc function.
+// Memory from an arena is freed to the arena it came from, which must not be in use by another thread.
+static void *arenaRealloc(objzContext *_ctx, void *_ptr, size_t _size, char *_file, int _line) {
+	if (!_ptr)
+		return _size ? arenaAllocate(_ctx, _size, _file, _line) : NULL;
+	uint8_t *base = (uint8_t *)_ptr - OBJZ_ARENA_HEADER_SIZE;
+	ArenaHeader header;
+	memcpy(&header, base, sizeof(header));
+	if (!header.arena) {
+		if (!_size) {
+			objz_realloc(_ctx, base, 0, _file, _line);
+			return NULL;
+		}
+		base = objz_realloc(_ctx, base, OBJZ_ARENA_HEADER_SIZE + _size, _file, _line);
+		header.size = _size;
+		memcpy(base, &header, sizeof(header));
+		return base + OBJZ_ARENA_HEADER_SIZE;
+	}
+	const uint32_t sizeClass = arenaSizeClass(header.size);
+	if (_size && _size <= arenaClassSize(sizeClass)) {
+		header.size = _size;
+		memcpy(base, &header, sizeof(header));
+		return _ptr;
+	}
+	void *result = NULL;
+	if (_size) {
+		result = arenaAllocate(_ctx, _size, _file, _line);
+		memcpy(result, _ptr, OBJZ_SMALLEST(header.size, _size));
+	}
+	memcpy(_ptr, &header.arena->freeLists[sizeClass], sizeof(void *));
+	header.arena->freeLists[sizeClass] = _ptr;
+	return result;
+}
+
+// Temporary memory, see arenaRealloc.
+#define OBJZ_MALLOC(_ctx, _size) arenaRealloc((_ctx), NULL, (_size), __FILE__, __LINE__)
+#define OBJZ_REALLOC(_ctx, _ptr, _size) arenaRealloc((_ctx), (_ptr), (_size), __FILE__, __LINE__)
+#define OBJZ_FREE(_ctx, _ptr) arenaRealloc((_ctx), (_ptr), 0, __FILE__, __LINE__)
+
+// Called on the calling thread at the start and end of each load, before and after any worker threads. Worker arenas follow the context's arena.
+static void arenaBeginLoad(objzContext *_ctx) {
+	for (Arena *arena = _ctx->arena; arena; arena = arena->nextWorker)
+		arena->numLoads++;
+}
+
+// When the last load finishes, everything is released at once. If the load needed more than one block, they are freed, and the next load allocates one block the size of the high-water mark. Loads of similar files after that don't allocate temporary memory from the arena.
+static void arenaEndLoad(objzContext *_ctx) {
+	for (Arena *arena = _ctx->arena; arena; arena = arena->nextWorker) {
+		if (--arena->numLoads > 0)
+			continue;
+		if (arena->blocks && arena->blocks->next) {
+			arenaFreeBlocks(_ctx, arena);
+			arena->nextBlockSize = arenaAlign(arena->highWater);
+		} else if (arena->blocks)
+			arena->blocks->used = 0;
+		arena->used = 0;
+		memset(arena->freeLists, 0, sizeof(arena->freeLists));
+	}
+}
+
+// Make _workerCtx a copy of _ctx for worker _worker of a parallel step, with a separate error buffer and the worker's own arena, so the workers don't share one.
+// Memory allocated with the copy must only be freed on the worker's thread, or after the worker threads are joined.
+static void arenaWorkerContext(objzContext *_ctx, uint32_t _worker, objzContext *_workerCtx) {
+	*_workerCtx = *_ctx;
+	_workerCtx->error[0] = 0;
+	if (!_ctx->arena)
+		return;
+	Arena **worker = &_ctx->arena->nextWorker;
+	for (uint32_t i = 0;; i++) {
+		if (!*worker) {
+			*worker = OBJZ_OUTPUT_MALLOC(_ctx, sizeof(Arena));
+			memset(*worker, 0, sizeof(Arena));
+			(*worker)->numLoads = _ctx->arena->numLoads;
+		}
+		if (i == _worker)
+			break;
+		worker = &(*worker)->nextWorker;
+	}
+	_workerCtx->arena = *worker;
+}
+
+typedef struct {
+	void (*func)(void *_data);
+	void *data;
+#if OBJZ_THREADS && defined(_WIN32)
+	HANDLE handle;
+#elif OBJZ_THREADS
+	pthread_t handle;
+#endif
+	bool started;
+} Thread;
+
+#if OBJZ_THREADS
+#ifdef _WIN32
+static unsigned __stdcall threadEntry(void *_thread) {
+#else
+static void *threadEntry(void *_thread) {
+#endif
+	Thread *thread = (Thread *)_thread;
+	thread->func(thread->data);
+	return 0;
+}
+#endif
+
+// _thread must stay valid until threadJoin. If a thread can't be started, _func is called on this thread instead.
+static void threadStart(Thread *_thread, void (*_func)(void *_data), void *_data) {
+	_thread->func = _func;
+	_thread->data = _data;
+	_thread->started = false;
+#if OBJZ_THREADS && defined(_WIN32)
+	_thread->handle = (HANDLE)_beginthreadex(NULL, 0, threadEntry, _thread, 0, NULL);
+	_thread->started = _thread->handle != NULL;
+#elif OBJZ_THREADS
+	_thread->started = pthread_create(&_thread->handle, NULL, threadEntry, _thread) == 0;
+#endif
+	if (!_thread->started)
+		_func(_data);
+}
+
+static void threadJoin(Thread *_thread) {
+	if (!_thread->started)
+		return;
+#if OBJZ_THREADS && defined(_WIN32)
+	WaitForSingleObject(_thread->handle, INFINITE);
+	CloseHandle(_thread->handle);
+#elif OBJZ_THREADS
+	pthread_join(_thread->handle, NULL);
+#endif
+	_thread->started = false;
+}
+
+struct TaskPool;
+
+typedef struct {
+	struct TaskPool *pool;
+	Thread thread;
+	Mutex mutex;
+	uint32_t next, end; // Tasks not yet taken.
+	uint32_t done;
+} TaskWorker;
+
+typedef void (*TaskFunc)(struct TaskPool *_pool, uint32_t _task, uint32_t _worker);
+
+// Work stealing: each worker starts with an equal, contiguous range of tasks and takes them from the front. When it runs out, it steals the back half of another worker's remaining range.
+// Tasks can vary a lot in size, e.g. one per object, so this keeps the workers busy.
+typedef struct TaskPool {
+	TaskFunc func;
+	void *data;
+	TaskWorker *workers;
+	uint32_t numWorkers;
+	uint32_t numTasks;
+} TaskPool;
+
+static bool taskWorkerTake(TaskWorker *_worker, uint32_t *_task) {
+	mutexLock(&_worker->mutex);
+	const bool found = _worker->next < _worker->end;
+	if (found)
+		*_task = _worker->next++;
+	mutexUnlock(&_worker->mutex);
+	if (found)
+		return true;
+	TaskPool *pool = _worker->pool;
+	const uint32_t self = (uint32_t)(_worker - pool->workers);
+	for (uint32_t i = 1; i < pool->numWorkers; i++) {
+		TaskWorker *victim = &pool->workers[(self + i) % pool->numWorkers];
+		mutexLock(&victim->mutex);
+		const uint32_t remaining = victim->end - victim->next;
+		uint32_t start = 0, end = 0;
+		if (remaining > 0) {
+			start = victim->end - (remaining + 1) / 2;
+			end = victim->end;
+			victim->end = start;
+		}
+		mutexUnlock(&victim->mutex);
+		if (remaining > 0) {
+			mutexLock(&_worker->mutex);
+			*_task = start;
+			_worker->next = start + 1;
+			_worker->end = end;
+			mutexUnlock(&_worker->mutex);
+			return true;
+		}
+	}
+	return false;
+}
+
+static void taskWorkerRun(void *_data) {
+	TaskWorker *worker = (TaskWorker *)_data;
+	uint32_t task;
+	while (taskWorkerTake(worker, &task)) {
+		worker->pool->func(worker->pool, task, (uint32_t)(worker - worker->pool->workers));
+		mutexLock(&worker->mutex);
+		worker->done++;
+		mutexUnlock(&worker->mutex);
+	}
+}
+
+// Only an estimate while other workers are running.
+static uint32_t taskPoolNumDone(TaskPool *_pool) {
+	uint32_t done = 0;
+	for (uint32_t i = 0; i < _pool->numWorkers; i++) {
+		mutexLock(&_pool->workers[i].mutex);
+		done += _pool->workers[i].done;
+		mutexUnlock(&_pool->workers[i].mutex);
+	}
+	return done;
+}
+
+// Run _func for tasks 0 to _numTasks - 1 on _numWorkers workers, including the calling thread, which is worker 0. Returns when all tasks are done.
+static void runTasks(objzContext *_ctx, TaskFunc _func, void *_data, uint32_t _numTasks, uint32_t _numWorkers) {
+	TaskPool pool;
+	pool.func = _func;
+	pool.data = _data;
+	pool.numTasks = _numTasks;
+	pool.numWorkers = OBJZ_THREADS ? OBJZ_LARGEST(OBJZ_SMALLEST(_numWorkers, _numTasks), 1) : 1;
+	pool.workers = OBJZ_MALLOC(_ctx, sizeof(TaskWorker) * pool.numWorkers);
+	for (uint32_t i = 0; i < pool.numWorkers; i++) {
+		TaskWorker *worker = &pool.workers[i];
+		worker->pool = &pool;
+		mutexInit(&worker->mutex);
+		worker->next = (uint32_t)((uint64_t)_numTasks * i / pool.numWorkers);
+		worker->end = (uint32_t)((uint64_t)_numTasks * (i + 1) / pool.numWorkers);
+		worker->done = 0;
+	}
+	for (uint32_t i = 1; i < pool.numWorkers; i++)
+		threadStart(&pool.workers[i].thread, taskWorkerRun, &pool.workers[i]);
+	taskWorkerRun(&pool.workers[0]);
+	for (uint32_t i = 1; i < pool.numWorkers; i++)
+		threadJoin(&pool.workers[i].thread);
+	for (uint32_t i = 0; i < pool.numWorkers; i++)
+		mutexDestroy(&pool.workers[i].mutex);
+	OBJZ_FREE(_ctx, pool.workers);
+}
 
 static size_t strLength(const char *_str, size_t _size)
 {
 	const char *c = _str;
 	size_t len = 0;
-	while (*c != 0 && len < _size) {
+	while (len < _size && *c != 0) {
 		c++;
 		len++;
 	}
@@ -118,137 +634,408 @@ static void strConcat(char *_dest, size_t _destSize, const char *_src, size_t _c
 	strCopy(&_dest[start], _destSize - start, _src, _count);
 }
 
-// Tries to parse a floating point number located at s.
-//
-// s_end should be a location in the string where reading should absolutely
-// stop. For example at the end of the string, to prevent buffer overflows.
-//
-// Parses the following EBNF grammar:
-//   sign    = "+" | "-" ;
-//   END     = ? anything not in digit ?
-//   digit   = "0" | "1" | "2" | "3" | "4" | "5" | "6" | "7" | "8" | "9" ;
-//   integer = [sign] , digit , {digit} ;
-//   decimal = integer , ["." , integer] ;
-//   float   = ( decimal , END ) | ( decimal , ("E" | "e") , integer , END ) ;
-//
-//  Valid strings are for example:
-//   -0  +3.1417e+2  -0.0E-3  1.0324  -1.41   11e2
-//
-// If the parsing is a success, result is set to the parsed value and true
-// is returned.
-//
-// The function is greedy and will parse until any of the following happens:
-//  - a non-conforming character is encountered.
-//  - s_end is reached.
-//
-// The following situations triggers a failure:
-//  - s >= s_end.
-//  - parse failure.
-//
 #define IS_DIGIT(x) ((unsigned int)((x) - '0') < (unsigned int)(10))
 
-static bool tryParseDouble(const char *s, const char *s_end, double *result)
-{
-	if (s >= s_end)
-		return false;
-	double mantissa = 0.0;
-	// This exponent is base 2 rather than 10.
-	// However the exponent we parse is supposed to be one of ten,
-	// thus we must take care to convert the exponent/and or the
-	// mantissa to a * 2^E, where a is the mantissa and E is the
-	// exponent.
-	// To get the final double we will use ldexp, it requires the
-	// exponent to be in base 2.
-	int exponent = 0;
-	// NOTE: THESE MUST BE DECLARED HERE SINCE WE ARE NOT ALLOWED
-	// TO JUMP OVER DEFINITIONS.
-	char sign = '+';
-	char exp_sign = '+';
-	char const *curr = s;
-	// How many characters were read in a loop.
-	int read = 0;
-	// Tells whether a loop terminated due to reaching s_end.
-	bool end_not_reached = false;
-	bool leading_decimal_dots = false;
-	// Find out what sign we've got.
-	if (*curr == '+' || *curr == '-') {
-		sign = *curr;
-		curr++;
-		if ((curr != s_end) && (*curr == '.')) {
-			// accept. Somethig like `.7e+2`, `-.5234`
-			leading_decimal_dots = true;
-		}
-	} else if (IS_DIGIT(*curr)) { /* Pass through. */
-	} else if (*curr == '.') {
-		// accept. Somethig like `.7e+2`, `-.5234`
-		leading_decimal_dots = true;
-	} else {
-		goto fail;
-	}
-	// Read the integer part.
-	end_not_reached = (curr != s_end);
-	if (!leading_decimal_dots) {
-		while (end_not_reached && IS_DIGIT(*curr)) {
-			mantissa *= 10;
-			mantissa += (int)(*curr - 0x30);
-			curr++;
-			read++;
-			end_not_reached = (curr != s_end);
-		}
-		// We must make sure we actually got something.
-		if (read == 0) goto fail;
-	}
-	// We allow numbers of form "#", "###" etc.
-	if (!end_not_reached) goto assemble;
-	// Read the decimal part.
-	if (*curr == '.') {
-		curr++;
-		read = 1;
-		end_not_reached = (curr != s_end);
-		while (end_not_reached && IS_DIGIT(*curr)) {
-			static const double pow_lut[] = { 1.0, 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001, };
-			const int lut_entries = sizeof pow_lut / sizeof pow_lut[0];
-			// NOTE: Don't use powf here, it will absolutely murder precision.
-			mantissa += (int)(*curr - 0x30) * (read < lut_entries ? pow_lut[read] : pow(10.0, -read));
-			read++;
-			curr++;
-			end_not_reached = (curr != s_end);
-		}
-	} else if (*curr == 'e' || *curr == 'E') {
-	} else {
-		goto assemble;
-	}
-	if (!end_not_reached) goto assemble;
-	// Read the exponent part.
-	if (*curr == 'e' || *curr == 'E') {
-		curr++;
-		// Figure out if a sign is present and if it is.
-		end_not_reached = (curr != s_end);
-		if (end_not_reached && (*curr == '+' || *curr == '-')) {
-			exp_sign = *curr;
-			curr++;
-		} else if (IS_DIGIT(*curr)) { /* Pass through. */
+// Correctly rounded decimal to float conversion: the Eisel-Lemire algorithm, as implemented by fast_float.
+// https://github.com/fastfloat/fast_float
+// Daniel Lemire, Number Parsing at a Gigabyte per Second, Software: Practice and Experience 51 (8), 2021.
+// Noble Mushtak and Daniel Lemire, Fast Number Parsing Without Fallback, Software: Practice and Experience 53 (7), 2023.
+
+#define OBJZ_FLOAT_MANTISSA_BITS 23
+#define OBJZ_FLOAT_MIN_EXPONENT -127
+#define OBJZ_FLOAT_INFINITE_POWER 0xFF
+#define OBJZ_FLOAT_MIN_POWER_OF_TEN -65 // Anything smaller is zero.
+#define OBJZ_FLOAT_MAX_POWER_OF_TEN 38 // Anything larger is infinity.
+#define OBJZ_FLOAT_MAX_DIGITS 19 // Significant digits that always fit in a uint64_t.
+#define OBJZ_FLOAT_MAX_EXACT_DIGITS 128 // More than any halfway point between two floats has, see roundFloatDigits.
+
+// 5^q for q in [OBJZ_FLOAT_MIN_POWER_OF_TEN, OBJZ_FLOAT_MAX_POWER_OF_TEN], normalized to 128 bits: high then low 64 bits.
+static const uint64_t s_powersOfFive[] = {
+	0x86ccbb52ea94baeaull, 0x98e947129fc2b4e9ull, // 5^-65
+	0xa87fea27a539e9a5ull, 0x3f2398d747b36224ull, // 5^-64
+	0xd29fe4b18e88640eull, 0x8eec7f0d19a03aadull, // 5^-63
+	0x83a3eeeef9153e89ull, 0x1953cf68300424acull, // 5^-62
+	0xa48ceaaab75a8e2bull, 0x5fa8c3423c052dd7ull, // 5^-61
+	0xcdb02555653131b6ull, 0x3792f412cb06794dull, // 5^-60
+	0x808e17555f3ebf11ull, 0xe2bbd88bbee40bd0ull, // 5^-59
+	0xa0b19d2ab70e6ed6ull, 0x5b6aceaeae9d0ec4ull, // 5^-58
+	0xc8de047564d20a8bull, 0xf245825a5a445275ull, // 5^-57
+	0xfb158592be068d2eull, 0xeed6e2f0f0d56712ull, // 5^-56
+	0x9ced737bb6c4183dull, 0x55464dd69685606bull, // 5^-55
+	0xc428d05aa4751e4cull, 0xaa97e14c3c26b886ull, // 5^-54
+	0xf53304714d9265dfull, 0xd53dd99f4b3066a8ull, // 5^-53
+	0x993fe2c6d07b7fabull, 0xe546a8038efe4029ull, // 5^-52
+	0xbf8fdb78849a5f96ull, 0xde98520472bdd033ull, // 5^-51
+	0xef73d256a5c0f77cull, 0x963e66858f6d4440ull, // 5^-50
+	0x95a8637627989aadull, 0xdde7001379a44aa8ull, // 5^-49
+	0xbb127c53b17ec159ull, 0x5560c018580d5d52ull, // 5^-48
+	0xe9d71b689dde71afull, 0xaab8f01e6e10b4a6ull, // 5^-47
+	0x9226712162ab070dull, 0xcab3961304ca70e8ull, // 5^-46
+	0xb6b00d69bb55c8d1ull, 0x3d607b97c5fd0d22ull, // 5^-45
+	0xe45c10c42a2b3b05ull, 0x8cb89a7db77c506aull, // 5^-44
+	0x8eb98a7a9a5b04e3ull, 0x77f3608e92adb242ull, // 5^-43
+	0xb267ed1940f1c61cull, 0x55f038b237591ed3ull, // 5^-42
+	0xdf01e85f912e37a3ull, 0x6b6c46dec52f6688ull, // 5^-41
+	0x8b61313bbabce2c6ull, 0x2323ac4b3b3da015ull, // 5^-40
+	0xae397d8aa96c1b77ull, 0xabec975e0a0d081aull, // 5^-39
+	0xd9c7dced53c72255ull, 0x96e7bd358c904a21ull, // 5^-38
+	0x881cea14545c7575ull, 0x7e50d64177da2e54ull, // 5^-37
+	0xaa242499697392d2ull, 0xdde50bd1d5d0b9e9ull, // 5^-36
+	0xd4ad2dbfc3d07787ull, 0x955e4ec64b44e864ull, // 5^-35
+	0x84ec3c97da624ab4ull, 0xbd5af13bef0b113eull, // 5^-34
+	0xa6274bbdd0fadd61ull, 0xecb1ad8aeacdd58eull, // 5^-33
+	0xcfb11ead453994baull, 0x67de18eda5814af2ull, // 5^-32
+	0x81ceb32c4b43fcf4ull, 0x80eacf948770ced7ull, // 5^-31
+	0xa2425ff75e14fc31ull, 0xa1258379a94d028dull, // 5^-30
+	0xcad2f7f5359a3b3eull, 0x096ee45813a04330ull, // 5^-29
+	0xfd87b5f28300ca0dull, 0x8bca9d6e188853fcull, // 5^-28
+	0x9e74d1b791e07e48ull, 0x775ea264cf55347eull, // 5^-27
+	0xc612062576589ddaull, 0x95364afe032a819eull, // 5^-26
+	0xf79687aed3eec551ull, 0x3a83ddbd83f52205ull, // 5^-25
+	0x9abe14cd44753b52ull, 0xc4926a9672793543ull, // 5^-24
+	0xc16d9a0095928a27ull, 0x75b7053c0f178294ull, // 5^-23
+	0xf1c90080baf72cb1ull, 0x5324c68b12dd6339ull, // 5^-22
+	0x971da05074da7beeull, 0xd3f6fc16ebca5e04ull, // 5^-21
+	0xbce5086492111aeaull, 0x88f4bb1ca6bcf585ull, // 5^-20
+	0xec1e4a7db69561a5ull, 0x2b31e9e3d06c32e6ull, // 5^-19
+	0x9392ee8e921d5d07ull, 0x3aff322e62439fd0ull, // 5^-18
+	0xb877aa3236a4b449ull, 0x09befeb9fad487c3ull, // 5^-17
+	0xe69594bec44de15bull, 0x4c2ebe687989a9b4ull, // 5^-16
+	0x901d7cf73ab0acd9ull, 0x0f9d37014bf60a11ull, // 5^-15
+	0xb424dc35095cd80full, 0x538484c19ef38c95ull, // 5^-14
+	0xe12e13424bb40e13ull, 0x2865a5f206b06fbaull, // 5^-13
+	0x8cbccc096f5088cbull, 0xf93f87b7442e45d4ull, // 5^-12
+	0xafebff0bcb24aafeull, 0xf78f69a51539d749ull, // 5^-11
+	0xdbe6fecebdedd5beull, 0xb573440e5a884d1cull, // 5^-10
+	0x89705f4136b4a597ull, 0x31680a88f8953031ull, // 5^-9
+	0xabcc77118461cefcull, 0xfdc20d2b36ba7c3eull, // 5^-8
+	0xd6bf94d5e57a42bcull, 0x3d32907604691b4dull, // 5^-7
+	0x8637bd05af6c69b5ull, 0xa63f9a49c2c1b110ull, // 5^-6
+	0xa7c5ac471b478423ull, 0x0fcf80dc33721d54ull, // 5^-5
+	0xd1b71758e219652bull, 0xd3c36113404ea4a9ull, // 5^-4
+	0x83126e978d4fdf3bull, 0x645a1cac083126eaull, // 5^-3
+	0xa3d70a3d70a3d70aull, 0x3d70a3d70a3d70a4ull, // 5^-2
+	0xccccccccccccccccull, 0xcccccccccccccccdull, // 5^-1
+	0x8000000000000000ull, 0x0000000000000000ull, // 5^0
+	0xa000000000000000ull, 0x0000000000000000ull, // 5^1
+	0xc800000000000000ull, 0x0000000000000000ull, // 5^2
+	0xfa00000000000000ull, 0x0000000000000000ull, // 5^3
+	0x9c40000000000000ull, 0x0000000000000000ull, // 5^4
+	0xc350000000000000ull, 0x0000000000000000ull, // 5^5
+	0xf424000000000000ull, 0x0000000000000000ull, // 5^6
+	0x9896800000000000ull, 0x0000000000000000ull, // 5^7
+	0xbebc200000000000ull, 0x0000000000000000ull, // 5^8
+	0xee6b280000000000ull, 0x0000000000000000ull, // 5^9
+	0x9502f90000000000ull, 0x0000000000000000ull, // 5^10
+	0xba43b74000000000ull, 0x0000000000000000ull, // 5^11
+	0xe8d4a51000000000ull, 0x0000000000000000ull, // 5^12
+	0x9184e72a00000000ull, 0x0000000000000000ull, // 5^13
+	0xb5e620f480000000ull, 0x0000000000000000ull, // 5^14
+	0xe35fa931a0000000ull, 0x0000000000000000ull, // 5^15
+	0x8e1bc9bf04000000ull, 0x0000000000000000ull, // 5^16
+	0xb1a2bc2ec5000000ull, 0x0000000000000000ull, // 5^17
+	0xde0b6b3a76400000ull, 0x0000000000000000ull, // 5^18
+	0x8ac7230489e80000ull, 0x0000000000000000ull, // 5^19
+	0xad78ebc5ac620000ull, 0x0000000000000000ull, // 5^20
+	0xd8d726b7177a8000ull, 0x0000000000000000ull, // 5^21
+	0x878678326eac9000ull, 0x0000000000000000ull, // 5^22
+	0xa968163f0a57b400ull, 0x0000000000000000ull, // 5^23
+	0xd3c21bcecceda100ull, 0x0000000000000000ull, // 5^24
+	0x84595161401484a0ull, 0x0000000000000000ull, // 5^25
+	0xa56fa5b99019a5c8ull, 0x0000000000000000ull, // 5^26
+	0xcecb8f27f4200f3aull, 0x0000000000000000ull, // 5^27
+	0x813f3978f8940984ull, 0x4000000000000000ull, // 5^28
+	0xa18f07d736b90be5ull, 0x5000000000000000ull, // 5^29
+	0xc9f2c9cd04674edeull, 0xa400000000000000ull, // 5^30
+	0xfc6f7c4045812296ull, 0x4d00000000000000ull, // 5^31
+	0x9dc5ada82b70b59dull, 0xf020000000000000ull, // 5^32
+	0xc5371912364ce305ull, 0x6c28000000000000ull, // 5^33
+	0xf684df56c3e01bc6ull, 0xc732000000000000ull, // 5^34
+	0x9a130b963a6c115cull, 0x3c7f400000000000ull, // 5^35
+	0xc097ce7bc90715b3ull, 0x4b9f100000000000ull, // 5^36
+	0xf0bdc21abb48db20ull, 0x1e86d40000000000ull, // 5^37
+	0x96769950b50d88f4ull, 0x1314448000000000ull, // 5^38
+};
+
+typedef struct {
+	uint64_t high, low;
+} Uint128;
+
+static Uint128 multiply64(uint64_t _a, uint64_t _b) {
+	Uint128 result;
+#ifdef __SIZEOF_INT128__
+	const unsigned __int128 product = (unsigned __int128)_a * _b;
+	result.high = (uint64_t)(product >> 64);
+	result.low = (uint64_t)product;
+#else
+	const uint64_t aLo = (uint32_t)_a, aHi = _a >> 32, bLo = (uint32_t)_b, bHi = _b >> 32;
+	const uint64_t lolo = aLo * bLo, hilo = aHi * bLo, lohi = aLo * bHi, hihi = aHi * bHi;
+	const uint64_t cross = (lolo >> 32) + (uint32_t)hilo + lohi;
+	result.high = hihi + (hilo >> 32) + (cross >> 32);
+	result.low = (cross << 32) | (uint32_t)lolo;
+#endif
+	return result;
+}
+
+static int countLeadingZeros64(uint64_t _x) {
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_clzll(_x);
+#else
+	int n = 0;
+	for (int shift = 32; shift > 0; shift >>= 1) {
+		if (!(_x >> (64 - shift))) {
+			n += shift;
+			_x <<= shift;
+		}
+	}
+	return n;
+#endif
+}
+
+// Returns the float bits, without sign, nearest to _w * 10^_q. _w must be exact.
+static uint32_t computeFloat(int64_t _q, uint64_t _w) {
+	if (_w == 0 || _q < OBJZ_FLOAT_MIN_POWER_OF_TEN)
+		return 0;
+	if (_q > OBJZ_FLOAT_MAX_POWER_OF_TEN)
+		return OBJZ_FLOAT_INFINITE_POWER << OBJZ_FLOAT_MANTISSA_BITS;
+	const int lz = countLeadingZeros64(_w);
+	_w <<= lz;
+	// Only the high 64 bits of 5^q are needed unless the bits below the mantissa and round bit are all ones.
+	const uint64_t *power = &s_powersOfFive[(_q - OBJZ_FLOAT_MIN_POWER_OF_TEN) * 2];
+	Uint128 product = multiply64(_w, power[0]);
+	const uint64_t precisionMask = UINT64_MAX >> (OBJZ_FLOAT_MANTISSA_BITS + 3);
+	if ((product.high & precisionMask) == precisionMask) {
+		const Uint128 second = multiply64(_w, power[1]);
+		product.low += second.high;
+		if (second.high > product.low)
+			product.high++;
+	}
+	const int upperBit = (int)(product.high >> 63);
+	const int shift = upperBit + 64 - OBJZ_FLOAT_MANTISSA_BITS - 3;
+	uint64_t mantissa = product.high >> shift;
+	// floor(log2(10^q)) + 63, see fast_float.
+	int32_t power2 = (int32_t)(((((152170 + 65536) * (int32_t)_q) >> 16) + 63) + upperBit - lz - OBJZ_FLOAT_MIN_EXPONENT);
+	if (power2 <= 0) {
+		// Subnormal.
+		if (-power2 + 1 >= 64)
+			return 0;
+		mantissa >>= -power2 + 1;
+		mantissa += mantissa & 1;
+		mantissa >>= 1;
+		power2 = mantissa < ((uint64_t)1 << OBJZ_FLOAT_MANTISSA_BITS) ? 0 : 1;
+		return (uint32_t)(mantissa & (((uint64_t)1 << OBJZ_FLOAT_MANTISSA_BITS) - 1)) | ((uint32_t)power2 << OBJZ_FLOAT_MANTISSA_BITS);
+	}
+	// Exactly halfway between two floats: round to even instead of up. Only possible for small powers of ten.
+	if (product.low <= 1 && _q >= -17 && _q <= 10 && (mantissa & 3) == 1 && (mantissa << shift) == product.high)
+		mantissa &= ~(uint64_t)1;
+	mantissa += mantissa & 1;
+	mantissa >>= 1;
+	if (mantissa >= ((uint64_t)2 << OBJZ_FLOAT_MANTISSA_BITS)) {
+		mantissa = (uint64_t)1 << OBJZ_FLOAT_MANTISSA_BITS;
+		power2++;
+	}
+	mantissa &= ~((uint64_t)1 << OBJZ_FLOAT_MANTISSA_BITS);
+	if (power2 >= OBJZ_FLOAT_INFINITE_POWER)
+		return OBJZ_FLOAT_INFINITE_POWER << OBJZ_FLOAT_MANTISSA_BITS;
+	return (uint32_t)mantissa | ((uint32_t)power2 << OBJZ_FLOAT_MANTISSA_BITS);
+}
+
+// Unsigned integer for roundFloatDigits: 32-bit limbs, least significant first.
+#define OBJZ_BIG_INT_LIMBS 32 // 1024 bits. roundFloatDigits needs less than 500.
+
+typedef struct {
+	uint32_t limbs[OBJZ_BIG_INT_LIMBS];
+	uint32_t length;
+} BigInt;
+
+static void bigIntMultiplyAdd(BigInt *_n, uint32_t _multiplier, uint32_t _add) {
+	uint64_t carry = _add;
+	for (uint32_t i = 0; i < _n->length; i++) {
+		const uint64_t value = (uint64_t)_n->limbs[i] * _multiplier + carry;
+		_n->limbs[i] = (uint32_t)value;
+		carry = value >> 32;
+	}
+	if (carry && _n->length < OBJZ_BIG_INT_LIMBS)
+		_n->limbs[_n->length++] = (uint32_t)carry;
+}
+
+static void bigIntMultiplyPowerOfFive(BigInt *_n, uint32_t _power) {
+	for (; _power >= 13; _power -= 13)
+		bigIntMultiplyAdd(_n, 1220703125, 0); // 5^13, the largest that fits in 32 bits.
+	uint32_t multiplier = 1;
+	for (; _power > 0; _power--)
+		multiplier *= 5;
+	bigIntMultiplyAdd(_n, multiplier, 0);
+}
+
+static void bigIntShiftLeft(BigInt *_n, uint32_t _shift) {
+	if (!_n->length)
+		return;
+	const uint32_t limbs = OBJZ_SMALLEST(_shift / 32, OBJZ_BIG_INT_LIMBS - _n->length);
+	const uint32_t bits = _shift % 32;
+	memmove(&_n->limbs[limbs], _n->limbs, sizeof(uint32_t) * _n->length);
+	memset(_n->limbs, 0, sizeof(uint32_t) * limbs);
+	_n->length += limbs;
+	if (bits) {
+		uint32_t carry = 0;
+		for (uint32_t i = limbs; i < _n->length; i++) {
+			const uint32_t limb = _n->limbs[i];
+			_n->limbs[i] = (limb << bits) | carry;
+			carry = limb >> (32 - bits);
+		}
+		if (carry && _n->length < OBJZ_BIG_INT_LIMBS)
+			_n->limbs[_n->length++] = carry;
+	}
+}
+
+static int bigIntCompare(const BigInt *_a, const BigInt *_b) {
+	if (_a->length != _b->length)
+		return _a->length < _b->length ? -1 : 1;
+	for (uint32_t i = _a->length; i-- > 0;) {
+		if (_a->limbs[i] != _b->limbs[i])
+			return _a->limbs[i] < _b->limbs[i] ? -1 : 1;
+	}
+	return 0;
+}
+
+// Slow path of parseFloat, for inputs with too many digits to round from the leading ones: _bits, or the next float up if the value is above the halfway point between them.
+// The value is the digits from _digits to _digitsEnd, ignoring the decimal point, times 10^_exponent. It's compared with the halfway point exactly, with big integers, so this doesn't depend on the number of digits or the C library's locale.
+// A halfway point has at most 113 significant digits, so digits past OBJZ_FLOAT_MAX_EXACT_DIGITS only matter if they aren't all zeros: then the value is above a halfway point that equals the leading digits.
+static uint32_t roundFloatDigits(const char *_digits, const char *_digitsEnd, int64_t _exponent, uint32_t _bits) {
+	BigInt value;
+	value.length = 0;
+	uint32_t numDigits = 0;
+	bool nonZeroTail = false;
+	for (const char *s = _digits; s < _digitsEnd; s++) {
+		if (*s == '.' || (*s == '0' && numDigits == 0))
+			continue;
+		if (numDigits < OBJZ_FLOAT_MAX_EXACT_DIGITS) {
+			bigIntMultiplyAdd(&value, 10, (uint32_t)(*s - '0'));
+			numDigits++;
 		} else {
-			// Empty E is not allowed.
-			goto fail;
-		}
-		read = 0;
-		end_not_reached = (curr != s_end);
-		while (end_not_reached && IS_DIGIT(*curr)) {
-			exponent *= 10;
-			exponent += (int)(*curr - 0x30);
-			curr++;
-			read++;
-			end_not_reached = (curr != s_end);
-		}
-		exponent *= (exp_sign == '+' ? 1 : -1);
-		if (read == 0) goto fail;
-	}
-assemble:
-	*result = (sign == '+' ? 1 : -1) * (exponent ? ldexp(mantissa * pow(5.0, exponent), exponent) : mantissa);
+			_exponent++;
+			nonZeroTail = nonZeroTail || *s != '0';
+		}
+	}
+	// The halfway point is (2 * mantissa + 1) * 2^(power2 - 1).
+	const uint32_t biasedPower = _bits >> OBJZ_FLOAT_MANTISSA_BITS;
+	uint32_t mantissa = _bits & (((uint32_t)1 << OBJZ_FLOAT_MANTISSA_BITS) - 1);
+	int64_t power2 = OBJZ_FLOAT_MIN_EXPONENT + 1 - OBJZ_FLOAT_MANTISSA_BITS; // Subnormal.
+	if (biasedPower > 0) {
+		mantissa |= (uint32_t)1 << OBJZ_FLOAT_MANTISSA_BITS;
+		power2 += biasedPower - 1;
+	}
+	BigInt halfway;
+	halfway.limbs[0] = mantissa * 2 + 1;
+	halfway.length = 1;
+	// value * 10^_exponent vs halfway * 2^(power2 - 1), scaled to integers.
+	if (_exponent >= 0)
+		bigIntMultiplyPowerOfFive(&value, (uint32_t)_exponent);
+	else
+		bigIntMultiplyPowerOfFive(&halfway, (uint32_t)-_exponent);
+	const int64_t shift = _exponent - (power2 - 1);
+	if (shift >= 0)
+		bigIntShiftLeft(&value, (uint32_t)shift);
+	else
+		bigIntShiftLeft(&halfway, (uint32_t)-shift);
+	int comparison = bigIntCompare(&value, &halfway);
+	if (comparison == 0 && nonZeroTail)
+		comparison = 1;
+	if (comparison > 0 || (comparison == 0 && (_bits & 1)))
+		return _bits + 1; // Above halfway, or exactly halfway and rounding to even.
+	return _bits;
+}
+
+// Parses [sign] digits [. digits] [(e|E) [sign] digits], or [sign] . digits [...], stopping at the first character that doesn't fit or at _end.
+// The result is correctly rounded (nearest, ties to even). Returns false if there are no digits, or an exponent has no digits.
+static bool parseFloat(const char *_text, const char *_end, float *_result) {
+	const char *p = _text;
+	bool negative = false;
+	if (p < _end && (*p == '+' || *p == '-')) {
+		negative = *p == '-';
+		p++;
+	}
+	const char *digitsStart = p;
+	uint64_t w = 0;
+	while (p < _end && IS_DIGIT(*p)) {
+		w = w * 10 + (uint64_t)(*p - '0');
+		p++;
+	}
+	int64_t numDigits = p - digitsStart;
+	int64_t exponent = 0;
+	if (p < _end && *p == '.') {
+		p++;
+		const char *fractionStart = p;
+		while (p < _end && IS_DIGIT(*p)) {
+			w = w * 10 + (uint64_t)(*p - '0');
+			p++;
+		}
+		exponent = -(p - fractionStart);
+		numDigits += p - fractionStart;
+	}
+	if (numDigits == 0)
+		return false;
+	const char *digitsEnd = p;
+	if (p < _end && (*p == 'e' || *p == 'E')) {
+		p++;
+		bool negativeExponent = false;
+		if (p < _end && (*p == '+' || *p == '-')) {
+			negativeExponent = *p == '-';
+			p++;
+		}
+		if (p >= _end || !IS_DIGIT(*p))
+			return false;
+		int64_t explicitExponent = 0;
+		for (; p < _end && IS_DIGIT(*p); p++) {
+			if (explicitExponent < 0x10000)
+				explicitExponent = explicitExponent * 10 + (*p - '0');
+		}
+		exponent += negativeExponent ? -explicitExponent : explicitExponent;
+	}
+	const int64_t digitsExponent = exponent;
+	bool truncated = false;
+	if (numDigits > OBJZ_FLOAT_MAX_DIGITS) {
+		// w overflowed, unless most of the digits are leading zeros.
+		const char *s = digitsStart;
+		for (; s < digitsEnd && (*s == '0' || *s == '.'); s++) {
+			if (*s == '0')
+				numDigits--;
+		}
+		if (numDigits > OBJZ_FLOAT_MAX_DIGITS) {
+			// Keep the most significant digits. The true value is between w and w + 1 at the same exponent.
+			truncated = true;
+			w = 0;
+			for (int i = 0; i < OBJZ_FLOAT_MAX_DIGITS; s++) {
+				if (*s != '.') {
+					w = w * 10 + (uint64_t)(*s - '0');
+					i++;
+				}
+			}
+			exponent += numDigits - OBJZ_FLOAT_MAX_DIGITS;
+		}
+	}
+	float value;
+#if FLT_EVAL_METHOD == 0
+	// Fast path, e.g. -12.345678: w and 10^|exponent| are exact floats, so a single multiply or divide rounds correctly.
+	static const float s_powersOfTen[] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+	if (!truncated && w <= ((uint64_t)1 << (OBJZ_FLOAT_MANTISSA_BITS + 1)) && exponent >= -10 && exponent <= 10) {
+		value = (float)w;
+		if (exponent < 0)
+			value /= s_powersOfTen[-exponent];
+		else
+			value *= s_powersOfTen[exponent];
+		*_result = negative ? -value : value;
+		return true;
+	}
+#endif
+	uint32_t bits = computeFloat(exponent, w);
+	if (truncated && bits != computeFloat(exponent, w + 1))
+		bits = roundFloatDigits(digitsStart, digitsEnd, digitsExponent, bits); // Too close to call from the leading digits.
+	if (negative)
+		bits |= (uint32_t)1 << 31;
+	memcpy(&value, &bits, sizeof(value));
+	*_result = value;
 	return true;
-fail:
-	return false;
 }
 
 typedef struct {
@@ -284,20 +1071,66 @@ static void vec3Normalize(vec3 *_out, const vec3 *_in) {
 	}
 }
 
-static void appendError(const char *_format, ...) {
+// Vectors of floats, for doing the same vec3 math on OBJZ_SIMD_FLOATS vectors at once, stored as a structure of arrays.
+// OBJZ_SIMD_GATHER(_v, x) makes a vector of the x components of an array of vec3 pointers.
+#if OBJZ_SIMD_WIDTH == 32
+#define OBJZ_SIMD_FLOATS 8
+typedef __m256 SimdFloats;
+#define OBJZ_SIMD_LOAD_FLOATS(_p) _mm256_loadu_ps(_p)
+#define OBJZ_SIMD_STORE_FLOATS(_p, _v) _mm256_storeu_ps(_p, _v)
+#define OBJZ_SIMD_SET_FLOATS(_f) _mm256_set1_ps(_f)
+#define OBJZ_SIMD_ADD(_a, _b) _mm256_add_ps(_a, _b)
+#define OBJZ_SIMD_SUB(_a, _b) _mm256_sub_ps(_a, _b)
+#define OBJZ_SIMD_MUL(_a, _b) _mm256_mul_ps(_a, _b)
+#define OBJZ_SIMD_DIV(_a, _b) _mm256_div_ps(_a, _b)
+#define OBJZ_SIMD_SQRT(_v) _mm256_sqrt_ps(_v)
+#define OBJZ_SIMD_GREATER_MASK(_a, _b) _mm256_cmp_ps(_a, _b, _CMP_GT_OQ)
+#define OBJZ_SIMD_SELECT(_mask, _a, _b) _mm256_blendv_ps(_b, _a, _mask)
+#define OBJZ_SIMD_GATHER(_v, _member) _mm256_setr_ps(_v[0]->_member, _v[1]->_member, _v[2]->_member, _v[3]->_member, _v[4]->_member, _v[5]->_member, _v[6]->_member, _v[7]->_member)
+#elif OBJZ_SIMD_WIDTH == 16
+#define OBJZ_SIMD_FLOATS 4
+typedef __m128 SimdFloats;
+#define OBJZ_SIMD_LOAD_FLOATS(_p) _mm_loadu_ps(_p)
+#define OBJZ_SIMD_STORE_FLOATS(_p, _v) _mm_storeu_ps(_p, _v)
+#define OBJZ_SIMD_SET_FLOATS(_f) _mm_set1_ps(_f)
+#define OBJZ_SIMD_ADD(_a, _b) _mm_add_ps(_a, _b)
+#define OBJZ_SIMD_SUB(_a, _b) _mm_sub_ps(_a, _b)
+#define OBJZ_SIMD_MUL(_a, _b) _mm_mul_ps(_a, _b)
+#define OBJZ_SIMD_DIV(_a, _b) _mm_div_ps(_a, _b)
+#define OBJZ_SIMD_SQRT(_v) _mm_sqrt_ps(_v)
+#define OBJZ_SIMD_GREATER_MASK(_a, _b) _mm_cmpgt_ps(_a, _b)
+#define OBJZ_SIMD_SELECT(_mask, _a, _b) _mm_or_ps(_mm_and_ps(_mask, _a), _mm_andnot_ps(_mask, _b))
+#define OBJZ_SIMD_GATHER(_v, _member) _mm_setr_ps(_v[0]->_member, _v[1]->_member, _v[2]->_member, _v[3]->_member)
+#endif
+
+static void appendError(objzContext *_ctx, const char *_format, ...) {
 	va_list args;
 	va_start(args, _format);
 	char buffer[OBJZ_MAX_ERROR_LENGTH];
 	vsnprintf(buffer, sizeof(buffer), _format, args);
 	va_end(args);
-	if (s_error[0]) {
+	if (_ctx->error[0]) {
 		const char *newline = "\n";
-		strConcat(s_error, sizeof(s_error), newline, 1);
+		strConcat(_ctx->error, sizeof(_ctx->error), newline, 1);
 	}
-	strConcat(s_error, sizeof(s_error), buffer, strLength(buffer, sizeof(buffer)));
+	strConcat(_ctx->error, sizeof(_ctx->error), buffer, strLength(buffer, sizeof(buffer)));
+}
+
+// Polled by long running loops, on any thread, so a cancelled load stops within milliseconds.
+static bool loadCancelled(const objzContext *_ctx) {
+	return _ctx->cancel && atomicFlagGet(_ctx->cancel);
+}
+
+// Like loadCancelled, and fails the load with an error. Only called on the thread that owns _ctx's error.
+static bool checkCancelled(objzContext *_ctx) {
+	if (!loadCancelled(_ctx))
+		return false;
+	appendError(_ctx, "Load cancelled");
+	return true;
 }
 
 typedef struct {
+	objzContext *ctx;
 	uint8_t *data;
 	uint32_t length;
 	uint32_t capacity;
@@ -305,7 +1138,8 @@ typedef struct {
 	uint32_t initialCapacity;
 } Array;
 
-static void arrayInit(Array *_array, size_t _elementSize, uint32_t _initialCapacity) {
+static void arrayInit(Array *_array, objzContext *_ctx, size_t _elementSize, uint32_t _initialCapacity) {
+	_array->ctx = _ctx;
 	_array->data = NULL;
 	_array->length = _array->capacity = 0;
 	_array->elementSize = (uint32_t)_elementSize;
@@ -313,156 +1147,341 @@ static void arrayInit(Array *_array, size_t _elementSize, uint32_t _initialCapac
 }
 
 static void arrayDestroy(Array *_array) {
-	OBJZ_FREE(_array->data);
+	OBJZ_FREE(_array->ctx, _array->data);
 }
 
 static void arrayAppend(Array *_array, const void *_element) {
 	if (!_array->data) {
-		_array->data = OBJZ_MALLOC(_array->elementSize * _array->initialCapacity);
+		_array->data = OBJZ_MALLOC(_array->ctx, _array->elementSize * _array->initialCapacity);
 		_array->capacity = _array->initialCapacity;
 	} else if (_array->length == _array->capacity) {
 		_array->capacity *= 2;
-		_array->data = OBJZ_REALLOC(_array->data, _array->capacity * _array->elementSize);
+		_array->data = OBJZ_REALLOC(_array->ctx, _array->data, _array->capacity * _array->elementSize);
 	}
 	memcpy(&_array->data[_array->length * _array->elementSize], _element, _array->elementSize);
 	_array->length++;
 }
 
+// The array's elements in memory for the model, which outlives the arena. NULL if empty.
+static void *arrayCopyToOutput(const Array *_array) {
+	if (_array->length == 0)
+		return NULL;
+	void *data = OBJZ_OUTPUT_MALLOC(_array->ctx, _array->elementSize * _array->length);
+	memcpy(data, _array->data, _array->elementSize * _array->length);
+	return data;
+}
+
 #define OBJZ_ARRAY_ELEMENT(_array, _index) (void *)&(_array).data[(_array).elementSize * (_index)]
 
 // Array: reallocates the buffer when full. The buffer is a contiguous area of memory.
 // ChunkedArray: allocates another chunk of memory when full. Buffer is a linked list of chunks, not contiguous.
 typedef struct {
 	Array chunks;
-	uint32_t elementsPerChunk;
+	uint32_t elementsPerChunk; // A power of two, so finding an element's chunk is a shift.
+	uint32_t chunkShift;
 	size_t elementSize;
 	uint32_t length;
+	uint32_t capacity; // Elements allocated. The first chunk can be smaller than elementsPerChunk, see chunkedArrayReserve.
+	uint32_t firstChunkLength; // 0: elementsPerChunk.
 } ChunkedArray;
 
-static void chunkedArrayInit(ChunkedArray *_array, size_t _elementSize, uint32_t _chunkLength) {
-	arrayInit(&_array->chunks, sizeof(void *), 32);
-	_array->elementsPerChunk = _chunkLength;
+static void chunkedArraySetChunkLength(ChunkedArray *_array, uint32_t _chunkLength) {
+	_array->chunkShift = 0;
+	while ((1u << _array->chunkShift) < _chunkLength && _array->chunkShift < 31)
+		_array->chunkShift++;
+	_array->elementsPerChunk = 1u << _array->chunkShift;
+}
+
+static void chunkedArrayInit(ChunkedArray *_array, objzContext *_ctx, size_t _elementSize, uint32_t _chunkLength) {
+	arrayInit(&_array->chunks, _ctx, sizeof(void *), 32);
+	chunkedArraySetChunkLength(_array, _chunkLength);
 	_array->elementSize = _elementSize;
 	_array->length = 0;
+	_array->capacity = 0;
+	_array->firstChunkLength = 0;
+}
+
+// Before anything is appended, make the first chunk exactly _count elements, so if the count is right, the array is one contiguous allocation.
+static void chunkedArrayReserve(ChunkedArray *_array, uint32_t _count) {
+	if (_array->chunks.length > 0 || _count == 0)
+		return;
+	_count = OBJZ_SMALLEST(_count, 1u << 31); // Largest chunk length.
+	chunkedArraySetChunkLength(_array, _count);
+	_array->firstChunkLength = _count;
+}
+
+// Make room for at least one more element.
+static void chunkedArrayGrow(ChunkedArray *_array) {
+	objzContext *ctx = _array->chunks.ctx;
+	if (_array->chunks.length == 1 && _array->capacity < _array->elementsPerChunk) {
+		// The reserved first chunk was too small: grow it to a full chunk.
+		void **chunk = OBJZ_ARRAY_ELEMENT(_array->chunks, 0);
+		*chunk = OBJZ_REALLOC(ctx, *chunk, _array->elementsPerChunk * _array->elementSize);
+		_array->capacity = _array->elementsPerChunk;
+		return;
+	}
+	const uint32_t length = _array->chunks.length == 0 && _array->firstChunkLength ? _array->firstChunkLength : _array->elementsPerChunk;
+	void *newChunk = OBJZ_MALLOC(ctx, length * _array->elementSize);
+	arrayAppend(&_array->chunks, &newChunk);
+	_array->capacity += length;
 }
 
 static void chunkedArrayDestroy(ChunkedArray *_array) {
 	for (uint32_t i = 0; i < _array->chunks.length; i++) {
 		void **chunk = OBJZ_ARRAY_ELEMENT(_array->chunks, i);
-		OBJZ_FREE(*chunk);
+		OBJZ_FREE(_array->chunks.ctx, *chunk);
 	}
 	arrayDestroy(&_array->chunks);
 }
 
 static void chunkedArrayAppend(ChunkedArray *_array, const void *_element) {
-	if (_array->length >= _array->chunks.length * _array->elementsPerChunk) {
-		void *newChunk = OBJZ_MALLOC(_array->elementsPerChunk * _array->elementSize);
-		arrayAppend(&_array->chunks, &newChunk);
-	}
-	uint8_t **chunk = OBJZ_ARRAY_ELEMENT(_array->chunks, _array->length / _array->elementsPerChunk);
-	memcpy(&(*chunk)[_array->elementSize * (_array->length % _array->elementsPerChunk)], _element, _array->elementSize);
+	if (_array->length >= _array->capacity)
+		chunkedArrayGrow(_array);
+	uint8_t **chunk = OBJZ_ARRAY_ELEMENT(_array->chunks, _array->length >> _array->chunkShift);
+	memcpy(&(*chunk)[_array->elementSize * (_array->length & (_array->elementsPerChunk - 1))], _element, _array->elementSize);
 	_array->length++;
 }
 
+static void chunkedArrayAppendMany(ChunkedArray *_array, const void *_elements, uint32_t _count) {
+	const uint8_t *src = (const uint8_t *)_elements;
+	while (_count > 0) {
+		if (_array->length >= _array->capacity)
+			chunkedArrayGrow(_array);
+		const uint32_t offset = _array->length & (_array->elementsPerChunk - 1);
+		const uint32_t n = OBJZ_SMALLEST(_count, _array->capacity - _array->length);
+		uint8_t **chunk = OBJZ_ARRAY_ELEMENT(_array->chunks, _array->length >> _array->chunkShift);
+		memcpy(&(*chunk)[_array->elementSize * offset], src, _array->elementSize * n);
+		src += _array->elementSize * n;
+		_array->length += n;
+		_count -= n;
+	}
+}
+
 static void *chunkedArrayElement(const ChunkedArray *_array, uint32_t _index) {
-	uint8_t **chunk = OBJZ_ARRAY_ELEMENT(_array->chunks, _index / _array->elementsPerChunk);
-	return &(*chunk)[_array->elementSize * (_index % _array->elementsPerChunk)];
+	uint8_t **chunk = OBJZ_ARRAY_ELEMENT(_array->chunks, _index >> _array->chunkShift);
+	return &(*chunk)[_array->elementSize * (_index & (_array->elementsPerChunk - 1))];
+}
+
+// Vectorized scanning for line and token boundaries.
+#if OBJZ_SIMD_WIDTH == 32
+typedef __m256i SimdBytes;
+#define OBJZ_SIMD_LOAD(_p) _mm256_loadu_si256((const __m256i *)(_p))
+#define OBJZ_SIMD_STORE(_p, _v) _mm256_storeu_si256((__m256i *)(_p), _v)
+#define OBJZ_SIMD_EQUAL_MASK(_v, _c) (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_v, _mm256_set1_epi8(_c)))
+#elif OBJZ_SIMD_WIDTH == 16
+typedef __m128i SimdBytes;
+#define OBJZ_SIMD_LOAD(_p) _mm_loadu_si128((const __m128i *)(_p))
+#define OBJZ_SIMD_STORE(_p, _v) _mm_storeu_si128((__m128i *)(_p), _v)
+#define OBJZ_SIMD_EQUAL_MASK(_v, _c) (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_v, _mm_set1_epi8(_c)))
+#endif
+
+#if OBJZ_SIMD_WIDTH
+static uint32_t countTrailingZeros(uint32_t _mask) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, _mask);
+	return (uint32_t)index;
+#else
+	return (uint32_t)__builtin_ctz(_mask);
+#endif
+}
+#endif
+
+// Returns NULL if there is no newline before _end.
+static const char *findNewline(const char *_buf, const char *_end) {
+#if OBJZ_SIMD_WIDTH
+	for (; _end - _buf >= OBJZ_SIMD_WIDTH; _buf += OBJZ_SIMD_WIDTH) {
+		const uint32_t mask = OBJZ_SIMD_EQUAL_MASK(OBJZ_SIMD_LOAD(_buf), '\n');
+		if (mask)
+			return _buf + countTrailingZeros(mask);
+	}
+#endif
+	for (; _buf < _end; _buf++) {
+		if (*_buf == '\n')
+			return _buf;
+	}
+	return NULL;
 }
 
+// Lines are not null terminated, the lexer stops at end.
 typedef struct {
-	char *buf;
-	uint32_t line, column;
+	const char *buf;
+	const char *end;
+	const char *bufferEnd; // Memory is readable up to here, at or after end. Lines are usually followed by the rest of the file, so tokens can be scanned a vector at a time.
+	const char *lineStart;
+	uint32_t line;
 } Lexer;
 
+// A slice of the current line, not null terminated.
 typedef struct {
-	char text[OBJZ_MAX_TOKEN_LENGTH];
-	uint32_t line, column;
+	const char *text;
+	uint32_t length;
 } Token;
 
 static void initLexer(Lexer *_lexer) {
-	_lexer->buf = NULL;
-	_lexer->column = 1;
+	_lexer->buf = _lexer->end = _lexer->bufferEnd = _lexer->lineStart = NULL;
 	_lexer->line = 0;
 }
 
 static bool isEol(const Lexer *_lexer) {
-	return (_lexer->buf[0] == 0);
+	return (_lexer->buf >= _lexer->end);
 }
 
-static bool isWhitespace(const Lexer *_lexer) {
-	return (_lexer->buf[0] == ' ' || _lexer->buf[0] == '\t' || _lexer->buf[0] == '\r');
+static bool isWhitespaceChar(char _c) {
+	return _c == ' ' || _c == '\t' || _c == '\r';
 }
 
 static void skipWhitespace(Lexer *_lexer) {
-	for (;;) {
-		if (isEol(_lexer))
-			break;
-		if (!isWhitespace(_lexer))
-			break;
+	// Usually a single space, not worth vectorizing.
+	while (!isEol(_lexer) && isWhitespaceChar(_lexer->buf[0]))
 		_lexer->buf++;
-		_lexer->column++;
-	}
 }
 
-static void lexerSetLine(Lexer *_lexer, char *_buf) {
-	_lexer->column = 1;
+static void lexerSetLine(Lexer *_lexer, const char *_buf, size_t _length, const char *_bufferEnd) {
 	_lexer->line++;
-	_lexer->buf = _buf;
+	_lexer->buf = _lexer->lineStart = _buf;
+	_lexer->end = _buf + _length;
+	_lexer->bufferEnd = _bufferEnd;
 }
 
 static void tokenize(Lexer *_lexer, Token *_token, bool includeWhitespace) {
-	uint32_t i = 0;
 	skipWhitespace(_lexer);
-	_token->line = _lexer->line;
-	_token->column = _lexer->column;
-	for (;;) {
-		if (isEol(_lexer) || (!includeWhitespace && isWhitespace(_lexer)))
-			break;
-		_token->text[i++] = _lexer->buf[0];
-		_lexer->buf++;
-		_lexer->column++;
+	const char *start = _lexer->buf;
+	if (includeWhitespace) {
+		_lexer->buf = _lexer->end;
+	} else {
+		bool foundEnd = false;
+#if OBJZ_SIMD_WIDTH
+		while (!foundEnd && _lexer->bufferEnd - _lexer->buf >= OBJZ_SIMD_WIDTH) {
+			const SimdBytes v = OBJZ_SIMD_LOAD(_lexer->buf);
+			uint32_t mask = OBJZ_SIMD_EQUAL_MASK(v, ' ') | OBJZ_SIMD_EQUAL_MASK(v, '\t') | OBJZ_SIMD_EQUAL_MASK(v, '\r');
+			const ptrdiff_t remaining = _lexer->end - _lexer->buf;
+			if (remaining < OBJZ_SIMD_WIDTH)
+				mask |= UINT32_MAX << remaining; // Past the end of the line.
+			_lexer->buf += mask ? countTrailingZeros(mask) : OBJZ_SIMD_WIDTH;
+			foundEnd = mask != 0;
+		}
+#endif
+		while (!foundEnd && !isEol(_lexer) && !isWhitespaceChar(_lexer->buf[0]))
+			_lexer->buf++;
+	}
+	_token->text = start;
+	_token->length = (uint32_t)(_lexer->buf - start);
+}
+
+// Only needed for error messages, so it isn't tracked while tokenizing.
+static uint32_t tokenColumn(const Lexer *_lexer, const Token *_token) {
+	return (uint32_t)(_token->text - _lexer->lineStart) + 1;
+}
+
+// Case insensitive.
+static bool tokenEquals(const Token *_token, const char *_str) {
+	return strlen(_str) == _token->length && OBJZ_STRNICMP(_token->text, _str, _token->length) == 0;
+}
+
+// Same as atoi, but stops at the end of the token.
+static int32_t tokenToInt(const char *_text, const char *_end) {
+	bool negative = false;
+	if (_text < _end && (*_text == '+' || *_text == '-')) {
+		negative = *_text == '-';
+		_text++;
 	}
-	_token->text[i] = 0;
+	uint32_t value = 0;
+	for (; _text < _end && IS_DIGIT(*_text); _text++)
+		value = value * 10 + (uint32_t)(*_text - '0');
+	return (int32_t)(negative ? 0u - value : value);
 }
 
-static bool parseFloats(Lexer *_lexer, float *_result, uint32_t n) {
+static bool parseFloats(objzContext *_ctx, Lexer *_lexer, float *_result, uint32_t n) {
 	Token token;
 	for (uint32_t i = 0; i < n; i++) {
 		tokenize(_lexer, &token, false);
-		const size_t len = strLength(token.text, sizeof(token.text));
-		if (len == 0) {
-			appendError("(%u:%u) Empty float string", token.line, token.column);
+		if (token.length == 0) {
+			appendError(_ctx, "(%u:%u) Empty float string", _lexer->line, tokenColumn(_lexer, &token));
 			return false;
 		}
-		double value;
-		if (!tryParseDouble(token.text, token.text + len, &value)) {
-			appendError("(%u:%u) Error parsing float", token.line, token.column);
+		if (!parseFloat(token.text, token.text + token.length, &_result[i])) {
+			appendError(_ctx, "(%u:%u) Error parsing float", _lexer->line, tokenColumn(_lexer, &token));
 			return false;
 		}
-		_result[i] = (float)value;
 	}
 	return true;
 }
 
-static bool skipTokens(Lexer *_lexer, int _n) {
+static bool skipTokens(objzContext *_ctx, Lexer *_lexer, int _n) {
 	Token token;
 	for (int i = 0; i < _n; i++) {
 		tokenize(_lexer, &token, false);
-		if (strLength(token.text, sizeof(token.text)) == 0) {
-			appendError("(%u:%u) Error skipping tokens", token.line, token.column);
+		if (token.length == 0) {
+			appendError(_ctx, "(%u:%u) Error skipping tokens", _lexer->line, tokenColumn(_lexer, &token));
 			return false;
 		}
 	}
 	return true;
 }
 
+#define OBJZ_FILE_STORAGE_USER   0 // Caller-owned memory, e.g. objz_loadFromMemory.
+#define OBJZ_FILE_STORAGE_HEAP   1
+#define OBJZ_FILE_STORAGE_MAPPED 2
+
+// The file contents are memory mapped if possible, otherwise read into an allocated buffer. Either way the buffer is not null terminated, and read-only unless opened writable: a copy-on-write mapping, changes aren't written to the file.
 typedef struct {
-	char *buffer;
+	const char *buffer;
 	size_t length;
 	size_t pos;
+	uint32_t storage;
 } File;
 
-bool fileOpen(File *_file, const char *_filename) {
+#if OBJZ_MMAP
+static bool fileMap(File *_file, const char *_filename, bool _writable) {
+#ifdef _WIN32
+	HANDLE handle = CreateFileA(_filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (handle == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0 || (uint64_t)size.QuadPart > SIZE_MAX) {
+		CloseHandle(handle);
+		return false;
+	}
+	HANDLE mapping = CreateFileMappingA(handle, NULL, _writable ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(handle);
+	if (!mapping)
+		return false;
+	const void *view = MapViewOfFile(mapping, _writable ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping); // The view keeps the mapping alive.
+	if (!view)
+		return false;
+	_file->length = (size_t)size.QuadPart;
+#else
+	const int fd = open(_filename, O_RDONLY);
+	if (fd == -1)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0 || (uint64_t)st.st_size > SIZE_MAX) {
+		close(fd);
+		return false;
+	}
+	void *view = mmap(NULL, (size_t)st.st_size, _writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // The mapping keeps the file open.
+	if (view == MAP_FAILED)
+		return false;
+	// Lines are parsed front to back, once.
+	if (!_writable)
+		posix_madvise(view, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+	_file->length = (size_t)st.st_size;
+#endif
+	_file->buffer = view;
+	_file->pos = 0;
+	_file->storage = OBJZ_FILE_STORAGE_MAPPED;
+	return true;
+}
+#endif
+
+static bool fileOpen(objzContext *_ctx, File *_file, const char *_filename) {
+#if OBJZ_MMAP
+	if (fileMap(_file, _filename, false))
+		return true;
+#endif
 	FILE *handle;
 	OBJZ_FOPEN(handle, _filename, "rb");
 	if (!handle)
@@ -475,61 +1494,169 @@ bool fileOpen(File *_file, const char *_filename) {
 		return false;
 	}
 	_file->pos = 0;
-	_file->buffer = OBJZ_MALLOC(_file->length + 1);
+	_file->storage = OBJZ_FILE_STORAGE_HEAP;
+	char *buffer = OBJZ_MALLOC(_ctx, _file->length);
 	const size_t chunkSize = 8192;
 	size_t totalBytesRead = 0;
 	int progress = 0;
 	for (;;) {
 		const size_t bytesRemaining = _file->length - totalBytesRead;
 		const size_t bytesRequested = bytesRemaining > chunkSize ? chunkSize : bytesRemaining;
-		const size_t bytesRead = fread(&_file->buffer[totalBytesRead], 1, bytesRequested, handle);
+		const size_t bytesRead = fread(&buffer[totalBytesRead], 1, bytesRequested, handle);
 		totalBytesRead += bytesRead;
-		if (s_progress) {
+		if (_ctx->progressFunc) {
 			const int newProgress = (int)(totalBytesRead / (float)_file->length * 50.0f);
 			if (newProgress > progress) {
 				progress = newProgress;
-				s_progress(_filename, progress);
+				_ctx->progressFunc(_filename, progress);
 			}
 		}
 		if (totalBytesRead == _file->length) {
 			fclose(handle);
 			break;
-		} else if (bytesRead < bytesRequested) {
+		} else if (bytesRead < bytesRequested || loadCancelled(_ctx)) {
 			fclose(handle);
-			OBJZ_FREE(_file->buffer);
+			OBJZ_FREE(_ctx, buffer);
 			return false;
 		}
 	}
-	_file->buffer[_file->length] = 0;
+	_file->buffer = buffer;
+	return true;
+}
+
+static void fileClose(objzContext *_ctx, File *_file) {
+#if OBJZ_MMAP
+	if (_file->storage == OBJZ_FILE_STORAGE_MAPPED) {
+#ifdef _WIN32
+		UnmapViewOfFile(_file->buffer);
+#else
+		munmap((void *)_file->buffer, _file->length);
+#endif
+		return;
+	}
+#endif
+	if (_file->storage == OBJZ_FILE_STORAGE_HEAP)
+		OBJZ_FREE(_ctx, (void *)_file->buffer);
+}
+
+static void fileOpenMemory(File *_file, const void *_data, size_t _size) {
+	_file->buffer = (const char *)_data;
+	_file->length = _size;
+	_file->pos = 0;
+	_file->storage = OBJZ_FILE_STORAGE_USER;
+}
+
+// Size and last modification time of a file. The time is 0 if it isn't available, e.g. without OBJZ_MMAP the platform headers aren't included.
+static bool fileStat(const char *_filename, uint64_t *_size, uint64_t *_modifiedTime) {
+#if OBJZ_MMAP && defined(_WIN32)
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesExA(_filename, GetFileExInfoStandard, &data))
+		return false;
+	*_size = ((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+	*_modifiedTime = ((uint64_t)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+#elif OBJZ_MMAP
+	struct stat st;
+	if (stat(_filename, &st) != 0)
+		return false;
+	*_size = (uint64_t)st.st_size;
+	// Nanoseconds: a second is long enough to save a cache and edit the source.
+#if defined(__APPLE__) && defined(_POSIX_C_SOURCE) && !defined(_DARWIN_C_SOURCE)
+	*_modifiedTime = (uint64_t)st.st_mtime * 1000000000 + (uint64_t)st.st_mtimensec;
+#elif defined(__APPLE__)
+	*_modifiedTime = (uint64_t)st.st_mtimespec.tv_sec * 1000000000 + (uint64_t)st.st_mtimespec.tv_nsec;
+#else
+	*_modifiedTime = (uint64_t)st.st_mtim.tv_sec * 1000000000 + (uint64_t)st.st_mtim.tv_nsec;
+#endif
+#else
+	FILE *handle;
+	OBJZ_FOPEN(handle, _filename, "rb");
+	if (!handle)
+		return false;
+	fseek(handle, 0, SEEK_END);
+	*_size = (uint64_t)ftell(handle);
+	fclose(handle);
+	*_modifiedTime = 0;
+#endif
 	return true;
 }
 
-void fileClose(File *_file) {
-	OBJZ_FREE(_file->buffer);
+// File times can be this coarse, e.g. 2 seconds on FAT. In fileStat's units.
+#if OBJZ_MMAP && defined(_WIN32)
+#define OBJZ_FILE_TIME_RESOLUTION UINT64_C(20000000)
+#else
+#define OBJZ_FILE_TIME_RESOLUTION UINT64_C(2000000000)
+#endif
+
+// The current time, comparable with fileStat's modification times. 0 if it isn't available.
+static uint64_t fileTimeNow(void) {
+#if OBJZ_MMAP && defined(_WIN32)
+	FILETIME time;
+	GetSystemTimeAsFileTime(&time);
+	return ((uint64_t)time.dwHighDateTime << 32) | time.dwLowDateTime;
+#elif OBJZ_MMAP
+	struct timespec time;
+	if (clock_gettime(CLOCK_REALTIME, &time) != 0)
+		return 0;
+	return (uint64_t)time.tv_sec * 1000000000 + (uint64_t)time.tv_nsec;
+#else
+	return 0;
+#endif
+}
+
+// FNV-1a, 8 bytes at a time. Only used to tell if a file has changed.
+static uint64_t hashBytes(const void *_data, size_t _size) {
+	const uint8_t *data = (const uint8_t *)_data;
+	uint64_t hash = UINT64_C(14695981039346656037);
+	size_t i = 0;
+	for (; i + 8 <= _size; i += 8) {
+		uint64_t word;
+		memcpy(&word, &data[i], sizeof(word));
+		hash = (hash ^ word) * UINT64_C(1099511628211);
+	}
+	for (; i < _size; i++)
+		hash = (hash ^ data[i]) * UINT64_C(1099511628211);
+	return hash;
 }
 
-char *fileReadLine(File *_file) {
-	if (_file->buffer[_file->pos] == 0)
+// Returns NULL on eof. The buffer isn't modified: _length is set to the line length, excluding the newline and any carriage return before it.
+static const char *fileReadLine(File *_file, size_t *_length) {
+	if (_file->pos >= _file->length)
 		return NULL; // eof
-	char *start = &_file->buffer[_file->pos];
-	// Find eol. Newline is replaced with a null terminator. Position is set to the start of the next line.
-	for (;;) {
-		char *c = &_file->buffer[_file->pos];
-		if (*c == 0) {
-			break;
-		}
-		if (*c == '\r')
-			*c = 0; // Null terminate here, but keep reading until newline.
-		else if (*c == '\n') {
-			*c = 0;
-			_file->pos++;
-			break;
-		}
-		_file->pos++;
+	const char *start = &_file->buffer[_file->pos];
+	const size_t remaining = _file->length - _file->pos;
+	const char *newline = findNewline(start, start + remaining);
+	size_t length;
+	if (newline) {
+		length = (size_t)(newline - start);
+		_file->pos += length + 1;
+	} else {
+		length = remaining;
+		_file->pos = _file->length;
 	}
+	if (length > 0 && start[length - 1] == '\r')
+		length--;
+	*_length = length;
 	return start;
 }
 
+static bool fileCheckEncoding(objzContext *_ctx, const File *_file, const char *_filename) {
+	uint8_t bom[4] = { 0 };
+	memcpy(bom, _file->buffer, OBJZ_SMALLEST(_file->length, sizeof(bom)));
+	uint32_t bom32;
+	memcpy(&bom32, bom, sizeof(bom32));
+	if (bom32 == 0x0000feff || bom32 == 0xfffe0000) {
+		appendError(_ctx, "UTF-32 encoding not supported in file '%s'", _filename);
+		return false;
+	}
+	uint16_t bom16;
+	memcpy(&bom16, bom, sizeof(bom16));
+	if (bom16 == 0xfffe || bom16 == 0xfeff) {
+		appendError(_ctx, "UTF-16 encoding not supported in file '%s'", _filename);
+		return false;
+	}
+	return true;
+}
+
 #define OBJZ_MAT_TOKEN_STRING 0
 #define OBJZ_MAT_TOKEN_FLOAT  1
 
@@ -577,40 +1704,220 @@ static MaterialMapArg s_materialMapArgs[] = {
 	{ "-type", 1 }
 };
 
+// Keywords of obj statements, mtl statements and texture map options. Looked up with a perfect hash, see lookupKeyword.
+#define OBJZ_KEYWORD_NONE   0
+#define OBJZ_KEYWORD_F      1
+#define OBJZ_KEYWORD_G      2
+#define OBJZ_KEYWORD_O      3
+#define OBJZ_KEYWORD_S      4
+#define OBJZ_KEYWORD_V      5
+#define OBJZ_KEYWORD_VN     6
+#define OBJZ_KEYWORD_VT     7
+#define OBJZ_KEYWORD_MTLLIB 8
+#define OBJZ_KEYWORD_USEMTL 9
+#define OBJZ_KEYWORD_NEWMTL 10
+#define OBJZ_KEYWORD_MATERIAL_PROPERTY 11 // s_materialProperties[keyword - OBJZ_KEYWORD_MATERIAL_PROPERTY]
+#define OBJZ_KEYWORD_MATERIAL_MAP_ARG (OBJZ_KEYWORD_MATERIAL_PROPERTY + (uint32_t)OBJZ_RAW_ARRAY_LEN(s_materialProperties)) // s_materialMapArgs[keyword - OBJZ_KEYWORD_MATERIAL_MAP_ARG]
+#define OBJZ_NUM_KEYWORDS (OBJZ_KEYWORD_MATERIAL_MAP_ARG + (uint32_t)OBJZ_RAW_ARRAY_LEN(s_materialMapArgs))
+
+static const char *s_statementKeywords[] = { NULL, "f", "g", "o", "s", "v", "vn", "vt", "mtllib", "usemtl", "newmtl" };
+
+// Indexed by keywordHash. Every keyword hashes to a different slot, tests.c checks that they are all found.
+static const uint8_t s_keywordHashTable[64] = {
+	0, 0, 0, 0, 2, 0, 27, 0, 36, 0, 0, 0, 0, 19, 29, 22,
+	28, 33, 18, 0, 7, 0, 1, 0, 20, 0, 24, 12, 8, 15, 23, 0,
+	25, 0, 10, 17, 30, 0, 13, 0, 0, 0, 34, 16, 4, 32, 0, 0,
+	0, 21, 0, 35, 3, 9, 5, 0, 0, 26, 11, 0, 0, 31, 6, 14
+};
+
+static uint32_t asciiLower(char _c) {
+	return (_c >= 'A' && _c <= 'Z') ? (uint32_t)(_c - 'A' + 'a') : (uint32_t)(uint8_t)_c;
+}
+
+static const char *keywordName(uint32_t _keyword) {
+	if (_keyword < OBJZ_KEYWORD_MATERIAL_PROPERTY)
+		return s_statementKeywords[_keyword];
+	if (_keyword < OBJZ_KEYWORD_MATERIAL_MAP_ARG)
+		return s_materialProperties[_keyword - OBJZ_KEYWORD_MATERIAL_PROPERTY].name;
+	return s_materialMapArgs[_keyword - OBJZ_KEYWORD_MATERIAL_MAP_ARG].name;
+}
+
+// _length must be greater than 0.
+static uint32_t keywordHash(const char *_text, uint32_t _length) {
+	const uint32_t secondLast = _length > 1 ? asciiLower(_text[_length - 2]) : 0;
+	return (_length * 2 + asciiLower(_text[0]) * 21 + asciiLower(_text[_length - 1]) * 25 + secondLast * 5) & 63;
+}
+
+// Case insensitive. Returns OBJZ_KEYWORD_NONE if the token isn't a keyword.
+static uint32_t lookupKeyword(const Token *_token) {
+	if (_token->length == 0)
+		return OBJZ_KEYWORD_NONE;
+	const uint32_t keyword = s_keywordHashTable[keywordHash(_token->text, _token->length)];
+	if (keyword == OBJZ_KEYWORD_NONE)
+		return OBJZ_KEYWORD_NONE;
+	const char *name = keywordName(keyword);
+	for (uint32_t i = 0; i < _token->length; i++) {
+		if (name[i] == 0 || asciiLower(name[i]) != asciiLower(_token->text[i]))
+			return OBJZ_KEYWORD_NONE;
+	}
+	return name[_token->length] == 0 ? keyword : OBJZ_KEYWORD_NONE;
+}
+
 static void materialInit(objzMaterial *_mat) {
 	memset(_mat, 0, sizeof(*_mat));
 	_mat->diffuse[0] = _mat->diffuse[1] = _mat->diffuse[2] = 1;
 	_mat->opacity = 1;
 }
 
-static bool loadMaterialFile(const char *_objFilename, const char *_materialName, Array *_materials) {
-	char filename[256] = { 0 };
-	const char *lastSlash = strrchr(_objFilename, '/');
-	if (!lastSlash)
-		lastSlash = strrchr(_objFilename, '\\');
-	if (lastSlash) {
-		for (int i = 0;; i++) {
-			filename[i] = _objFilename[i];
-			if (&_objFilename[i] == lastSlash)
-				break;
+// Identifies the contents of a file without comparing them, by size and either modification time or hash. A field that isn't known is 0.
+typedef struct {
+	uint64_t size;
+	uint64_t modifiedTime;
+	uint64_t hash;
+} FileIdentity;
+
+// A parsed material file. One allocation: the struct, then the materials, then the null terminated name.
+typedef struct MaterialLibrary {
+	struct MaterialLibrary *next;
+	FileIdentity identity;
+	objzMaterial *materials;
+	uint32_t numMaterials;
+	const char *name; // Path, or name passed to objzMtllibResolveFunc.
+} MaterialLibrary;
+
+// Libraries are immutable once added. The mutex is held while copying materials out, so a changed library can replace the old one.
+struct objzMaterialCache {
+	objzReallocFunc reallocFunc;
+	Mutex mutex;
+	MaterialLibrary *libraries;
+};
+
+objzMaterialCache *objz_createMaterialCache(objzReallocFunc _realloc) {
+	objzMaterialCache *cache = callRealloc(_realloc, NULL, sizeof(objzMaterialCache), __FILE__, __LINE__);
+	cache->reallocFunc = _realloc;
+	mutexInit(&cache->mutex);
+	cache->libraries = NULL;
+	return cache;
+}
+
+void objz_destroyMaterialCache(objzMaterialCache *_cache) {
+	if (!_cache)
+		return;
+	MaterialLibrary *library = _cache->libraries;
+	while (library) {
+		MaterialLibrary *next = library->next;
+		callRealloc(_cache->reallocFunc, library, 0, __FILE__, __LINE__);
+		library = next;
+	}
+	mutexDestroy(&_cache->mutex);
+	callRealloc(_cache->reallocFunc, _cache, 0, __FILE__, __LINE__);
+}
+
+// Append the library's materials to _materials if it's cached with the same size, and the same modification time or hash.
+static bool materialCacheFind(objzMaterialCache *_cache, const char *_name, const FileIdentity *_identity, Array *_materials) {
+	bool found = false;
+	mutexLock(&_cache->mutex);
+	for (const MaterialLibrary *library = _cache->libraries; library; library = library->next) {
+		if (strcmp(library->name, _name) == 0) {
+			const FileIdentity *cached = &library->identity;
+			if (cached->size == _identity->size && ((cached->modifiedTime != 0 && cached->modifiedTime == _identity->modifiedTime) || (cached->hash != 0 && cached->hash == _identity->hash))) {
+				for (uint32_t i = 0; i < library->numMaterials; i++)
+					arrayAppend(_materials, &library->materials[i]);
+				found = true;
+			}
+			break;
 		}
-		strConcat(filename, sizeof(filename), _materialName, strLength(_materialName, OBJZ_MAX_TOKEN_LENGTH));
-	} else
-		strCopy(filename, sizeof(filename), _materialName, strLength(_materialName, OBJZ_MAX_TOKEN_LENGTH));
+	}
+	mutexUnlock(&_cache->mutex);
+	return found;
+}
+
+// Add or replace a library: _numMaterials materials from the end of _materials.
+static void materialCacheAdd(objzMaterialCache *_cache, const char *_name, const FileIdentity *_identity, const Array *_materials, uint32_t _numMaterials) {
+	const size_t nameSize = strlen(_name) + 1;
+	MaterialLibrary *library = callRealloc(_cache->reallocFunc, NULL, sizeof(MaterialLibrary) + sizeof(objzMaterial) * _numMaterials + nameSize, __FILE__, __LINE__);
+	library->identity = *_identity;
+	library->materials = (objzMaterial *)(library + 1);
+	library->numMaterials = _numMaterials;
+	if (_numMaterials > 0)
+		memcpy(library->materials, OBJZ_ARRAY_ELEMENT(*_materials, _materials->length - _numMaterials), sizeof(objzMaterial) * _numMaterials);
+	char *name = (char *)&library->materials[_numMaterials];
+	memcpy(name, _name, nameSize);
+	library->name = name;
+	mutexLock(&_cache->mutex);
+	MaterialLibrary **link = &_cache->libraries;
+	while (*link && strcmp((*link)->name, _name) != 0)
+		link = &(*link)->next;
+	MaterialLibrary *old = *link;
+	library->next = old ? old->next : NULL;
+	*link = library;
+	mutexUnlock(&_cache->mutex);
+	if (old)
+		callRealloc(_cache->reallocFunc, old, 0, __FILE__, __LINE__);
+}
+
+static bool parseMaterialFile(objzContext *_ctx, File *_file, const char *_filename, Array *_materials);
+
+// _resolve is NULL when loading from a file: material files are found relative to the obj file.
+static bool loadMaterialFile(objzContext *_ctx, const char *_objFilename, objzMtllibResolveFunc _resolve, void *_userData, const char *_materialName, Array *_materials) {
 	File file;
-	if (!fileOpen(&file, filename)) {
-		// Treat missing material file as a warning, not an error.
-		appendError("Failed to read material file '%s'", filename);
+	FileIdentity identity;
+	memset(&identity, 0, sizeof(identity));
+	char filename[256] = { 0 };
+	if (_resolve) {
+		const void *data = NULL;
+		size_t size = 0;
+		if (!_resolve(_materialName, &data, &size, _userData) || !data || !size) {
+			// Treat missing material file as a warning, not an error.
+			appendError(_ctx, "Failed to read material file '%s'", _materialName);
+			return true;
+		}
+		fileOpenMemory(&file, data, size);
+		strCopy(filename, sizeof(filename), _materialName, strlen(_materialName));
+	} else {
+		const char *lastSlash = strrchr(_objFilename, '/');
+		if (!lastSlash)
+			lastSlash = strrchr(_objFilename, '\\');
+		if (lastSlash) {
+			for (int i = 0;; i++) {
+				filename[i] = _objFilename[i];
+				if (&_objFilename[i] == lastSlash)
+					break;
+			}
+			strConcat(filename, sizeof(filename), _materialName, strlen(_materialName));
+		} else
+			strCopy(filename, sizeof(filename), _materialName, strlen(_materialName));
+		// If the modification time is available, a cached library can be used without reading the file.
+		if (_ctx->materialCache && fileStat(filename, &identity.size, &identity.modifiedTime) && identity.modifiedTime != 0 && materialCacheFind(_ctx->materialCache, filename, &identity, _materials))
+			return true;
+		if (!fileOpen(_ctx, &file, filename)) {
+			// Treat missing material file as a warning, not an error.
+			appendError(_ctx, "Failed to read material file '%s'", filename);
+			return true;
+		}
+	}
+	if (!_ctx->materialCache)
+		return parseMaterialFile(_ctx, &file, filename, _materials);
+	identity.size = file.length;
+	identity.hash = hashBytes(file.buffer, file.length);
+	if (materialCacheFind(_ctx->materialCache, filename, &identity, _materials)) {
+		fileClose(_ctx, &file);
 		return true;
 	}
-	const uint32_t *bom32 = (const uint32_t *)file.buffer;
-	if (*bom32 == 0x0000feff || *bom32 == 0xfffe0000) {
-		appendError("UTF-32 encoding not supported in file '%s'", filename);
+	// The file could be edited again within the tick it was modified in, without changing its modification time. Like cacheSourceMatches, the time is only trusted once it's older than that.
+	if (identity.modifiedTime != 0 && identity.modifiedTime + OBJZ_FILE_TIME_RESOLUTION >= fileTimeNow())
+		identity.modifiedTime = 0;
+	const uint32_t firstMaterial = _materials->length;
+	if (!parseMaterialFile(_ctx, &file, filename, _materials))
 		return false;
-	}
-	const uint16_t *bom16 = (const uint16_t *)file.buffer;
-	if (*bom16 == 0xfffe || *bom16 == 0xfeff) {
-		appendError("UTF-16 encoding not supported in file '%s'", filename);
+	materialCacheAdd(_ctx->materialCache, filename, &identity, _materials, _materials->length - firstMaterial);
+	return true;
+}
+
+// Closes _file.
+static bool parseMaterialFile(objzContext *_ctx, File *_file, const char *_filename, Array *_materials) {
+	if (!fileCheckEncoding(_ctx, _file, _filename)) {
+		fileClose(_ctx, _file);
 		return false;
 	}
 	Lexer lexer;
@@ -620,55 +1927,46 @@ static bool loadMaterialFile(const char *_objFilename, const char *_materialName
 	materialInit(&mat);
 	bool result = false;
 	for (;;) {
-		char *line = fileReadLine(&file);
+		size_t lineLength;
+		const char *line = fileReadLine(_file, &lineLength);
 		if (!line)
 			break;
-		lexerSetLine(&lexer, line);
+		lexerSetLine(&lexer, line, lineLength, _file->buffer + _file->length);
 		tokenize(&lexer, &token, false);
-		if (OBJZ_STRICMP(token.text, "newmtl") == 0) {
+		const uint32_t keyword = lookupKeyword(&token);
+		if (keyword == OBJZ_KEYWORD_NEWMTL) {
 			tokenize(&lexer, &token, false);
-			if (token.text[0] == 0) {
-				appendError("(%u:%u) Expected name after 'newmtl'", token.line, token.column);
+			if (token.length == 0) {
+				appendError(_ctx, "(%u:%u) Expected name after 'newmtl'", lexer.line, tokenColumn(&lexer, &token));
 				goto cleanup;
 			}
 			if (mat.name[0] != 0)
 				arrayAppend(_materials, &mat);
 			materialInit(&mat);
-			strCopy(mat.name, sizeof(mat.name), token.text, strLength(token.text, sizeof(token.text)));
-		} else {
-			for (size_t i = 0; i < OBJZ_RAW_ARRAY_LEN(s_materialProperties); i++) {
-				const MaterialProperty *prop = &s_materialProperties[i];
-				uint8_t *dest = &((uint8_t *)&mat)[prop->offset];
-				if (OBJZ_STRICMP(token.text, prop->name) == 0) {
-					if (prop->type == OBJZ_MAT_TOKEN_STRING) {
-						Token argToken;
-						for (int j = 0;; j++) {
-							tokenize(&lexer, &argToken, false);
-							if (argToken.text[0] == 0) {
-								if (j == 0) {
-									appendError("(%u:%u) Expected token after '%s'", token.line, token.column, prop->name);
-									goto cleanup;
-								}
-								break;
-							}
-							bool match = false;
-							for (size_t k = 0; k < OBJZ_RAW_ARRAY_LEN(s_materialMapArgs); k++) {
-								const MaterialMapArg *arg = &s_materialMapArgs[k];
-								if (OBJZ_STRICMP(argToken.text, arg->name) == 0) {
-									match = true;
-									skipTokens(&lexer, arg->n);
-									break;
-								}
-							}
-							if (!match)
-								strCopy((char *)dest, OBJZ_NAME_MAX, argToken.text, strLength(argToken.text, sizeof(argToken.text)));
-						}
-					} else if (prop->type == OBJZ_MAT_TOKEN_FLOAT) {
-						if (!parseFloats(&lexer, (float *)dest, prop->n))
+			strCopy(mat.name, sizeof(mat.name), token.text, token.length);
+		} else if (keyword >= OBJZ_KEYWORD_MATERIAL_PROPERTY && keyword < OBJZ_KEYWORD_MATERIAL_MAP_ARG) {
+			const MaterialProperty *prop = &s_materialProperties[keyword - OBJZ_KEYWORD_MATERIAL_PROPERTY];
+			uint8_t *dest = &((uint8_t *)&mat)[prop->offset];
+			if (prop->type == OBJZ_MAT_TOKEN_STRING) {
+				Token argToken;
+				for (int j = 0;; j++) {
+					tokenize(&lexer, &argToken, false);
+					if (argToken.length == 0) {
+						if (j == 0) {
+							appendError(_ctx, "(%u:%u) Expected token after '%s'", lexer.line, tokenColumn(&lexer, &token), prop->name);
 							goto cleanup;
+						}
+						break;
 					}
-					break;
+					const uint32_t argKeyword = lookupKeyword(&argToken);
+					if (argKeyword >= OBJZ_KEYWORD_MATERIAL_MAP_ARG)
+						skipTokens(_ctx, &lexer, (int)s_materialMapArgs[argKeyword - OBJZ_KEYWORD_MATERIAL_MAP_ARG].n);
+					else
+						strCopy((char *)dest, OBJZ_NAME_MAX, argToken.text, argToken.length);
 				}
+			} else if (prop->type == OBJZ_MAT_TOKEN_FLOAT) {
+				if (!parseFloats(_ctx, &lexer, (float *)dest, prop->n))
+					goto cleanup;
 			}
 		}
 	}
@@ -676,123 +1974,220 @@ static bool loadMaterialFile(const char *_objFilename, const char *_materialName
 		arrayAppend(_materials, &mat);
 	result = true;
 cleanup:
-	fileClose(&file);
+	fileClose(_ctx, _file);
 	return result;
 }
 
-static uint32_t sdbmHash(const uint8_t *_data, uint32_t _size)
-{
-	uint32_t hash = 0;
-	for (uint32_t i = 0; i < _size; i++)
-		hash = (uint32_t)_data[i] + (hash << 6) + (hash << 16) - hash;
-	return hash;
+// Open addressing with linear probing. The number of slots is a power of two, and it grows to keep the load factor at most 1/2.
+// Growing is expensive, so it grows 4x at a time, up to enough slots for the maximum number of vertices.
+// Keys are stored in vertex order as a structure of arrays, so they are also the output vertex list.
+// Slots hold the vertex index in the low 32 bits and its hash in the high 32 bits, so keys are only compared when the hashes match.
+typedef struct {
+	uint64_t *slots; // UINT64_MAX if empty.
+	uint32_t numSlots, maxSlots;
+	Array objects, positions, texcoords, normals; // uint32_t keys, one element per vertex.
+} VertexHashMap;
+
+// Hash of up to four 32-bit keys: 64-bit multiplicative mixing of the whole key, with a splitmix64 finalizer.
+static uint32_t hashKey(uint32_t _a, uint32_t _b, uint32_t _c, uint32_t _d) {
+	uint64_t h = (((uint64_t)_b << 32) | _c) * 0x9e3779b97f4a7c15ull;
+	h ^= (((uint64_t)_d << 32) | _a) * 0xc2b2ae3d27d4eb4full;
+	h ^= h >> 31;
+	h *= 0xbf58476d1ce4e5b9ull;
+	h ^= h >> 32;
+	return (uint32_t)h;
 }
 
-typedef struct {
-	uint32_t object;
-	uint32_t pos;
-	uint32_t texcoord;
-	uint32_t normal;
-	uint32_t hashNext; // For hash collisions: next HashedVertex with the same hash.
-} HashedVertex;
+static void vertexHashMapAllocSlots(VertexHashMap *_map, objzContext *_ctx, uint32_t _numSlots) {
+	_map->numSlots = _numSlots;
+	_map->slots = OBJZ_MALLOC(_ctx, sizeof(uint64_t) * _numSlots);
+	memset(_map->slots, 0xff, sizeof(uint64_t) * _numSlots);
+}
 
-typedef struct {
-	uint32_t *slots;
-	uint32_t numSlots;
-	Array vertices;
-} VertexHashMap;
+// Slots for _capacity vertices at a load factor of 1/2.
+static uint32_t vertexHashMapSlotsForCapacity(uint32_t _capacity) {
+	uint32_t numSlots = 16;
+	while (numSlots < (uint64_t)_capacity * 2 && numSlots < (UINT32_MAX / 2 + 1))
+		numSlots *= 2;
+	return numSlots;
+}
 
-static void vertexHashMapInit(VertexHashMap *_map, uint32_t _initialCapacity) {
-	_map->numSlots = (uint32_t)(_initialCapacity * 1.3f);
-	_map->slots = OBJZ_MALLOC(sizeof(uint32_t) * _map->numSlots);
-	for (uint32_t i = 0; i < _map->numSlots; i++)
-		_map->slots[i] = UINT32_MAX;
-	arrayInit(&_map->vertices, sizeof(HashedVertex), _initialCapacity);
+// _maxCapacity is an upper bound on the number of vertices, e.g. the number of face corners.
+static void vertexHashMapInit(VertexHashMap *_map, objzContext *_ctx, uint32_t _initialCapacity, uint32_t _maxCapacity) {
+	_initialCapacity = OBJZ_SMALLEST(_initialCapacity, _maxCapacity);
+	_map->maxSlots = vertexHashMapSlotsForCapacity(_maxCapacity);
+	vertexHashMapAllocSlots(_map, _ctx, vertexHashMapSlotsForCapacity(_initialCapacity));
+	arrayInit(&_map->objects, _ctx, sizeof(uint32_t), _initialCapacity);
+	arrayInit(&_map->positions, _ctx, sizeof(uint32_t), _initialCapacity);
+	arrayInit(&_map->texcoords, _ctx, sizeof(uint32_t), _initialCapacity);
+	arrayInit(&_map->normals, _ctx, sizeof(uint32_t), _initialCapacity);
 }
 
 static void vertexHashMapDestroy(VertexHashMap *_map) {
-	OBJZ_FREE(_map->slots);
-	arrayDestroy(&_map->vertices);
+	OBJZ_FREE(_map->objects.ctx, _map->slots);
+	arrayDestroy(&_map->objects);
+	arrayDestroy(&_map->positions);
+	arrayDestroy(&_map->texcoords);
+	arrayDestroy(&_map->normals);
+}
+
+static void vertexHashMapGrow(VertexHashMap *_map) {
+	objzContext *ctx = _map->objects.ctx;
+	const uint64_t *oldSlots = _map->slots;
+	const uint32_t oldNumSlots = _map->numSlots;
+	// 4x, but at least 2x if the maximum number of vertices was wrong.
+	const uint64_t numSlots = OBJZ_LARGEST(OBJZ_SMALLEST((uint64_t)oldNumSlots * 4, _map->maxSlots), (uint64_t)oldNumSlots * 2);
+	vertexHashMapAllocSlots(_map, ctx, (uint32_t)OBJZ_SMALLEST(numSlots, (uint64_t)1 << 31));
+	const uint32_t mask = _map->numSlots - 1;
+	for (uint32_t i = 0; i < oldNumSlots; i++) {
+		if (oldSlots[i] == UINT64_MAX)
+			continue;
+		uint32_t slot = (uint32_t)(oldSlots[i] >> 32) & mask;
+		while (_map->slots[slot] != UINT64_MAX)
+			slot = (slot + 1) & mask;
+		_map->slots[slot] = oldSlots[i];
+	}
+	OBJZ_FREE(ctx, (void *)oldSlots);
 }
 
 static uint32_t vertexHashMapInsert(VertexHashMap *_map, uint32_t _object, uint32_t _pos, uint32_t _texcoord, uint32_t _normal) {
-	uint32_t hashData[4] = { 0 };
-	hashData[0] = _object;
-	hashData[1] = _pos;
-	if (_texcoord != UINT32_MAX)
-		hashData[2] = _texcoord;
-	if (_normal != UINT32_MAX)
-		hashData[3] = _normal;
-	const uint32_t hash = sdbmHash((const uint8_t *)hashData, sizeof(hashData)) % _map->numSlots;
-	uint32_t i = _map->slots[hash];
-	while (i != UINT32_MAX) {
-		const HashedVertex *v = OBJZ_ARRAY_ELEMENT(_map->vertices, i);
-		if (v->object == _object && v->pos == _pos && v->texcoord == _texcoord && v->normal == _normal)
+	const uint32_t hash = hashKey(_object, _pos, _texcoord, _normal);
+	const uint32_t mask = _map->numSlots - 1;
+	uint32_t slot = hash & mask;
+	for (;;) {
+		const uint64_t entry = _map->slots[slot];
+		if (entry == UINT64_MAX)
+			break;
+		const uint32_t i = (uint32_t)entry;
+		if ((uint32_t)(entry >> 32) == hash && ((const uint32_t *)_map->positions.data)[i] == _pos && ((const uint32_t *)_map->texcoords.data)[i] == _texcoord && ((const uint32_t *)_map->normals.data)[i] == _normal && ((const uint32_t *)_map->objects.data)[i] == _object)
 			return i;
-		i = v->hashNext;
+		slot = (slot + 1) & mask;
 	}
-	HashedVertex v;
-	v.object = _object;
-	v.pos = _pos;
-	v.texcoord = _texcoord;
-	v.normal = _normal;
-	v.hashNext = _map->slots[hash];
-	_map->slots[hash] = _map->vertices.length;
-	arrayAppend(&_map->vertices, &v);
-	return _map->slots[hash];
+	const uint32_t index = _map->positions.length;
+	arrayAppend(&_map->objects, &_object);
+	arrayAppend(&_map->positions, &_pos);
+	arrayAppend(&_map->texcoords, &_texcoord);
+	arrayAppend(&_map->normals, &_normal);
+	_map->slots[slot] = ((uint64_t)hash << 32) | index;
+	if (_map->positions.length * 2 > _map->numSlots)
+		vertexHashMapGrow(_map);
+	return index;
 }
 
+// Generated normals that are within the weld epsilon of each other, per component, share an index. See objz_setNormalWeldEpsilon.
+// Normals are bucketed in cells of 2 * epsilon, so a match is in the normal's own cell or the neighbour on its nearer side of each axis: 8 cells.
+// Open addressing with linear probing, like VertexHashMap. Slots hold the cell hash in the high 32 bits and the normal index in the low 32 bits.
 typedef struct {
-	uint32_t normalIndex;
-	uint32_t hashNext; // For hash collisions: next HashedNormal with the same hash.
-} HashedNormal;
-
-typedef struct {
-	uint32_t *slots;
+	objzContext *ctx;
+	uint64_t *slots; // UINT64_MAX if empty.
 	uint32_t numSlots;
-	Array hashedNormals;
+	uint32_t numNormals;
+	float epsilon;
+	double cellScale; // 1 / (2 * epsilon), 0 if epsilon is 0: the cell is the normal itself.
 	ChunkedArray *normals;
 } NormalHashMap;
 
+static void normalHashMapAllocSlots(NormalHashMap *_map, uint32_t _numSlots) {
+	_map->numSlots = _numSlots;
+	_map->slots = OBJZ_MALLOC(_map->ctx, sizeof(uint64_t) * _numSlots);
+	memset(_map->slots, 0xff, sizeof(uint64_t) * _numSlots);
+}
+
 static void normalHashMapClear(NormalHashMap *_map) {
-	for (uint32_t i = 0; i < _map->numSlots; i++)
-		_map->slots[i] = UINT32_MAX;
-	_map->hashedNormals.length = 0;
+	if (_map->numNormals > 0)
+		memset(_map->slots, 0xff, sizeof(uint64_t) * _map->numSlots);
+	_map->numNormals = 0;
 }
 
-static void normalHashMapInit(NormalHashMap *_map, uint32_t _initialCapacity, ChunkedArray *_normals) {
-	_map->numSlots = (uint32_t)(_initialCapacity * 1.3f);
-	_map->slots = OBJZ_MALLOC(sizeof(uint32_t) * _map->numSlots);
+static void normalHashMapInit(NormalHashMap *_map, objzContext *_ctx, uint32_t _initialCapacity, ChunkedArray *_normals) {
+	_map->ctx = _ctx;
+	_map->numNormals = 0;
+	_map->epsilon = _ctx->normalWeldEpsilon;
+	_map->cellScale = _map->epsilon > 0 ? 1.0 / (2.0 * _map->epsilon) : 0;
 	_map->normals = _normals;
-	arrayInit(&_map->hashedNormals, sizeof(HashedNormal), _initialCapacity);
-	normalHashMapClear(_map);
+	uint32_t numSlots = 16;
+	while (numSlots < (uint64_t)_initialCapacity * 2 && numSlots < (UINT32_MAX / 2 + 1))
+		numSlots *= 2;
+	normalHashMapAllocSlots(_map, numSlots);
 }
 
 static void normalHashMapDestroy(NormalHashMap *_map) {
-	OBJZ_FREE(_map->slots);
-	arrayDestroy(&_map->hashedNormals);
+	OBJZ_FREE(_map->ctx, _map->slots);
+}
+
+// The cell coordinates of _normal, and which side of the cell it's on for each axis.
+static void normalCell(const NormalHashMap *_map, const vec3 *_normal, int32_t *_cell, bool *_upper) {
+	const float v[3] = { _normal->x, _normal->y, _normal->z };
+	for (int i = 0; i < 3; i++) {
+		if (_map->cellScale > 0) {
+			double q = v[i] * _map->cellScale;
+			if (!(q > -1e9 && q < 1e9))
+				q = 0; // Infinite or NaN, they never match anything.
+			const double cell = floor(q);
+			_cell[i] = (int32_t)cell;
+			_upper[i] = q - cell >= 0.5;
+		} else {
+			const float f = v[i] + 0.0f; // -0 is the same as 0.
+			memcpy(&_cell[i], &f, sizeof(f));
+			_upper[i] = false;
+		}
+	}
+}
+
+static uint32_t normalHashMapFind(const NormalHashMap *_map, uint32_t _hash, const vec3 *_normal) {
+	const uint32_t mask = _map->numSlots - 1;
+	for (uint32_t slot = _hash & mask;; slot = (slot + 1) & mask) {
+		const uint64_t entry = _map->slots[slot];
+		if (entry == UINT64_MAX)
+			return UINT32_MAX;
+		if ((uint32_t)(entry >> 32) == _hash && vec3Equal(chunkedArrayElement(_map->normals, (uint32_t)entry), _normal, _map->epsilon))
+			return (uint32_t)entry;
+	}
+}
+
+static void normalHashMapGrow(NormalHashMap *_map) {
+	const uint64_t *oldSlots = _map->slots;
+	const uint32_t oldNumSlots = _map->numSlots;
+	normalHashMapAllocSlots(_map, oldNumSlots * 2);
+	const uint32_t mask = _map->numSlots - 1;
+	for (uint32_t i = 0; i < oldNumSlots; i++) {
+		if (oldSlots[i] == UINT64_MAX)
+			continue;
+		uint32_t slot = (uint32_t)(oldSlots[i] >> 32) & mask;
+		while (_map->slots[slot] != UINT64_MAX)
+			slot = (slot + 1) & mask;
+		_map->slots[slot] = oldSlots[i];
+	}
+	OBJZ_FREE(_map->ctx, (void *)oldSlots);
 }
 
+// Returns the index of a matching normal, or appends _normal to the normals and returns its index.
 static uint32_t normalHashMapInsert(NormalHashMap *_map, const vec3 *_normal) {
-	uint32_t hashData[3] = { 0 };
-	hashData[0] = (uint32_t)(_normal->x * 0.5f + 0.5f * 255);
-	hashData[1] = (uint32_t)(_normal->y * 0.5f + 0.5f * 255);
-	hashData[2] = (uint32_t)(_normal->z * 0.5f + 0.5f * 255);
-	const uint32_t hash = sdbmHash((const uint8_t *)hashData, sizeof(hashData)) % _map->numSlots;
-	uint32_t i = _map->slots[hash];
-	while (i != UINT32_MAX) {
-		const HashedNormal *n = OBJZ_ARRAY_ELEMENT(_map->hashedNormals, i);
-		if (vec3Equal(chunkedArrayElement(_map->normals, n->normalIndex), _normal, FLT_EPSILON))
-			return n->normalIndex;
-		i = n->hashNext;
-	}
-	HashedNormal n;
-	n.normalIndex = _map->normals->length;
-	n.hashNext = _map->slots[hash];
-	_map->slots[hash] = _map->hashedNormals.length;
-	arrayAppend(&_map->hashedNormals, &n);
+	int32_t cell[3];
+	bool upper[3];
+	normalCell(_map, _normal, cell, upper);
+	const uint32_t hash = hashKey((uint32_t)cell[0], (uint32_t)cell[1], (uint32_t)cell[2], 0);
+	// The normal's own cell first, it's the most likely to match.
+	uint32_t index = normalHashMapFind(_map, hash, _normal);
+	for (uint32_t i = 1; i < 8 && index == UINT32_MAX && _map->cellScale > 0; i++) {
+		int32_t neighbour[3];
+		for (int j = 0; j < 3; j++)
+			neighbour[j] = cell[j] + ((i >> j) & 1 ? (upper[j] ? 1 : -1) : 0);
+		index = normalHashMapFind(_map, hashKey((uint32_t)neighbour[0], (uint32_t)neighbour[1], (uint32_t)neighbour[2], 0), _normal);
+	}
+	if (index != UINT32_MAX)
+		return index;
+	index = _map->normals->length;
 	chunkedArrayAppend(_map->normals, _normal);
-	return n.normalIndex;
+	const uint32_t mask = _map->numSlots - 1;
+	uint32_t slot = hash & mask;
+	while (_map->slots[slot] != UINT64_MAX)
+		slot = (slot + 1) & mask;
+	_map->slots[slot] = ((uint64_t)hash << 32) | index;
+	_map->numNormals++;
+	if (_map->numNormals * 2 > _map->numSlots)
+		normalHashMapGrow(_map);
+	return index;
 }
 
 typedef struct {
@@ -808,52 +2203,43 @@ typedef struct {
 } IndexTriplet;
 
 typedef struct {
-	int16_t materialIndex;
+	int32_t materialIndex; // -1 is no material. A UsedMaterial index until parserResolveMaterials.
 	uint16_t smoothingGroup; // 0 is off
 	IndexTriplet indices[3];
 } Face;
 
-static bool parseVertexAttribIndices(Token *_token, int32_t *_out) {
+static bool parseVertexAttribIndices(const Token *_token, int32_t *_out) {
 	int32_t *v = &_out[0];
 	int32_t *vt = &_out[1];
 	int32_t *vn = &_out[2];
 	*v = *vt = *vn = INT_MAX;
-	if (strLength(_token->text, sizeof(_token->text)) == 0)
+	if (_token->length == 0)
 		return false; // Empty token.
-	const char *delim = "/";
-	char *start = _token->text;
-	bool eol = false;
+	const char *start = _token->text;
+	const char *tokenEnd = _token->text + _token->length;
 	// v
-	char *end = strstr(start, delim);
-	if (!end) {
-		end = &_token->text[strLength(_token->text, sizeof(_token->text))];
-		eol = true;
-	} else if (end == start)
+	const char *end = memchr(start, '/', _token->length);
+	if (end == start)
 		return false; // Token is just a delimiter.
-	*end = 0;
-	*v = atoi(start);
-	// vt
-	if (eol)
+	*v = tokenToInt(start, end ? end : tokenEnd);
+	if (!end)
 		return true;  // No vt or vn.
+	// vt
 	start = end + 1;
-	if (*start == 0)
+	if (start == tokenEnd)
 		return true; // No vt or vn.
-	end = strstr(start, delim);
-	bool skipNormal = false;
+	end = memchr(start, '/', (size_t)(tokenEnd - start));
 	if (!end) {
 		// No delimiter, must be no normal, i.e. "v/vt".
-		skipNormal = true;
-		end = &_token->text[strLength(_token->text, sizeof(_token->text)) - 1];
+		*vt = tokenToInt(start, tokenEnd);
+		return true;
 	}
-	*end = 0;
 	if (start != end)
-		*vt = atoi(start);
+		*vt = tokenToInt(start, end);
 	// vn
-	if (skipNormal)
-		return true;
 	start = end + 1;
-	if (*start != 0)
-		*vn = atoi(start);
+	if (start != tokenEnd)
+		*vn = tokenToInt(start, tokenEnd);
 	return true;
 }
 
@@ -975,7 +2361,7 @@ static void triangulate(const Array *_indices, const ChunkedArray *_positions, A
 		Face face;
 		for (int i = 0; i < 3; i++)
 			face.indices[i] = *ind[i];
-		face.materialIndex = (int16_t)_materialIndex;
+		face.materialIndex = _materialIndex;
 		face.smoothingGroup = _smoothingGroup;
 		chunkedArrayAppend(_faces, &face);
 		// remove v1 from the list
@@ -991,452 +2377,2264 @@ static void triangulate(const Array *_indices, const ChunkedArray *_positions, A
 		Face face;
 		for (int i = 0; i < 3; i++)
 			face.indices[i] = *(IndexTriplet *)OBJZ_ARRAY_ELEMENT(*remainingIndices, i);
-		face.materialIndex = (int16_t)_materialIndex;
+		face.materialIndex = _materialIndex;
 		face.smoothingGroup = _smoothingGroup;
 		chunkedArrayAppend(_faces, &face);
 	}
 }
 
-static vec3 calculateSmoothNormal(uint32_t _pos, ChunkedArray *_faces, Array *_faceNormals, uint16_t _smoothingGroup) {
-	vec3 normal;
-	OBJZ_VEC3_SET(normal, 0, 0, 0);
-	int n = 0;
+// Out of range position indices are treated as zero, like missing attributes in the vertices.
+static const vec3 *facePosition(const ChunkedArray *_positions, uint32_t _index) {
+	static const vec3 zero = { 0.0f, 0.0f, 0.0f };
+	return _index < _positions->length ? chunkedArrayElement(_positions, _index) : &zero;
+}
+
+// Normalized face normals, one per face.
+// Faces are done OBJZ_SIMD_FLOATS at a time: their positions are gathered into vectors of x, y and z. The result is exactly the same as the scalar cross product and vec3Normalize.
+static void calculateFaceNormals(const ChunkedArray *_faces, const ChunkedArray *_positions, vec3 *_normals) {
+	uint32_t i = 0;
+#if OBJZ_SIMD_WIDTH
+	for (; i + OBJZ_SIMD_FLOATS <= _faces->length; i += OBJZ_SIMD_FLOATS) {
+		const vec3 *p0[OBJZ_SIMD_FLOATS], *p1[OBJZ_SIMD_FLOATS], *p2[OBJZ_SIMD_FLOATS];
+		for (uint32_t j = 0; j < OBJZ_SIMD_FLOATS; j++) {
+			const Face *face = chunkedArrayElement(_faces, i + j);
+			p0[j] = facePosition(_positions, face->indices[0].v);
+			p1[j] = facePosition(_positions, face->indices[1].v);
+			p2[j] = facePosition(_positions, face->indices[2].v);
+		}
+		const SimdFloats x0 = OBJZ_SIMD_GATHER(p0, x), y0 = OBJZ_SIMD_GATHER(p0, y), z0 = OBJZ_SIMD_GATHER(p0, z);
+		SimdFloats edge0[3], edge1[3];
+		edge0[0] = OBJZ_SIMD_SUB(OBJZ_SIMD_GATHER(p1, x), x0);
+		edge0[1] = OBJZ_SIMD_SUB(OBJZ_SIMD_GATHER(p1, y), y0);
+		edge0[2] = OBJZ_SIMD_SUB(OBJZ_SIMD_GATHER(p1, z), z0);
+		edge1[0] = OBJZ_SIMD_SUB(OBJZ_SIMD_GATHER(p2, x), x0);
+		edge1[1] = OBJZ_SIMD_SUB(OBJZ_SIMD_GATHER(p2, y), y0);
+		edge1[2] = OBJZ_SIMD_SUB(OBJZ_SIMD_GATHER(p2, z), z0);
+		SimdFloats normal[3];
+		normal[0] = OBJZ_SIMD_SUB(OBJZ_SIMD_MUL(edge0[1], edge1[2]), OBJZ_SIMD_MUL(edge0[2], edge1[1]));
+		normal[1] = OBJZ_SIMD_SUB(OBJZ_SIMD_MUL(edge0[2], edge1[0]), OBJZ_SIMD_MUL(edge0[0], edge1[2]));
+		normal[2] = OBJZ_SIMD_SUB(OBJZ_SIMD_MUL(edge0[0], edge1[1]), OBJZ_SIMD_MUL(edge0[1], edge1[0]));
+		// Same operation order as OBJZ_VEC3_DOT and vec3Normalize. Zero length (and NaN) normals are left as they are.
+		SimdFloats len = OBJZ_SIMD_ADD(OBJZ_SIMD_ADD(OBJZ_SIMD_MUL(normal[0], normal[0]), OBJZ_SIMD_MUL(normal[1], normal[1])), OBJZ_SIMD_MUL(normal[2], normal[2]));
+		const SimdFloats mask = OBJZ_SIMD_GREATER_MASK(len, OBJZ_SIMD_SET_FLOATS(0.0f));
+		len = OBJZ_SIMD_DIV(OBJZ_SIMD_SET_FLOATS(1.0f), OBJZ_SIMD_SQRT(len));
+		float out[3][OBJZ_SIMD_FLOATS];
+		for (int axis = 0; axis < 3; axis++)
+			OBJZ_SIMD_STORE_FLOATS(out[axis], OBJZ_SIMD_SELECT(mask, OBJZ_SIMD_MUL(normal[axis], len), normal[axis]));
+		for (uint32_t j = 0; j < OBJZ_SIMD_FLOATS; j++) {
+			OBJZ_VEC3_SET(_normals[i + j], out[0][j], out[1][j], out[2][j]);
+		}
+	}
+#endif
+	for (; i < _faces->length; i++) {
+		const Face *face = chunkedArrayElement(_faces, i);
+		vec3 edge0, edge1;
+		const vec3 *p0 = facePosition(_positions, face->indices[0].v);
+		const vec3 *p1 = facePosition(_positions, face->indices[1].v);
+		const vec3 *p2 = facePosition(_positions, face->indices[2].v);
+		OBJZ_VEC3_SUB(edge0, *p1, *p0);
+		OBJZ_VEC3_SUB(edge1, *p2, *p0);
+		OBJZ_VEC3_CROSS(_normals[i], edge0, edge1);
+		vec3Normalize(&_normals[i], &_normals[i]);
+	}
+}
+
+// Smoothing group normals: the average of the normals of all faces with the same smoothing group that share a position.
+// Writes an index into _smoothNormals for each corner of faces with a smoothing group, UINT32_MAX otherwise.
+static void calculateSmoothNormals(objzContext *_ctx, ChunkedArray *_faces, const vec3 *_faceNormals, uint32_t _numPositions, Array *_smoothNormals, uint32_t *_cornerNormals) {
+	// Position to face adjacency, compressed sparse row. Faces are listed in order, once per position.
+	uint32_t *offsets = OBJZ_MALLOC(_ctx, sizeof(uint32_t) * (_numPositions + 1));
+	memset(offsets, 0, sizeof(uint32_t) * (_numPositions + 1));
+	for (uint32_t i = 0; i < _faces->length; i++) {
+		const Face *face = chunkedArrayElement(_faces, i);
+		for (int j = 0; j < 3; j++) {
+			_cornerNormals[i * 3 + j] = UINT32_MAX;
+			const uint32_t v = face->indices[j].v;
+			if (face->smoothingGroup > 0 && v < _numPositions && (j == 0 || v != face->indices[0].v) && (j < 2 || v != face->indices[1].v))
+				offsets[v + 1]++;
+		}
+	}
+	for (uint32_t i = 0; i < _numPositions; i++)
+		offsets[i + 1] += offsets[i];
+	uint32_t *adjacentFaces = OBJZ_MALLOC(_ctx, sizeof(uint32_t) * OBJZ_LARGEST(offsets[_numPositions], 1));
 	for (uint32_t i = 0; i < _faces->length; i++) {
 		const Face *face = chunkedArrayElement(_faces, i);
-		if (face->smoothingGroup != _smoothingGroup)
-			continue;
 		for (int j = 0; j < 3; j++) {
-			if (face->indices[j].v == _pos) {
-				OBJZ_VEC3_ADD(normal, normal, *(vec3 *)OBJZ_ARRAY_ELEMENT(*_faceNormals, i));
+			const uint32_t v = face->indices[j].v;
+			if (face->smoothingGroup > 0 && v < _numPositions && (j == 0 || v != face->indices[0].v) && (j < 2 || v != face->indices[1].v))
+				adjacentFaces[offsets[v]++] = i;
+		}
+	}
+	// Filling advanced each offset to the next position's, shift them back.
+	for (uint32_t i = _numPositions; i > 0; i--)
+		offsets[i] = offsets[i - 1];
+	offsets[0] = 0;
+	for (uint32_t pos = 0; pos < _numPositions; pos++) {
+		if ((pos & 4095) == 0 && loadCancelled(_ctx))
+			break; // parserFinish checks again and discards the normals.
+		for (uint32_t i = offsets[pos]; i < offsets[pos + 1]; i++) {
+			const Face *face = chunkedArrayElement(_faces, adjacentFaces[i]);
+			int corner = 0;
+			while (face->indices[corner].v != pos)
+				corner++;
+			if (_cornerNormals[adjacentFaces[i] * 3 + corner] != UINT32_MAX)
+				continue; // Smoothing group already done for this position.
+			// Sum in face order, the first face with this smoothing group is this one.
+			vec3 normal;
+			OBJZ_VEC3_SET(normal, 0, 0, 0);
+			int n = 0;
+			for (uint32_t j = i; j < offsets[pos + 1]; j++) {
+				const Face *other = chunkedArrayElement(_faces, adjacentFaces[j]);
+				if (other->smoothingGroup != face->smoothingGroup)
+					continue;
+				OBJZ_VEC3_ADD(normal, normal, _faceNormals[adjacentFaces[j]]);
 				n++;
-				break;
+				for (int k = 0; k < 3; k++) {
+					if (other->indices[k].v == pos)
+						_cornerNormals[adjacentFaces[j] * 3 + k] = _smoothNormals->length;
+				}
 			}
+			const float s = 1.0f / n;
+			OBJZ_VEC3_MUL(normal, normal, s);
+			vec3Normalize(&normal, &normal);
+			arrayAppend(_smoothNormals, &normal);
 		}
 	}
-	const float s = 1.0f / n;
-	OBJZ_VEC3_MUL(normal, normal, s);
-	vec3Normalize(&normal, &normal);
-	return normal;
+	OBJZ_FREE(_ctx, adjacentFaces);
+	OBJZ_FREE(_ctx, offsets);
+}
+
+objzContext *objz_createContext(objzReallocFunc _realloc) {
+	objzContext init = {
+		.reallocFunc = _realloc,
+		.progressFunc = NULL,
+		.indexFormat = OBJZ_INDEX_FORMAT_AUTO,
+		.vertexDecl = OBJZ_DEFAULT_VERTEX_FORMAT,
+		.numThreads = 1,
+		.normalWeldEpsilon = FLT_EPSILON,
+		.materialCache = NULL,
+		.cancel = NULL,
+		.asyncLoading = 0,
+		.batchWorkers = NULL,
+		.numBatchWorkers = 0
+	};
+	// The arena is allocated with the context.
+	objzContext *ctx = OBJZ_OUTPUT_MALLOC(&init, sizeof(objzContext) + sizeof(Arena));
+	*ctx = init;
+	ctx->arena = (Arena *)(ctx + 1);
+	memset(ctx->arena, 0, sizeof(Arena));
+	return ctx;
+}
+
+static void destroyBatchWorkers(objzContext *_ctx);
+
+void objz_destroyContext(objzContext *_ctx) {
+	if (!_ctx || _ctx == &s_defaultContext)
+		return;
+	destroyBatchWorkers(_ctx);
+	arenaRelease(_ctx);
+	OBJZ_OUTPUT_FREE(_ctx, _ctx);
 }
 
 void objz_setRealloc(objzReallocFunc _realloc) {
-	s_realloc = _realloc;
+	// The arena's blocks and the batch workers were allocated with the old function.
+	destroyBatchWorkers(&s_defaultContext);
+	arenaRelease(&s_defaultContext);
+	s_defaultContext.reallocFunc = _realloc;
 }
 
 void objz_setProgress(objzProgressFunc _progress) {
-	s_progress = _progress;
+	objz_setProgressEx(&s_defaultContext, _progress);
+}
+
+void objz_setProgressEx(objzContext *_ctx, objzProgressFunc _progress) {
+	_ctx->progressFunc = _progress;
 }
 
 void objz_setIndexFormat(uint32_t _format) {
-	s_indexFormat = _format;
+	objz_setIndexFormatEx(&s_defaultContext, _format);
+}
+
+void objz_setIndexFormatEx(objzContext *_ctx, uint32_t _format) {
+	_ctx->indexFormat = _format;
 }
 
 void objz_setVertexFormat(size_t _stride, size_t _positionOffset, size_t _texcoordOffset, size_t _normalOffset) {
-	s_vertexDecl.stride = _stride;
-	s_vertexDecl.positionOffset = _positionOffset;
-	s_vertexDecl.texcoordOffset = _texcoordOffset;
-	s_vertexDecl.normalOffset = _normalOffset;
+	objz_setVertexFormatEx(&s_defaultContext, _stride, _positionOffset, _texcoordOffset, _normalOffset);
+}
+
+void objz_setVertexFormatEx(objzContext *_ctx, size_t _stride, size_t _positionOffset, size_t _texcoordOffset, size_t _normalOffset) {
+	_ctx->vertexDecl.stride = _stride;
+	_ctx->vertexDecl.positionOffset = _positionOffset;
+	_ctx->vertexDecl.texcoordOffset = _texcoordOffset;
+	_ctx->vertexDecl.normalOffset = _normalOffset;
+}
+
+void objz_setNumThreads(uint32_t _numThreads) {
+	objz_setNumThreadsEx(&s_defaultContext, _numThreads);
+}
+
+void objz_setNumThreadsEx(objzContext *_ctx, uint32_t _numThreads) {
+	_ctx->numThreads = OBJZ_LARGEST(_numThreads, 1);
+}
+
+void objz_setNormalWeldEpsilon(float _epsilon) {
+	objz_setNormalWeldEpsilonEx(&s_defaultContext, _epsilon);
+}
+
+void objz_setNormalWeldEpsilonEx(objzContext *_ctx, float _epsilon) {
+	_ctx->normalWeldEpsilon = _epsilon > 0 ? _epsilon : 0;
+}
+
+void objz_setMaterialCache(objzMaterialCache *_cache) {
+	objz_setMaterialCacheEx(&s_defaultContext, _cache);
+}
+
+void objz_setMaterialCacheEx(objzContext *_ctx, objzMaterialCache *_cache) {
+	_ctx->materialCache = _cache;
+}
+
+void objz_setArenaSize(size_t _size) {
+	objz_setArenaSizeEx(&s_defaultContext, _size);
+}
+
+void objz_setArenaSizeEx(objzContext *_ctx, size_t _size) {
+	if (_ctx->arena->numLoads > 0)
+		return;
+	arenaRelease(_ctx);
+	_ctx->arena->nextBlockSize = 0;
+	if (_size > 0)
+		arenaAddBlock(_ctx, _ctx->arena, arenaAlign(_size));
+}
+
+size_t objz_getArenaHighWater() {
+	return objz_getArenaHighWaterEx(&s_defaultContext);
+}
+
+size_t objz_getArenaHighWaterEx(const objzContext *_ctx) {
+	size_t highWater = 0;
+	for (const Arena *arena = _ctx->arena; arena; arena = arena->nextWorker)
+		highWater += arena->highWater;
+	return highWater;
+}
+
+// Used by objz_loadFromMemory when the caller doesn't provide a resolver: there's no file to find material files relative to.
+static bool nullMtllibResolve(const char *_name, const void **_data, size_t *_size, void *_userData) {
+	(void)_name;
+	(void)_data;
+	(void)_size;
+	(void)_userData;
+	return false;
 }
 
 objzModel *objz_load(const char *_filename) {
-	s_error[0] = 0;
-	if (s_progress)
-		s_progress(_filename, 0);
+	return objz_loadEx(&s_defaultContext, _filename);
+}
+
+static objzModel *loadModel(objzContext *_ctx, File *_file, const char *_filename, objzMtllibResolveFunc _resolve, void *_userData);
+
+objzModel *objz_loadEx(objzContext *_ctx, const char *_filename) {
+	_ctx->error[0] = 0;
+	if (_ctx->progressFunc)
+		_ctx->progressFunc(_filename, 0);
+	arenaBeginLoad(_ctx);
 	File file;
-	if (!fileOpen(&file, _filename)) {
-		appendError("Failed to read file '%s'", _filename);
+	objzModel *model = NULL;
+	if (fileOpen(_ctx, &file, _filename))
+		model = loadModel(_ctx, &file, _filename, NULL, NULL);
+	else if (!checkCancelled(_ctx))
+		appendError(_ctx, "Failed to read file '%s'", _filename);
+	arenaEndLoad(_ctx);
+	return model;
+}
+
+objzModel *objz_loadFromMemory(const void *_data, size_t _size, objzMtllibResolveFunc _resolve, void *_userData) {
+	return objz_loadFromMemoryEx(&s_defaultContext, _data, _size, _resolve, _userData);
+}
+
+objzModel *objz_loadFromMemoryEx(objzContext *_ctx, const void *_data, size_t _size, objzMtllibResolveFunc _resolve, void *_userData) {
+	const char *name = "<memory>";
+	_ctx->error[0] = 0;
+	if (_ctx->progressFunc)
+		_ctx->progressFunc(name, 0);
+	if (!_data || !_size) {
+		appendError(_ctx, "Empty buffer");
 		return NULL;
 	}
-	if (s_progress)
-		s_progress(_filename, 50);
-	const uint32_t *bom32 = (const uint32_t *)file.buffer;
-	if (*bom32 == 0x0000feff || *bom32 == 0xfffe0000) {
-		appendError("UTF-32 encoding not supported in file '%s'", _filename);
-		return false;
+	arenaBeginLoad(_ctx);
+	File file;
+	fileOpenMemory(&file, _data, _size);
+	objzModel *model = loadModel(_ctx, &file, name, _resolve ? _resolve : nullMtllibResolve, _userData);
+	arenaEndLoad(_ctx);
+	return model;
+}
+
+typedef struct {
+	objzContext **workers; // One per thread, so each thread reuses its own arena for every file it loads. See objzContext batchWorkers.
+	objzBatchFile *files;
+} BatchLoad;
+
+static void loadBatchFile(TaskPool *_pool, uint32_t _task, uint32_t _worker) {
+	BatchLoad *batch = _pool->data;
+	objzContext *ctx = batch->workers[_worker];
+	objzBatchFile *file = &batch->files[_task];
+	if (file->data || !file->filename)
+		file->model = objz_loadFromMemoryEx(ctx, file->data, file->size, file->resolve, file->userData);
+	else
+		file->model = objz_loadEx(ctx, file->filename);
+	file->error = NULL;
+	if (ctx->error[0]) {
+		const size_t length = strlen(ctx->error) + 1;
+		file->error = OBJZ_OUTPUT_MALLOC(ctx, length);
+		memcpy(file->error, ctx->error, length);
 	}
-	const uint16_t *bom16 = (const uint16_t *)file.buffer;
-	if (*bom16 == 0xfffe || *bom16 == 0xfeff) {
-		appendError("UTF-16 encoding not supported in file '%s'", _filename);
-		return false;
+}
+
+uint32_t objz_loadBatch(objzBatchFile *_files, uint32_t _numFiles, uint32_t _numThreads) {
+	return objz_loadBatchEx(&s_defaultContext, _files, _numFiles, _numThreads);
+}
+
+uint32_t objz_loadBatchEx(objzContext *_ctx, objzBatchFile *_files, uint32_t _numFiles, uint32_t _numThreads) {
+	_ctx->error[0] = 0;
+	if (!_numFiles)
+		return 0;
+	const uint32_t numWorkers = OBJZ_THREADS ? OBJZ_LARGEST(OBJZ_SMALLEST(_numThreads, _numFiles), 1) : 1;
+	if (_ctx->numBatchWorkers < numWorkers) {
+		objzContext **workers = OBJZ_OUTPUT_MALLOC(_ctx, sizeof(objzContext *) * numWorkers);
+		for (uint32_t i = 0; i < numWorkers; i++)
+			workers[i] = i < _ctx->numBatchWorkers ? _ctx->batchWorkers[i] : objz_createContext(_ctx->reallocFunc);
+		OBJZ_OUTPUT_FREE(_ctx, _ctx->batchWorkers);
+		_ctx->batchWorkers = workers;
+		_ctx->numBatchWorkers = numWorkers;
 	}
-	// Parse the obj file and any material files.
-	// Faces are triangulated. Other than that, this is straight parsing.
-	Array materialLibs, materials, tempObjects;
-	ChunkedArray positions, texcoords, normals, faces;
-	Array faceIndices, tempFaceIndices; // Re-used per face.
-	arrayInit(&materialLibs, sizeof(char) * OBJZ_MAX_TOKEN_LENGTH, 1);
-	arrayInit(&materials, sizeof(objzMaterial), 16);
-	arrayInit(&tempObjects, sizeof(TempObject), 64);
-	chunkedArrayInit(&positions, sizeof(float) * 3, 100000);
-	chunkedArrayInit(&texcoords, sizeof(float) * 2, 100000);
-	chunkedArrayInit(&normals, sizeof(float) * 3, 100000);
-	chunkedArrayInit(&faces, sizeof(Face), 100000);
-	arrayInit(&faceIndices, sizeof(IndexTriplet), 8);
-	arrayInit(&tempFaceIndices, sizeof(IndexTriplet), 8);
-	bool generateNormals = false;
-	char currentGroupName[OBJZ_NAME_MAX] = { 0 };
-	char currentObjectName[OBJZ_NAME_MAX] = { 0 };
-	int32_t currentMaterialIndex = -1;
-	uint16_t currentSmoothingGroup = 0;
-	uint32_t flags = 0;
-	Lexer lexer;
-	initLexer(&lexer);
-	Token token;
-	int progress = 50;
-	for (;;) {
-		char *line = fileReadLine(&file);
-		if (s_progress) {
-			const int newProgress = (int)(50.0f + (file.pos / (float)file.length) * 25.0f);
-			if (newProgress > progress) {
-				progress = newProgress;
-				s_progress(_filename, progress);
+	// The settings may have changed since the last batch.
+	for (uint32_t i = 0; i < numWorkers; i++) {
+		objzContext *worker = _ctx->batchWorkers[i];
+		worker->indexFormat = _ctx->indexFormat;
+		worker->vertexDecl = _ctx->vertexDecl;
+		worker->normalWeldEpsilon = _ctx->normalWeldEpsilon;
+		worker->materialCache = _ctx->materialCache;
+	}
+	BatchLoad batch;
+	batch.files = _files;
+	batch.workers = _ctx->batchWorkers;
+	arenaBeginLoad(_ctx);
+	runTasks(_ctx, loadBatchFile, &batch, _numFiles, numWorkers);
+	arenaEndLoad(_ctx);
+	uint32_t numLoaded = 0;
+	for (uint32_t i = 0; i < _numFiles; i++) {
+		if (_files[i].model)
+			numLoaded++;
+	}
+	return numLoaded;
+}
+
+static void destroyBatchWorkers(objzContext *_ctx) {
+	for (uint32_t i = 0; i < _ctx->numBatchWorkers; i++)
+		objz_destroyContext(_ctx->batchWorkers[i]);
+	OBJZ_OUTPUT_FREE(_ctx, _ctx->batchWorkers);
+	_ctx->batchWorkers = NULL;
+	_ctx->numBatchWorkers = 0;
+}
+
+void objz_destroyBatch(objzBatchFile *_files, uint32_t _numFiles) {
+	objz_destroyBatchEx(&s_defaultContext, _files, _numFiles);
+}
+
+void objz_destroyBatchEx(objzContext *_ctx, objzBatchFile *_files, uint32_t _numFiles) {
+	for (uint32_t i = 0; i < _numFiles; i++) {
+		objz_destroyEx(_ctx, _files[i].model);
+		OBJZ_OUTPUT_FREE(_ctx, _files[i].error);
+		_files[i].model = NULL;
+		_files[i].error = NULL;
+	}
+}
+
+struct objzAsyncLoad {
+	objzContext *parent; // The context passed to objz_loadAsync. Gets the errors when the load finishes.
+	objzContext ctx; // A copy of parent, with the cancel flag of this load.
+	const char *filename; // Copied after the struct.
+	objzAsyncLoadFunc callback;
+	void *userData;
+	objzModel *model;
+	bool modelReturned; // By objz_asyncLoadWait, so the caller owns it.
+	int32_t cancelled, finished; // See atomicFlagGet.
+	Thread thread;
+};
+
+static void asyncLoadRun(void *_data) {
+	objzAsyncLoad *load = (objzAsyncLoad *)_data;
+	load->model = objz_loadEx(&load->ctx, load->filename);
+	memcpy(load->parent->error, load->ctx.error, sizeof(load->ctx.error));
+	atomicFlagClear(&load->parent->asyncLoading);
+	if (load->callback)
+		load->callback(load->model, load->userData);
+	atomicFlagSet(&load->finished);
+}
+
+objzAsyncLoad *objz_loadAsync(const char *_filename, objzAsyncLoadFunc _callback, void *_userData) {
+	return objz_loadAsyncEx(&s_defaultContext, _filename, _callback, _userData);
+}
+
+objzAsyncLoad *objz_loadAsyncEx(objzContext *_ctx, const char *_filename, objzAsyncLoadFunc _callback, void *_userData) {
+	// Loads on one context would share its arena and error.
+	if (atomicFlagGet(&_ctx->asyncLoading))
+		return NULL;
+	// Copy the filename, the load may outlive it.
+	const size_t filenameSize = strlen(_filename) + 1;
+	objzAsyncLoad *load = OBJZ_OUTPUT_MALLOC(_ctx, sizeof(objzAsyncLoad) + filenameSize);
+	char *filename = (char *)(load + 1);
+	memcpy(filename, _filename, filenameSize);
+	load->parent = _ctx;
+	load->ctx = *_ctx;
+	load->ctx.batchWorkers = NULL;
+	load->ctx.numBatchWorkers = 0;
+	load->filename = filename;
+	load->callback = _callback;
+	load->userData = _userData;
+	load->model = NULL;
+	load->modelReturned = false;
+	load->cancelled = load->finished = 0;
+	load->ctx.cancel = &load->cancelled;
+	atomicFlagSet(&_ctx->asyncLoading);
+	threadStart(&load->thread, asyncLoadRun, load);
+	return load;
+}
+
+bool objz_asyncLoadPoll(const objzAsyncLoad *_load) {
+	return atomicFlagGet(&_load->finished);
+}
+
+objzModel *objz_asyncLoadWait(objzAsyncLoad *_load) {
+	threadJoin(&_load->thread);
+	_load->modelReturned = true;
+	return _load->model;
+}
+
+void objz_asyncLoadCancel(objzAsyncLoad *_load) {
+	atomicFlagSet(&_load->cancelled);
+}
+
+void objz_destroyAsyncLoad(objzAsyncLoad *_load) {
+	if (!_load)
+		return;
+	objzContext *ctx = _load->parent;
+	if (!_load->modelReturned) {
+		objz_asyncLoadCancel(_load);
+		objz_destroyEx(ctx, objz_asyncLoadWait(_load));
+	}
+	threadJoin(&_load->thread);
+	OBJZ_OUTPUT_FREE(ctx, _load);
+}
+
+// Case-insensitive index of names stored elsewhere, e.g. material names. Open addressing with linear probing, like VertexHashMap.
+// Slots hold the name hash in the high 32 bits and the caller's index in the low 32 bits. The hashes are kept, so growing doesn't need the names.
+typedef struct {
+	objzContext *ctx;
+	uint64_t *slots; // UINT64_MAX if empty.
+	uint32_t numSlots, numEntries;
+} NameHashMap;
+
+// FNV-1a of the ASCII lowercase name, the same as OBJZ_STRNICMP in the C locale.
+static uint32_t nameHash(const char *_text, size_t _length) {
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < _length; i++) {
+		const uint8_t c = (uint8_t)_text[i];
+		hash = (hash ^ (c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c)) * 16777619u;
+	}
+	return hash;
+}
+
+static void nameHashMapInit(NameHashMap *_map, objzContext *_ctx) {
+	_map->ctx = _ctx;
+	_map->slots = NULL;
+	_map->numSlots = _map->numEntries = 0;
+}
+
+static void nameHashMapDestroy(NameHashMap *_map) {
+	OBJZ_FREE(_map->ctx, _map->slots);
+}
+
+static void nameHashMapInsert(NameHashMap *_map, uint32_t _hash, uint32_t _index) {
+	// Keep the load factor at most 1/2.
+	if ((_map->numEntries + 1) * 2 > _map->numSlots) {
+		const uint32_t oldNumSlots = _map->numSlots;
+		uint64_t *oldSlots = _map->slots;
+		_map->numSlots = oldNumSlots ? oldNumSlots * 2 : 64;
+		_map->slots = OBJZ_MALLOC(_map->ctx, sizeof(uint64_t) * _map->numSlots);
+		memset(_map->slots, 0xff, sizeof(uint64_t) * _map->numSlots);
+		_map->numEntries = 0;
+		for (uint32_t i = 0; i < oldNumSlots; i++) {
+			if (oldSlots[i] != UINT64_MAX)
+				nameHashMapInsert(_map, (uint32_t)(oldSlots[i] >> 32), (uint32_t)oldSlots[i]);
+		}
+		OBJZ_FREE(_map->ctx, oldSlots);
+	}
+	uint32_t slot = _hash & (_map->numSlots - 1);
+	while (_map->slots[slot] != UINT64_MAX)
+		slot = (slot + 1) & (_map->numSlots - 1);
+	_map->slots[slot] = ((uint64_t)_hash << 32) | _index;
+	_map->numEntries++;
+}
+
+// Indices with the same hash, in the order they were inserted. Start with *_slot = _hash. Returns UINT32_MAX when there are no more.
+static uint32_t nameHashMapNext(const NameHashMap *_map, uint32_t _hash, uint32_t *_slot) {
+	if (_map->numSlots == 0)
+		return UINT32_MAX;
+	for (;;) {
+		const uint64_t entry = _map->slots[*_slot & (_map->numSlots - 1)];
+		*_slot = (*_slot & (_map->numSlots - 1)) + 1;
+		if (entry == UINT64_MAX)
+			return UINT32_MAX;
+		if ((uint32_t)(entry >> 32) == _hash)
+			return (uint32_t)entry;
+	}
+}
+
+// A material library, loaded on another thread while the obj file is parsed if numThreads > 1.
+typedef struct {
+	objzContext ctx; // Copy of the load context with a separate error buffer. Only used on another thread.
+	const char *objFilename;
+	objzMtllibResolveFunc resolve;
+	void *userData;
+	const char *name; // A copy: materialLibs can be reallocated while the job runs.
+	Array materials;
+	bool result;
+	bool async;
+	Thread thread;
+} MaterialJob;
+
+// A 'usemtl' name, and the number of 'mtllib' statements before it: only materials from those libraries can match.
+typedef struct {
+	uint32_t nameOffset; // In usemtlNames.
+	uint32_t numLibraries;
+} UsedMaterial;
+
+static void materialJobRun(void *_data) {
+	MaterialJob *job = (MaterialJob *)_data;
+	job->result = loadMaterialFile(&job->ctx, job->objFilename, job->resolve, job->userData, job->name, &job->materials);
+}
+
+// Parse state for one obj file. Used by all the load functions: objz_load and objz_loadFromMemory feed the parser whole lines straight from the file buffer, objz_parserFeed buffers lines split across chunks.
+struct objzParser {
+	objzContext *ctx;
+	const char *filename; // Used for progress and error messages. If resolve is NULL, material files are found relative to this.
+	objzMtllibResolveFunc resolve;
+	void *userData;
+	Array materialLibs, materials, tempObjects;
+	NameHashMap materialLibIndex, materialIndex; // Offsets into materialLibs, indices of materials. Only the first material with a name is indexed.
+	Array materialJobs; // MaterialJob *, one per material library, in 'mtllib' order.
+	uint32_t firstRunningJob; // Jobs before this one have finished.
+	Array usemtlNames; // Null terminated names, one after another.
+	Array usemtls; // UsedMaterial. Until parserResolveMaterials, currentMaterialIndex and Face.materialIndex are indices of these.
+	NameHashMap usemtlIndex;
+	ChunkedArray positions, texcoords, normals, faces;
+	Array rawFaceIndices, faceIndices, tempFaceIndices; // Re-used per face.
+	bool generateNormals;
+	char currentGroupName[OBJZ_NAME_MAX];
+	char currentObjectName[OBJZ_NAME_MAX];
+	int32_t currentMaterialIndex;
+	uint16_t currentSmoothingGroup;
+	uint32_t flags;
+	Lexer lexer;
+	// objz_parserFeed only.
+	Array partialLine; // The end of the last chunk, if it didn't end with a newline.
+	bool checkedEncoding;
+	bool failed;
+};
+
+static void parserInit(objzParser *_parser, objzContext *_ctx, const char *_filename, objzMtllibResolveFunc _resolve, void *_userData) {
+	_parser->ctx = _ctx;
+	_parser->filename = _filename;
+	_parser->resolve = _resolve;
+	_parser->userData = _userData;
+	arrayInit(&_parser->materialLibs, _ctx, sizeof(char), 256); // Null terminated names, one after another.
+	arrayInit(&_parser->materials, _ctx, sizeof(objzMaterial), 16);
+	nameHashMapInit(&_parser->materialLibIndex, _ctx);
+	nameHashMapInit(&_parser->materialIndex, _ctx);
+	arrayInit(&_parser->materialJobs, _ctx, sizeof(void *), 8);
+	_parser->firstRunningJob = 0;
+	arrayInit(&_parser->usemtlNames, _ctx, sizeof(char), 256);
+	arrayInit(&_parser->usemtls, _ctx, sizeof(UsedMaterial), 16);
+	nameHashMapInit(&_parser->usemtlIndex, _ctx);
+	arrayInit(&_parser->tempObjects, _ctx, sizeof(TempObject), 64);
+	chunkedArrayInit(&_parser->positions, _ctx, sizeof(float) * 3, 100000);
+	chunkedArrayInit(&_parser->texcoords, _ctx, sizeof(float) * 2, 100000);
+	chunkedArrayInit(&_parser->normals, _ctx, sizeof(float) * 3, 100000);
+	chunkedArrayInit(&_parser->faces, _ctx, sizeof(Face), 100000);
+	arrayInit(&_parser->rawFaceIndices, _ctx, sizeof(int32_t) * 3, 8);
+	arrayInit(&_parser->faceIndices, _ctx, sizeof(IndexTriplet), 8);
+	arrayInit(&_parser->tempFaceIndices, _ctx, sizeof(IndexTriplet), 8);
+	_parser->generateNormals = false;
+	_parser->currentGroupName[0] = 0;
+	_parser->currentObjectName[0] = 0;
+	_parser->currentMaterialIndex = -1;
+	_parser->currentSmoothingGroup = 0;
+	_parser->flags = 0;
+	initLexer(&_parser->lexer);
+	arrayInit(&_parser->partialLine, _ctx, sizeof(char), 256);
+	_parser->checkedEncoding = false;
+	_parser->failed = false;
+}
+
+// Wait for any material libraries that are still loading, and free them.
+static void parserDestroyMaterialJobs(objzParser *_parser) {
+	for (uint32_t i = 0; i < _parser->materialJobs.length; i++) {
+		MaterialJob *job = *(MaterialJob **)OBJZ_ARRAY_ELEMENT(_parser->materialJobs, i);
+		threadJoin(&job->thread);
+		arrayDestroy(&job->materials);
+		OBJZ_FREE(_parser->ctx, job);
+	}
+	_parser->materialJobs.length = 0;
+}
+
+// Free everything. Used if parsing fails, otherwise parserFinish frees the parse state.
+static void parserDestroy(objzParser *_parser) {
+	parserDestroyMaterialJobs(_parser);
+	arrayDestroy(&_parser->materialJobs);
+	arrayDestroy(&_parser->usemtlNames);
+	arrayDestroy(&_parser->usemtls);
+	nameHashMapDestroy(&_parser->usemtlIndex);
+	arrayDestroy(&_parser->materialLibs);
+	arrayDestroy(&_parser->materials);
+	nameHashMapDestroy(&_parser->materialLibIndex);
+	nameHashMapDestroy(&_parser->materialIndex);
+	arrayDestroy(&_parser->tempObjects);
+	chunkedArrayDestroy(&_parser->positions);
+	chunkedArrayDestroy(&_parser->texcoords);
+	chunkedArrayDestroy(&_parser->normals);
+	chunkedArrayDestroy(&_parser->faces);
+	arrayDestroy(&_parser->rawFaceIndices);
+	arrayDestroy(&_parser->faceIndices);
+	arrayDestroy(&_parser->tempFaceIndices);
+	arrayDestroy(&_parser->partialLine);
+}
+
+// Face vertex shapes: v, v/vt, v//vn or v/vt/vn.
+#define OBJZ_FACE_VT (1<<0)
+#define OBJZ_FACE_VN (1<<1)
+
+// Exporters don't mix shapes within a face, so the first vertex decides it for the whole line.
+static uint32_t faceShape(const char *_text, const char *_end) {
+	const char *p = _text;
+	while (p < _end && *p != '/' && !isWhitespaceChar(*p))
+		p++;
+	if (p >= _end || *p != '/')
+		return 0;
+	p++;
+	if (p < _end && *p == '/')
+		return OBJZ_FACE_VN;
+	while (p < _end && *p != '/' && !isWhitespaceChar(*p))
+		p++;
+	return p < _end && *p == '/' ? OBJZ_FACE_VT | OBJZ_FACE_VN : OBJZ_FACE_VT;
+}
+
+// [sign] digits, the same value as tokenToInt. Returns NULL if there are no digits.
+static const char *parseIndex(const char *_text, const char *_end, int32_t *_index) {
+	bool negative = false;
+	if (_text < _end && (*_text == '+' || *_text == '-')) {
+		negative = *_text == '-';
+		_text++;
+	}
+	if (_text >= _end || !IS_DIGIT(*_text))
+		return NULL;
+	uint32_t value = 0;
+	for (; _text < _end && IS_DIGIT(*_text); _text++)
+		value = value * 10 + (uint32_t)(*_text - '0');
+	*_index = (int32_t)(negative ? 0u - value : value);
+	return _text;
+}
+
+// Parse the v/vt/vn triplets after 'f', appending them to _rawIndices (int32_t[3] elements).
+// Vertices matching the line's shape are parsed in a single pass, anything else falls back to tokenizing and parseVertexAttribIndices.
+static bool parseFace(objzContext *_ctx, Lexer *_lexer, const Token *_fToken, Array *_rawIndices) {
+	const uint32_t start = _rawIndices->length;
+	skipWhitespace(_lexer);
+	const uint32_t shape = faceShape(_lexer->buf, _lexer->end);
+	for (;;) {
+		skipWhitespace(_lexer);
+		if (isEol(_lexer))
+			break;
+		const char *p = _lexer->buf;
+		int32_t rawTriplet[3];
+		rawTriplet[1] = rawTriplet[2] = INT_MAX;
+		p = parseIndex(p, _lexer->end, &rawTriplet[0]);
+		if (p && shape) {
+			p = p < _lexer->end && *p == '/' ? p + 1 : NULL;
+			if (p && (shape & OBJZ_FACE_VT))
+				p = parseIndex(p, _lexer->end, &rawTriplet[1]);
+			if (p && (shape & OBJZ_FACE_VN)) {
+				p = p < _lexer->end && *p == '/' ? p + 1 : NULL;
+				if (p)
+					p = parseIndex(p, _lexer->end, &rawTriplet[2]);
 			}
 		}
-		if (!line)
+		if (!p || (p < _lexer->end && !isWhitespaceChar(*p)))
+			break; // Doesn't match the shape.
+		_lexer->buf = p;
+		arrayAppend(_rawIndices, rawTriplet);
+	}
+	for (;;) {
+		Token tripletToken;
+		tokenize(_lexer, &tripletToken, false);
+		if (tripletToken.length == 0) {
+			if (isEol(_lexer))
+				break;
+			appendError(_ctx, "(%u:%u) Failed to parse face", _lexer->line, tokenColumn(_lexer, &tripletToken));
+			return false;
+		}
+		// Parse v/vt/vn triplet.
+		int32_t rawTriplet[3];
+		if (!parseVertexAttribIndices(&tripletToken, rawTriplet)) {
+			appendError(_ctx, "(%u:%u) Failed to parse face", _lexer->line, tokenColumn(_lexer, &tripletToken));
+			return false;
+		}
+		arrayAppend(_rawIndices, rawTriplet);
+	}
+	if (_rawIndices->length - start < 3) {
+		appendError(_ctx, "(%u:%u) Face needs at least 3 vertices", _lexer->line, tokenColumn(_lexer, _fToken));
+		return false;
+	}
+	return true;
+}
+
+// Resolve raw face indices to _parser->faceIndices. _numPositions etc. are the number of each attribute before the face, for relative indices.
+static void parserSetFaceIndices(objzParser *_parser, const int32_t *_rawIndices, uint32_t _n, uint32_t _numPositions, uint32_t _numTexcoords, uint32_t _numNormals) {
+	_parser->faceIndices.length = 0;
+	for (uint32_t i = 0; i < _n; i++) {
+		const int32_t *rawTriplet = &_rawIndices[i * 3];
+		IndexTriplet triplet;
+		triplet.v = fixVertexAttribIndex(rawTriplet[0], _numPositions);
+		triplet.vt = fixVertexAttribIndex(rawTriplet[1], _numTexcoords);
+		triplet.vn = fixVertexAttribIndex(rawTriplet[2], _numNormals);
+		arrayAppend(&_parser->faceIndices, &triplet);
+	}
+}
+
+// Add the face in _parser->faceIndices to the current object.
+static void parserAddFace(objzParser *_parser) {
+	for (uint32_t i = 0; i < _parser->faceIndices.length; i++) {
+		const IndexTriplet *triplet = OBJZ_ARRAY_ELEMENT(_parser->faceIndices, i);
+		if (triplet->vn == UINT32_MAX && _parser->ctx->vertexDecl.normalOffset != SIZE_MAX)
+			_parser->generateNormals = true;
+	}
+	// Get current object.
+	if (_parser->tempObjects.length == 0) {
+		// No objects specifed, but there's a face, so create one.
+		TempObject o;
+		o.name[0] = 0;
+		o.firstFace = o.numFaces = 0;
+		arrayAppend(&_parser->tempObjects, &o);
+	}
+	TempObject *object = OBJZ_ARRAY_ELEMENT(_parser->tempObjects, _parser->tempObjects.length - 1);
+	// Triangulate.
+	if (_parser->faceIndices.length == 3) {
+		Face face;
+		face.materialIndex = _parser->currentMaterialIndex;
+		face.smoothingGroup = _parser->currentSmoothingGroup;
+		for (int i = 0; i < 3; i++)
+			face.indices[i] = *(IndexTriplet *)OBJZ_ARRAY_ELEMENT(_parser->faceIndices, i);
+		chunkedArrayAppend(&_parser->faces, &face);
+		object->numFaces++;
+	} else {
+		const uint32_t prevFacesLength = _parser->faces.length;
+		triangulate(&_parser->faceIndices, &_parser->positions, &_parser->tempFaceIndices, &_parser->faces, _parser->currentMaterialIndex, _parser->currentSmoothingGroup);
+		object->numFaces += _parser->faces.length - prevFacesLength;
+	}
+}
+
+// Parse the obj file and any material files.
+// Faces are triangulated. Other than that, this is straight parsing.
+// Index of the first material with the name, or -1. Case-insensitive, like the other statements.
+static int32_t parserFindMaterial(const objzParser *_parser, const char *_name, size_t _length) {
+	const uint32_t hash = nameHash(_name, _length);
+	uint32_t slot = hash;
+	for (;;) {
+		const uint32_t index = nameHashMapNext(&_parser->materialIndex, hash, &slot);
+		if (index == UINT32_MAX)
+			return -1;
+		const objzMaterial *mat = OBJZ_ARRAY_ELEMENT(_parser->materials, index);
+		if (strlen(mat->name) == _length && OBJZ_STRNICMP(_name, mat->name, _length) == 0)
+			return (int32_t)index;
+	}
+}
+
+// With more than one thread, the library is loaded on another thread, and at most numThreads - 1 are loaded at once. Otherwise it's loaded now.
+static bool parserLoadMaterialLibrary(objzParser *_parser, const char *_name) {
+	objzContext *ctx = _parser->ctx;
+	const size_t nameSize = strlen(_name) + 1;
+	MaterialJob *job = OBJZ_MALLOC(ctx, sizeof(MaterialJob) + nameSize);
+	memcpy(job + 1, _name, nameSize);
+	job->objFilename = _parser->filename;
+	job->resolve = _parser->resolve;
+	job->userData = _parser->userData;
+	job->name = (const char *)(job + 1);
+	job->thread.started = false;
+	job->async = OBJZ_THREADS && ctx->numThreads > 1;
+	arrayAppend(&_parser->materialJobs, &job);
+	if (!job->async) {
+		arrayInit(&job->materials, ctx, sizeof(objzMaterial), 16);
+		job->result = loadMaterialFile(ctx, job->objFilename, job->resolve, job->userData, job->name, &job->materials);
+		return job->result;
+	}
+	if (_parser->materialJobs.length - _parser->firstRunningJob > ctx->numThreads - 1) {
+		MaterialJob *oldest = *(MaterialJob **)OBJZ_ARRAY_ELEMENT(_parser->materialJobs, _parser->firstRunningJob);
+		threadJoin(&oldest->thread);
+		_parser->firstRunningJob++;
+	}
+	job->ctx = *ctx;
+	job->ctx.progressFunc = NULL;
+	job->ctx.arena = NULL; // Material libraries are small, and jobs can run at the same time as any other step.
+	job->ctx.error[0] = 0;
+	arrayInit(&job->materials, &job->ctx, sizeof(objzMaterial), 16);
+	threadStart(&job->thread, materialJobRun, job);
+	return true;
+}
+
+// Index of the UsedMaterial for the name and the libraries so far, added if needed.
+static uint32_t parserAddUsemtl(objzParser *_parser, const char *_name, size_t _length) {
+	const uint32_t hash = nameHash(_name, _length);
+	uint32_t slot = hash;
+	for (;;) {
+		const uint32_t index = nameHashMapNext(&_parser->usemtlIndex, hash, &slot);
+		if (index == UINT32_MAX)
 			break;
-		lexerSetLine(&lexer, line);
-		tokenize(&lexer, &token, false);
-		if (OBJZ_STRICMP(token.text, "f") == 0) {
-			// Get current object.
-			if (tempObjects.length == 0) {
-				// No objects specifed, but there's a face, so create one.
-				TempObject o;
-				o.name[0] = 0;
-				o.firstFace = o.numFaces = 0;
-				arrayAppend(&tempObjects, &o);
+		const UsedMaterial *used = OBJZ_ARRAY_ELEMENT(_parser->usemtls, index);
+		const char *name = OBJZ_ARRAY_ELEMENT(_parser->usemtlNames, used->nameOffset);
+		if (used->numLibraries == _parser->materialJobs.length && strlen(name) == _length && OBJZ_STRNICMP(_name, name, _length) == 0)
+			return index;
+	}
+	UsedMaterial used;
+	used.nameOffset = _parser->usemtlNames.length;
+	used.numLibraries = _parser->materialJobs.length;
+	const char nullTerminator = 0;
+	for (size_t i = 0; i < _length; i++)
+		arrayAppend(&_parser->usemtlNames, &_name[i]);
+	arrayAppend(&_parser->usemtlNames, &nullTerminator);
+	const uint32_t index = _parser->usemtls.length;
+	arrayAppend(&_parser->usemtls, &used);
+	nameHashMapInsert(&_parser->usemtlIndex, hash, index);
+	return index;
+}
+
+// Wait for the material libraries, add their materials in 'mtllib' order, and change the faces' UsedMaterial indices to material indices.
+// Warnings and errors from libraries loaded on other threads are reported here. The result is the same as loading each library at its 'mtllib' statement.
+static bool parserResolveMaterials(objzParser *_parser) {
+	objzContext *ctx = _parser->ctx;
+	const uint32_t numLibraries = _parser->materialJobs.length;
+	uint32_t *firstMaterials = OBJZ_MALLOC(ctx, sizeof(uint32_t) * (numLibraries + 1));
+	bool result = true;
+	for (uint32_t i = 0; i < numLibraries; i++) {
+		MaterialJob *job = *(MaterialJob **)OBJZ_ARRAY_ELEMENT(_parser->materialJobs, i);
+		threadJoin(&job->thread);
+		if (job->async && job->ctx.error[0])
+			appendError(ctx, "%s", job->ctx.error);
+		if (!job->result) {
+			result = false;
+			break;
+		}
+		firstMaterials[i] = _parser->materials.length;
+		for (uint32_t j = 0; j < job->materials.length; j++) {
+			const objzMaterial *mat = OBJZ_ARRAY_ELEMENT(job->materials, j);
+			const size_t nameLength = strlen(mat->name);
+			if (parserFindMaterial(_parser, mat->name, nameLength) == -1)
+				nameHashMapInsert(&_parser->materialIndex, nameHash(mat->name, nameLength), _parser->materials.length);
+			arrayAppend(&_parser->materials, mat);
+		}
+	}
+	parserDestroyMaterialJobs(_parser);
+	firstMaterials[numLibraries] = _parser->materials.length;
+	if (result && _parser->usemtls.length > 0) {
+		int32_t *materialIndices = OBJZ_MALLOC(ctx, sizeof(int32_t) * _parser->usemtls.length);
+		for (uint32_t i = 0; i < _parser->usemtls.length; i++) {
+			const UsedMaterial *used = OBJZ_ARRAY_ELEMENT(_parser->usemtls, i);
+			const char *name = OBJZ_ARRAY_ELEMENT(_parser->usemtlNames, used->nameOffset);
+			const int32_t materialIndex = parserFindMaterial(_parser, name, strlen(name));
+			materialIndices[i] = materialIndex >= 0 && (uint32_t)materialIndex < firstMaterials[used->numLibraries] ? materialIndex : -1;
+		}
+		for (uint32_t i = 0; i < _parser->faces.length; i++) {
+			Face *face = chunkedArrayElement(&_parser->faces, i);
+			if (face->materialIndex >= 0)
+				face->materialIndex = materialIndices[face->materialIndex];
+		}
+		OBJZ_FREE(ctx, materialIndices);
+	}
+	OBJZ_FREE(ctx, firstMaterials);
+	return result;
+}
+
+static bool parseLine(objzParser *_parser, const char *_line, size_t _length, const char *_bufferEnd) {
+	objzContext *ctx = _parser->ctx;
+	Token token;
+	lexerSetLine(&_parser->lexer, _line, _length, _bufferEnd);
+	tokenize(&_parser->lexer, &token, false);
+	const uint32_t keyword = lookupKeyword(&token);
+	if (keyword == OBJZ_KEYWORD_F) {
+		_parser->rawFaceIndices.length = 0;
+		if (!parseFace(ctx, &_parser->lexer, &token, &_parser->rawFaceIndices))
+			return false;
+		parserSetFaceIndices(_parser, (const int32_t *)_parser->rawFaceIndices.data, _parser->rawFaceIndices.length, _parser->positions.length, _parser->texcoords.length, _parser->normals.length);
+		parserAddFace(_parser);
+	} else if (keyword == OBJZ_KEYWORD_G || keyword == OBJZ_KEYWORD_O) {
+		const bool isGroup = keyword == OBJZ_KEYWORD_G;
+		tokenize(&_parser->lexer, &token, true);
+		if (isGroup) {
+			// Empty group names are permitted.
+			if (token.length != 0)
+				strCopy(_parser->currentGroupName, sizeof(_parser->currentGroupName), token.text, token.length);
+		}
+		else {
+			if (token.length == 0) {
+				appendError(ctx, "(%u:%u) Expected name after 'o'", _parser->lexer.line, tokenColumn(&_parser->lexer, &token));
+				return false;
 			}
-			TempObject *object = OBJZ_ARRAY_ELEMENT(tempObjects, tempObjects.length - 1);
-			// Parse triplets.
-			faceIndices.length = 0;
-			for (;;) {
-				Token tripletToken;
-				tokenize(&lexer, &tripletToken, false);
-				if (tripletToken.text[0] == 0) {
-					if (isEol(&lexer))
+			strCopy(_parser->currentObjectName, sizeof(_parser->currentObjectName), token.text, token.length);
+		}
+		TempObject o;
+		o.name[0] = 0;
+		if (_parser->currentGroupName[0] != 0)
+			strCopy(o.name, sizeof(o.name), _parser->currentGroupName, strLength(_parser->currentGroupName, sizeof(_parser->currentGroupName)));
+		if (_parser->currentObjectName[0] != 0) {
+			if (strLength(o.name, sizeof(o.name)) > 0)
+				strConcat(o.name, sizeof(o.name), " ", 1);
+			strConcat(o.name, sizeof(o.name), _parser->currentObjectName, strLength(_parser->currentObjectName, sizeof(_parser->currentObjectName)));
+		}
+		o.firstFace = _parser->faces.length;
+		o.numFaces = 0;
+		arrayAppend(&_parser->tempObjects, &o);
+	} else if (keyword == OBJZ_KEYWORD_MTLLIB) {
+		tokenize(&_parser->lexer, &token, true);
+		if (token.length == 0) {
+			appendError(ctx, "(%u:%u) Expected name after 'mtllib'", _parser->lexer.line, tokenColumn(&_parser->lexer, &token));
+			return false;
+		}
+		// Don't load the same material library twice.
+		const uint32_t hash = nameHash(token.text, token.length);
+		uint32_t slot = hash;
+		for (;;) {
+			const uint32_t offset = nameHashMapNext(&_parser->materialLibIndex, hash, &slot);
+			if (offset == UINT32_MAX)
+				break;
+			if (tokenEquals(&token, OBJZ_ARRAY_ELEMENT(_parser->materialLibs, offset)))
+				return true;
+		}
+		const uint32_t nameOffset = _parser->materialLibs.length;
+		const char nullTerminator = 0;
+		for (uint32_t i = 0; i < token.length; i++)
+			arrayAppend(&_parser->materialLibs, &token.text[i]);
+		arrayAppend(&_parser->materialLibs, &nullTerminator);
+		nameHashMapInsert(&_parser->materialLibIndex, hash, nameOffset);
+		if (!parserLoadMaterialLibrary(_parser, OBJZ_ARRAY_ELEMENT(_parser->materialLibs, nameOffset)))
+			return false;
+	} else if (keyword == OBJZ_KEYWORD_S) {
+		tokenize(&_parser->lexer, &token, false);
+		if (token.length == 0) {
+			appendError(ctx, "(%u:%u) Expected value after 's'", _parser->lexer.line, tokenColumn(&_parser->lexer, &token));
+			return false;
+		}
+		if (tokenEquals(&token, "off"))
+			_parser->currentSmoothingGroup = 0;
+		else
+			_parser->currentSmoothingGroup = (uint16_t)tokenToInt(token.text, token.text + token.length);
+	} else if (keyword == OBJZ_KEYWORD_USEMTL) {
+		tokenize(&_parser->lexer, &token, false);
+		if (token.length == 0) {
+			appendError(ctx, "(%u:%u) Expected name after 'usemtl'", _parser->lexer.line, tokenColumn(&_parser->lexer, &token));
+			return false;
+		}
+		_parser->currentMaterialIndex = (int32_t)parserAddUsemtl(_parser, token.text, token.length);
+	} else if (keyword == OBJZ_KEYWORD_V) {
+		float pos[3];
+		if (!parseFloats(ctx, &_parser->lexer, pos, 3))
+			return false;
+		chunkedArrayAppend(&_parser->positions, pos);
+	} else if (keyword == OBJZ_KEYWORD_VN) {
+		float normal[3];
+		if (!parseFloats(ctx, &_parser->lexer, normal, 3))
+			return false;
+		chunkedArrayAppend(&_parser->normals, normal);
+		_parser->flags |= OBJZ_FLAG_NORMALS;
+	} else if (keyword == OBJZ_KEYWORD_VT) {
+		float texcoord[2];
+		if (!parseFloats(ctx, &_parser->lexer, texcoord, 2))
+			return false;
+		chunkedArrayAppend(&_parser->texcoords, texcoord);
+		_parser->flags |= OBJZ_FLAG_TEXCOORDS;
+	}
+	return true;
+}
+
+static int compareUint32(const void *_a, const void *_b) {
+	const uint32_t a = *(const uint32_t *)_a, b = *(const uint32_t *)_b;
+	return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+// Post-processing output for one object. Indices and vertices are numbered from 0 within the object until parserFinish stitches the objects together.
+typedef struct {
+	Array meshes; // objzMesh, firstIndex is relative to the object.
+	Array indices; // uint32_t
+	VertexHashMap vertexHashMap; // Normal keys >= PostProcess.numFileNormals are generated: normals[key - numFileNormals].
+	ChunkedArray normals; // vec3, generated normals.
+	uint32_t firstMesh, firstIndex, firstVertex; // Where the object goes in the model.
+} ObjectOutput;
+
+// Per worker state, re-used for each object.
+typedef struct {
+	objzContext ctx; // The object outputs are allocated with this, see arenaWorkerContext.
+	NormalHashMap normalHashMap;
+	uint32_t *materialFaceCounts;
+	uint32_t *objectMaterials;
+	uint32_t *sortedFaces;
+} ObjectWorker;
+
+typedef struct {
+	objzParser *parser;
+	const vec3 *faceNormals;
+	const Array *smoothNormals;
+	const uint32_t *cornerNormals;
+	uint32_t numFileNormals;
+	ObjectOutput *outputs; // One per temp object.
+	ObjectWorker *workers;
+	objzModel *model;
+	bool index32; // Model indices are uint32_t.
+	int progress; // Only used by worker 0, the calling thread.
+} PostProcess;
+
+// Task: find the unique vertices of one object, generating normals, and build its meshes.
+static void buildObject(TaskPool *_pool, uint32_t _task, uint32_t _worker) {
+	PostProcess *pp = (PostProcess *)_pool->data;
+	objzParser *parser = pp->parser;
+	ObjectWorker *worker = &pp->workers[_worker];
+	objzContext *ctx = &worker->ctx;
+	if (_worker == 0 && ctx->progressFunc) {
+		const int newProgress = (int)(75.0f + (taskPoolNumDone(_pool) / (float)_pool->numTasks) * 20.0f);
+		if (newProgress > pp->progress) {
+			pp->progress = newProgress;
+			ctx->progressFunc(parser->filename, pp->progress);
+		}
+	}
+	const TempObject *tempObject = OBJZ_ARRAY_ELEMENT(parser->tempObjects, _task);
+	if (!tempObject->numFaces)
+		return;
+	ObjectOutput *output = &pp->outputs[_task];
+	arrayInit(&output->meshes, ctx, sizeof(objzMesh), 4); // Guess capacity
+	arrayInit(&output->indices, ctx, sizeof(uint32_t), tempObject->numFaces * 3); // Exact capacity
+	vertexHashMapInit(&output->vertexHashMap, ctx, tempObject->numFaces, tempObject->numFaces * 3); // Guess capacity
+	if (parser->generateNormals) {
+		chunkedArrayInit(&output->normals, ctx, sizeof(vec3), OBJZ_LARGEST(OBJZ_SMALLEST(tempObject->numFaces, 100000), 64));
+		worker->normalHashMap.normals = &output->normals;
+		normalHashMapClear(&worker->normalHashMap);
+	}
+	// Counting sort the object's faces by material, keeping their order within each material. No material (-1) is bucket 0.
+	uint32_t *materialFaceCounts = worker->materialFaceCounts;
+	uint32_t *objectMaterials = worker->objectMaterials;
+	uint32_t *sortedFaces = worker->sortedFaces;
+	uint32_t numObjectMaterials = 0;
+	for (uint32_t j = 0; j < tempObject->numFaces; j++) {
+		const Face *face = chunkedArrayElement(&parser->faces, tempObject->firstFace + j);
+		const uint32_t bucket = (uint32_t)(face->materialIndex + 1);
+		if (materialFaceCounts[bucket]++ == 0)
+			objectMaterials[numObjectMaterials++] = bucket;
+	}
+	qsort(objectMaterials, numObjectMaterials, sizeof(uint32_t), compareUint32);
+	uint32_t offset = 0;
+	for (uint32_t j = 0; j < numObjectMaterials; j++) {
+		const uint32_t count = materialFaceCounts[objectMaterials[j]];
+		materialFaceCounts[objectMaterials[j]] = offset;
+		offset += count;
+	}
+	for (uint32_t j = 0; j < tempObject->numFaces; j++) {
+		const Face *face = chunkedArrayElement(&parser->faces, tempObject->firstFace + j);
+		sortedFaces[materialFaceCounts[(uint32_t)(face->materialIndex + 1)]++] = j;
+	}
+	// Create one mesh per material. No material (-1) gets a mesh too.
+	uint32_t sortedStart = 0;
+	for (uint32_t m = 0; m < numObjectMaterials; m++) {
+		// Each count is now the end of its material's faces in sortedFaces.
+		const uint32_t sortedEnd = materialFaceCounts[objectMaterials[m]];
+		materialFaceCounts[objectMaterials[m]] = 0;
+		objzMesh mesh;
+		mesh.firstIndex = output->indices.length;
+		mesh.numIndices = 0;
+		mesh.materialIndex = (int32_t)objectMaterials[m] - 1;
+		for (uint32_t sorted = sortedStart; sorted < sortedEnd; sorted++) {
+			if (((sorted - sortedStart) & 4095) == 0 && loadCancelled(ctx))
+				break; // parserFinish discards the output. The loop over materials continues, to reset materialFaceCounts for the worker's next object.
+			const uint32_t j = sortedFaces[sorted];
+			const Face *face = chunkedArrayElement(&parser->faces, tempObject->firstFace + j);
+			uint32_t faceNormalIndex = UINT32_MAX;
+			if (parser->generateNormals && face->smoothingGroup == 0) {
+				for (int k = 0; k < 3; k++) {
+					if (face->indices[k].vn >= pp->numFileNormals) {
+						faceNormalIndex = pp->numFileNormals + normalHashMapInsert(&worker->normalHashMap, &pp->faceNormals[tempObject->firstFace + j]);
 						break;
-					appendError("(%u:%u) Failed to parse face", tripletToken.line, tripletToken.column);
-					goto error;
-				}
-				// Parse v/vt/vn triplet.
-				int32_t rawTriplet[3];
-				if (!parseVertexAttribIndices(&tripletToken, rawTriplet)) {
-					appendError("(%u:%u) Failed to parse face", tripletToken.line, tripletToken.column);
-					goto error;
+					}
 				}
-				IndexTriplet triplet;
-				triplet.v = fixVertexAttribIndex(rawTriplet[0], positions.length);
-				triplet.vt = fixVertexAttribIndex(rawTriplet[1], texcoords.length);
-				triplet.vn = fixVertexAttribIndex(rawTriplet[2], normals.length);
-				arrayAppend(&faceIndices, &triplet);
-				if (triplet.vn == UINT32_MAX && s_vertexDecl.normalOffset != SIZE_MAX)
-					generateNormals = true;
-			}
-			if (faceIndices.length < 3) {
-				appendError("(%u:%u) Face needs at least 3 vertices", token.line, token.column);
-				goto error;
-			}
-			// Triangulate.
-			if (faceIndices.length == 3) {
-				Face face;
-				face.materialIndex = (int16_t)currentMaterialIndex;
-				face.smoothingGroup = currentSmoothingGroup;
-				for (int i = 0; i < 3; i++)
-					face.indices[i] = *(IndexTriplet *)OBJZ_ARRAY_ELEMENT(faceIndices, i);
-				chunkedArrayAppend(&faces, &face);
-				object->numFaces++;
-			} else {
-				const uint32_t prevFacesLength = faces.length;
-				triangulate(&faceIndices, &positions, &tempFaceIndices, &faces, currentMaterialIndex, currentSmoothingGroup);
-				object->numFaces += faces.length - prevFacesLength;
-			}
-		} else if (OBJZ_STRICMP(token.text, "g") == 0 || OBJZ_STRICMP(token.text, "o") == 0) {
-			const bool isGroup = OBJZ_STRICMP(token.text, "g") == 0;
-			tokenize(&lexer, &token, true);
-			if (isGroup) {
-				// Empty group names are permitted.
-				if (token.text[0] != 0)
-					strCopy(currentGroupName, sizeof(currentGroupName), token.text, strLength(token.text, sizeof(token.text)));
 			}
-			else {
-				if (token.text[0] == 0) {
-					appendError("(%u:%u) Expected name after 'o'", token.line, token.column);
-					goto error;
+			for (int k = 0; k < 3; k++) {
+				const IndexTriplet *triplet = &face->indices[k];
+				uint32_t vn = triplet->vn;
+				if (parser->generateNormals) {
+					if (face->smoothingGroup > 0) {
+						const uint32_t smoothNormal = pp->cornerNormals[(tempObject->firstFace + j) * 3 + k];
+						if (smoothNormal != UINT32_MAX) // Invalid position index.
+							vn = pp->numFileNormals + normalHashMapInsert(&worker->normalHashMap, OBJZ_ARRAY_ELEMENT(*pp->smoothNormals, smoothNormal));
+					} else if (faceNormalIndex != UINT32_MAX)
+						vn = faceNormalIndex;
 				}
-				strCopy(currentObjectName, sizeof(currentObjectName), token.text, strLength(token.text, sizeof(token.text)));
+				const uint32_t index = vertexHashMapInsert(&output->vertexHashMap, _task, triplet->v, triplet->vt, vn);
+				arrayAppend(&output->indices, &index);
+				mesh.numIndices++;
 			}
-			TempObject o;
-			o.name[0] = 0;
-			if (currentGroupName[0] != 0)
-				strCopy(o.name, sizeof(o.name), currentGroupName, strLength(currentGroupName, sizeof(currentGroupName)));
-			if (currentObjectName[0] != 0) {
-				if (strLength(o.name, sizeof(o.name)) > 0)
-					strConcat(o.name, sizeof(o.name), " ", 1);
-				strConcat(o.name, sizeof(o.name), currentObjectName, strLength(currentObjectName, sizeof(currentObjectName)));
-			}
-			o.firstFace = faces.length;
-			o.numFaces = 0;
-			arrayAppend(&tempObjects, &o);
-		} else if (OBJZ_STRICMP(token.text, "mtllib") == 0) {
-			tokenize(&lexer, &token, true);
-			if (token.text[0] == 0) {
-				appendError("(%u:%u) Expected name after 'mtllib'", token.line, token.column);
-				goto error;
-			}
-			// Don't load the same material library twice.
-			bool alreadyLoaded = false;
-			for (uint32_t i = 0; i < materialLibs.length; i++) {
-				if (OBJZ_STRICMP(token.text, (const char *)OBJZ_ARRAY_ELEMENT(materialLibs, i)) == 0) {
-					alreadyLoaded = true;
-					break;
-				}
+		}
+		sortedStart = sortedEnd;
+		arrayAppend(&output->meshes, &mesh);
+	}
+}
+
+static const float s_zeroFloats[3] = { 0, 0, 0 };
+
+// Indices past the end of _array are into _generated, if it isn't NULL. Missing and out of range attributes are zero.
+static const float *vertexAttrib(uint32_t _index, const ChunkedArray *_array, const ChunkedArray *_generated) {
+	if (_index < _array->length)
+		return chunkedArrayElement(_array, _index);
+	if (_generated && _index != UINT32_MAX && _index - _array->length < _generated->length)
+		return chunkedArrayElement(_generated, _index - _array->length);
+	return s_zeroFloats;
+}
+
+// Write the vertices of _map to _out, interleaved. The default vertex format (see objz_setVertexFormat) is written 32 bytes at a time.
+static void writeVertices(const VertexFormat *_format, uint8_t *_out, const VertexHashMap *_map, const ChunkedArray *_positions, const ChunkedArray *_texcoords, const ChunkedArray *_fileNormals, const ChunkedArray *_generatedNormals) {
+	const uint32_t *positions = (const uint32_t *)_map->positions.data;
+	const uint32_t *texcoords = (const uint32_t *)_map->texcoords.data;
+	const uint32_t *normals = (const uint32_t *)_map->normals.data;
+	const VertexFormat defaultFormat = OBJZ_DEFAULT_VERTEX_FORMAT;
+	if (memcmp(_format, &defaultFormat, sizeof(VertexFormat)) == 0) {
+		for (uint32_t i = 0; i < _map->positions.length; i++) {
+			const float *p = vertexAttrib(positions[i], _positions, NULL);
+			const float *t = vertexAttrib(texcoords[i], _texcoords, NULL);
+			const float *n = vertexAttrib(normals[i], _fileNormals, _generatedNormals);
+			float *vOut = (float *)&_out[i * sizeof(float) * 8];
+#if OBJZ_SIMD_WIDTH == 32
+			_mm256_storeu_ps(vOut, _mm256_setr_ps(p[0], p[1], p[2], t[0], t[1], n[0], n[1], n[2]));
+#elif OBJZ_SIMD_WIDTH == 16
+			_mm_storeu_ps(vOut, _mm_setr_ps(p[0], p[1], p[2], t[0]));
+			_mm_storeu_ps(vOut + 4, _mm_setr_ps(t[1], n[0], n[1], n[2]));
+#else
+			const float v[8] = { p[0], p[1], p[2], t[0], t[1], n[0], n[1], n[2] };
+			memcpy(vOut, v, sizeof(v));
+#endif
+		}
+		return;
+	}
+	for (uint32_t i = 0; i < _map->positions.length; i++) {
+		uint8_t *vOut = &_out[i * _format->stride];
+		if (_format->positionOffset != SIZE_MAX)
+			memcpy(&vOut[_format->positionOffset], vertexAttrib(positions[i], _positions, NULL), sizeof(float) * 3);
+		if (_format->texcoordOffset != SIZE_MAX)
+			memcpy(&vOut[_format->texcoordOffset], vertexAttrib(texcoords[i], _texcoords, NULL), sizeof(float) * 2);
+		if (_format->normalOffset != SIZE_MAX)
+			memcpy(&vOut[_format->normalOffset], vertexAttrib(normals[i], _fileNormals, _generatedNormals), sizeof(float) * 3);
+	}
+}
+
+// Task: copy one object's indices and vertices to their place in the model. The object output is freed by parserFinish: it was allocated by the worker that built the object, which may be running another task.
+static void writeObject(TaskPool *_pool, uint32_t _task, uint32_t _worker) {
+	(void)_worker;
+	PostProcess *pp = (PostProcess *)_pool->data;
+	objzParser *parser = pp->parser;
+	objzContext *ctx = parser->ctx;
+	const TempObject *tempObject = OBJZ_ARRAY_ELEMENT(parser->tempObjects, _task);
+	if (!tempObject->numFaces)
+		return;
+	ObjectOutput *output = &pp->outputs[_task];
+	objzModel *model = pp->model;
+	const uint32_t *indices = (const uint32_t *)output->indices.data;
+	if (pp->index32) {
+		uint32_t *modelIndices = &((uint32_t *)model->indices)[output->firstIndex];
+		for (uint32_t i = 0; i < output->indices.length; i++)
+			modelIndices[i] = output->firstVertex + indices[i];
+	} else {
+		uint16_t *modelIndices = &((uint16_t *)model->indices)[output->firstIndex];
+		for (uint32_t i = 0; i < output->indices.length; i++)
+			modelIndices[i] = (uint16_t)(output->firstVertex + indices[i]);
+	}
+	writeVertices(&ctx->vertexDecl, &((uint8_t *)model->vertices)[(size_t)output->firstVertex * ctx->vertexDecl.stride], &output->vertexHashMap, &parser->positions, &parser->texcoords, &parser->normals, parser->generateNormals ? &output->normals : NULL);
+}
+
+// Do some post-processing of parsed data. The parse state is freed.
+// Objects are independent, so they are processed in parallel (see objz_setNumThreads) and then stitched together in order, so the output doesn't depend on the number of threads.
+static objzModel *parserFinish(objzParser *_parser) {
+	objzContext *ctx = _parser->ctx;
+	if (_parser->normals.length == 0)
+		_parser->generateNormals = true;
+	PostProcess pp;
+	pp.parser = _parser;
+	pp.progress = 75;
+	if (ctx->progressFunc)
+		ctx->progressFunc(_parser->filename, pp.progress);
+	// Post-processing:
+	//   * generate normals
+	//   * find unique vertices from separately index vertex attributes (pos, texcoord, normal).
+	//   * build meshes by batching object faces by material
+	vec3 *faceNormals = NULL;
+	Array smoothNormals;
+	uint32_t *cornerNormals = NULL;
+	if (_parser->generateNormals) {
+		faceNormals = OBJZ_MALLOC(ctx, sizeof(vec3) * OBJZ_LARGEST(_parser->faces.length, 1));
+		calculateFaceNormals(&_parser->faces, &_parser->positions, faceNormals);
+		arrayInit(&smoothNormals, ctx, sizeof(vec3), _parser->positions.length); // Guess capacity: one smoothing group per position
+		cornerNormals = OBJZ_MALLOC(ctx, sizeof(uint32_t) * 3 * OBJZ_LARGEST(_parser->faces.length, 1));
+		calculateSmoothNormals(ctx, &_parser->faces, faceNormals, _parser->positions.length, &smoothNormals, cornerNormals);
+	}
+	// Normals don't depend on materials, so material libraries can still be loading on other threads until now.
+	if (checkCancelled(ctx) || !parserResolveMaterials(_parser)) {
+		if (_parser->generateNormals) {
+			OBJZ_FREE(ctx, faceNormals);
+			arrayDestroy(&smoothNormals);
+			OBJZ_FREE(ctx, cornerNormals);
+		}
+		parserDestroy(_parser);
+		return NULL;
+	}
+	arrayDestroy(&_parser->materialJobs);
+	arrayDestroy(&_parser->usemtlNames);
+	arrayDestroy(&_parser->usemtls);
+	nameHashMapDestroy(&_parser->usemtlIndex);
+	arrayDestroy(&_parser->materialLibs);
+	nameHashMapDestroy(&_parser->materialLibIndex);
+	nameHashMapDestroy(&_parser->materialIndex);
+	arrayDestroy(&_parser->rawFaceIndices);
+	arrayDestroy(&_parser->faceIndices);
+	arrayDestroy(&_parser->tempFaceIndices);
+	arrayDestroy(&_parser->partialLine);
+	pp.faceNormals = faceNormals;
+	pp.smoothNormals = &smoothNormals;
+	pp.cornerNormals = cornerNormals;
+	pp.numFileNormals = _parser->normals.length;
+	const uint32_t numTempObjects = _parser->tempObjects.length;
+	pp.outputs = OBJZ_MALLOC(ctx, sizeof(ObjectOutput) * OBJZ_LARGEST(numTempObjects, 1));
+	uint32_t maxObjectFaces = 0;
+	for (uint32_t i = 0; i < numTempObjects; i++) {
+		const TempObject *tempObject = OBJZ_ARRAY_ELEMENT(_parser->tempObjects, i);
+		maxObjectFaces = OBJZ_LARGEST(maxObjectFaces, tempObject->numFaces);
+	}
+	const uint32_t numWorkers = OBJZ_LARGEST(OBJZ_SMALLEST(ctx->numThreads, numTempObjects), 1);
+	pp.workers = OBJZ_MALLOC(ctx, sizeof(ObjectWorker) * numWorkers);
+	const uint32_t numMaterialBuckets = _parser->materials.length + 1;
+	for (uint32_t i = 0; i < numWorkers; i++) {
+		ObjectWorker *worker = &pp.workers[i];
+		arenaWorkerContext(ctx, i, &worker->ctx);
+		if (_parser->generateNormals)
+			normalHashMapInit(&worker->normalHashMap, &worker->ctx, OBJZ_LARGEST(maxObjectFaces, 32), NULL); // Guess capacity.
+		worker->materialFaceCounts = OBJZ_MALLOC(ctx, sizeof(uint32_t) * numMaterialBuckets);
+		memset(worker->materialFaceCounts, 0, sizeof(uint32_t) * numMaterialBuckets);
+		worker->objectMaterials = OBJZ_MALLOC(ctx, sizeof(uint32_t) * numMaterialBuckets);
+		worker->sortedFaces = OBJZ_MALLOC(ctx, sizeof(uint32_t) * OBJZ_LARGEST(maxObjectFaces, 1));
+	}
+	runTasks(ctx, buildObject, &pp, numTempObjects, numWorkers);
+	// Worker 0 may not have started any of the last tasks.
+	if (ctx->progressFunc && pp.progress < 95) {
+		pp.progress = 95;
+		ctx->progressFunc(_parser->filename, pp.progress);
+	}
+	for (uint32_t i = 0; i < numWorkers; i++) {
+		ObjectWorker *worker = &pp.workers[i];
+		if (_parser->generateNormals)
+			normalHashMapDestroy(&worker->normalHashMap);
+		OBJZ_FREE(ctx, worker->materialFaceCounts);
+		OBJZ_FREE(ctx, worker->objectMaterials);
+		OBJZ_FREE(ctx, worker->sortedFaces);
+	}
+	if (_parser->generateNormals) {
+		OBJZ_FREE(ctx, faceNormals);
+		arrayDestroy(&smoothNormals);
+		OBJZ_FREE(ctx, cornerNormals);
+	}
+	chunkedArrayDestroy(&_parser->faces);
+	if (checkCancelled(ctx)) {
+		// The objects may be incomplete. Free them and the rest of the parse state.
+		for (uint32_t i = 0; i < numTempObjects; i++) {
+			if (!((const TempObject *)OBJZ_ARRAY_ELEMENT(_parser->tempObjects, i))->numFaces)
+				continue;
+			ObjectOutput *output = &pp.outputs[i];
+			arrayDestroy(&output->meshes);
+			arrayDestroy(&output->indices);
+			vertexHashMapDestroy(&output->vertexHashMap);
+			if (_parser->generateNormals)
+				chunkedArrayDestroy(&output->normals);
+		}
+		OBJZ_FREE(ctx, pp.outputs);
+		OBJZ_FREE(ctx, pp.workers);
+		arrayDestroy(&_parser->materials);
+		arrayDestroy(&_parser->tempObjects);
+		chunkedArrayDestroy(&_parser->positions);
+		chunkedArrayDestroy(&_parser->texcoords);
+		chunkedArrayDestroy(&_parser->normals);
+		return NULL;
+	}
+	// Stitch the objects together: prefix sums of their mesh, index and vertex counts.
+	uint32_t numMeshes = 0;
+	for (uint32_t i = 0; i < numTempObjects; i++) {
+		if (((const TempObject *)OBJZ_ARRAY_ELEMENT(_parser->tempObjects, i))->numFaces)
+			numMeshes += pp.outputs[i].meshes.length;
+	}
+	Array meshes, objects;
+	arrayInit(&meshes, ctx, sizeof(objzMesh), OBJZ_LARGEST(numMeshes, 1u)); // Exact capacity
+	arrayInit(&objects, ctx, sizeof(objzObject), numTempObjects); // Exact capacity
+	uint32_t numIndices = 0, numVertices = 0;
+	for (uint32_t i = 0; i < numTempObjects; i++) {
+		const TempObject *tempObject = OBJZ_ARRAY_ELEMENT(_parser->tempObjects, i);
+		if (!tempObject->numFaces)
+			continue;
+		ObjectOutput *output = &pp.outputs[i];
+		output->firstMesh = meshes.length;
+		output->firstIndex = numIndices;
+		output->firstVertex = numVertices;
+		objzObject object;
+		strCopy(object.name, sizeof(object.name), tempObject->name, strLength(tempObject->name, sizeof(tempObject->name)));
+		object.firstMesh = output->firstMesh;
+		object.numMeshes = output->meshes.length;
+		object.firstIndex = output->firstIndex;
+		object.numIndices = output->indices.length;
+		object.firstVertex = output->firstVertex;
+		object.numVertices = output->vertexHashMap.positions.length;
+		arrayAppend(&objects, &object);
+		for (uint32_t j = 0; j < output->meshes.length; j++) {
+			objzMesh mesh = *(const objzMesh *)OBJZ_ARRAY_ELEMENT(output->meshes, j);
+			mesh.firstIndex += output->firstIndex;
+			arrayAppend(&meshes, &mesh);
+		}
+		arrayDestroy(&output->meshes);
+		numIndices += object.numIndices;
+		numVertices += object.numVertices;
+	}
+	// Build output data structure.
+	objzModel *model = OBJZ_OUTPUT_MALLOC(ctx, sizeof(objzModel));
+	model->flags = _parser->flags;
+	// The flag records the index width, so functions given only the model can read the indices.
+	if (numVertices > UINT16_MAX + 1 || ctx->indexFormat == OBJZ_INDEX_FORMAT_U32)
+		model->flags |= OBJZ_FLAG_INDEX32;
+	pp.index32 = (model->flags & OBJZ_FLAG_INDEX32) != 0;
+	model->indices = OBJZ_OUTPUT_MALLOC(ctx, (pp.index32 ? sizeof(uint32_t) : sizeof(uint16_t)) * numIndices);
+	model->numIndices = numIndices;
+	model->materials = (objzMaterial *)arrayCopyToOutput(&_parser->materials);
+	model->numMaterials = _parser->materials.length;
+	model->meshes = (objzMesh *)arrayCopyToOutput(&meshes);
+	model->numMeshes = meshes.length;
+	model->objects = (objzObject *)arrayCopyToOutput(&objects);
+	model->numObjects = objects.length;
+	model->vertices = OBJZ_OUTPUT_MALLOC(ctx, ctx->vertexDecl.stride * numVertices);
+	model->numVertices = numVertices;
+	pp.model = model;
+	runTasks(ctx, writeObject, &pp, numTempObjects, numWorkers);
+	for (uint32_t i = 0; i < numTempObjects; i++) {
+		if (!((const TempObject *)OBJZ_ARRAY_ELEMENT(_parser->tempObjects, i))->numFaces)
+			continue;
+		ObjectOutput *output = &pp.outputs[i];
+		arrayDestroy(&output->indices);
+		vertexHashMapDestroy(&output->vertexHashMap);
+		if (_parser->generateNormals)
+			chunkedArrayDestroy(&output->normals);
+	}
+	OBJZ_FREE(ctx, pp.outputs);
+	OBJZ_FREE(ctx, pp.workers); // After the outputs: their arrays point to the worker contexts.
+	arrayDestroy(&_parser->materials);
+	arrayDestroy(&meshes);
+	arrayDestroy(&objects);
+	arrayDestroy(&_parser->tempObjects);
+	chunkedArrayDestroy(&_parser->positions);
+	chunkedArrayDestroy(&_parser->texcoords);
+	chunkedArrayDestroy(&_parser->normals);
+	if (ctx->progressFunc)
+		ctx->progressFunc(_parser->filename, 100);
+	return model;
+}
+
+// Statement counts from a quick pass over a whole file, so the parser can allocate arrays at their final size.
+// Lines are only classified by their first characters, so unusual files, e.g. with line continuations, get estimates. Arrays still grow if needed.
+typedef struct {
+	uint32_t positions, texcoords, normals;
+	uint32_t faces; // Triangles.
+	uint32_t objects; // 'o' and 'g' statements.
+} PrescanCounts;
+
+#if OBJZ_SIMD_WIDTH
+static uint32_t countBits(uint32_t _v) {
+	_v = _v - ((_v >> 1) & 0x55555555);
+	_v = (_v & 0x33333333) + ((_v >> 2) & 0x33333333);
+	return (((_v + (_v >> 4)) & 0x0f0f0f0f) * 0x01010101) >> 24;
+}
+#endif
+
+// Whitespace separated tokens in _buf to _end. Memory is readable up to _bufferEnd.
+static uint32_t countTokens(const char *_buf, const char *_end, const char *_bufferEnd) {
+	uint32_t count = 0;
+	bool inToken = false;
+#if OBJZ_SIMD_WIDTH
+	uint32_t prevSeparator = 1;
+	for (; _buf < _end && _bufferEnd - _buf >= OBJZ_SIMD_WIDTH; _buf += OBJZ_SIMD_WIDTH) {
+		const SimdBytes v = OBJZ_SIMD_LOAD(_buf);
+		const uint32_t separators = OBJZ_SIMD_EQUAL_MASK(v, ' ') | OBJZ_SIMD_EQUAL_MASK(v, '\t') | OBJZ_SIMD_EQUAL_MASK(v, '\r');
+		const uint32_t remaining = (uint32_t)OBJZ_SMALLEST(_end - _buf, OBJZ_SIMD_WIDTH);
+		const uint32_t valid = remaining < 32 ? (1u << remaining) - 1 : UINT32_MAX; // Not past the end of the line.
+		// A token starts at a non-separator that follows a separator.
+		count += countBits(~separators & ((separators << 1) | prevSeparator) & valid);
+		prevSeparator = (separators >> (OBJZ_SIMD_WIDTH - 1)) & 1;
+	}
+	inToken = !prevSeparator;
+#else
+	(void)_bufferEnd;
+#endif
+	for (; _buf < _end; _buf++) {
+		const bool separator = isWhitespaceChar(*_buf);
+		if (!separator && !inToken)
+			count++;
+		inToken = !separator;
+	}
+	return count;
+}
+
+static void prescan(const char *_buf, const char *_end, PrescanCounts *_counts) {
+	memset(_counts, 0, sizeof(*_counts));
+	while (_buf < _end) {
+		const char *newline = findNewline(_buf, _end);
+		const char *lineEnd = newline ? newline : _end;
+		while (_buf < lineEnd && isWhitespaceChar(*_buf))
+			_buf++;
+		const size_t length = (size_t)(lineEnd - _buf);
+		if (length >= 2 && isWhitespaceChar(_buf[1])) {
+			if (_buf[0] == 'v')
+				_counts->positions++;
+			else if (_buf[0] == 'f') {
+				const uint32_t corners = countTokens(_buf + 2, lineEnd, _end);
+				if (corners >= 3)
+					_counts->faces += corners - 2;
+			} else if (_buf[0] == 'o' || _buf[0] == 'g')
+				_counts->objects++;
+		} else if (length >= 3 && _buf[0] == 'v' && isWhitespaceChar(_buf[2])) {
+			if (_buf[1] == 't')
+				_counts->texcoords++;
+			else if (_buf[1] == 'n')
+				_counts->normals++;
+		}
+		_buf = lineEnd + 1;
+	}
+}
+
+static void parserReserve(objzParser *_parser, const PrescanCounts *_counts) {
+	chunkedArrayReserve(&_parser->positions, _counts->positions);
+	chunkedArrayReserve(&_parser->texcoords, _counts->texcoords);
+	chunkedArrayReserve(&_parser->normals, _counts->normals);
+	chunkedArrayReserve(&_parser->faces, _counts->faces);
+	_parser->tempObjects.initialCapacity = _counts->objects + 1;
+}
+
+static bool parseLines(objzParser *_parser, File *_file, bool _reportProgress) {
+	objzContext *ctx = _parser->ctx;
+	int progress = 50;
+	for (;;) {
+		size_t lineLength;
+		const char *line = fileReadLine(_file, &lineLength);
+		if (_reportProgress && ctx->progressFunc) {
+			const int newProgress = (int)(50.0f + (_file->pos / (float)_file->length) * 25.0f);
+			if (newProgress > progress) {
+				progress = newProgress;
+				ctx->progressFunc(_parser->filename, progress);
 			}
-			if (!alreadyLoaded) {
-				if (!loadMaterialFile(_filename, token.text, &materials))
-					goto error;
-				arrayAppend(&materialLibs, token.text);
+		}
+		if (!line)
+			break;
+		if (checkCancelled(ctx) || !parseLine(_parser, line, lineLength, _file->buffer + _file->length))
+			return false;
+	}
+	return true;
+}
+
+// Multi-threaded parsing: the file is split into ranges at line boundaries. Each range is parsed on a separate thread.
+// Vertex attributes (the bulk of most files) are parsed directly, faces are parsed to raw indices, other statements are deferred.
+// The ranges are then merged in order on the calling thread, which resolves relative indices, triangulates faces and parses the deferred statements (objects, groups, materials and smoothing groups) with the same state as a serial parse.
+#define OBJZ_MIN_PARSE_RANGE_SIZE (256 * 1024)
+
+#define OBJZ_STATEMENT_FACE 0
+#define OBJZ_STATEMENT_LINE 1 // Parsed with parseLine when merging.
+
+typedef struct {
+	uint32_t type;
+	uint32_t line; // Relative to the start of the range.
+	// OBJZ_STATEMENT_FACE
+	uint32_t firstIndex; // ParseRange rawIndices element.
+	uint32_t numIndices;
+	uint32_t numPositions, numTexcoords, numNormals; // Number of each attribute in the range before this face.
+	// OBJZ_STATEMENT_LINE
+	const char *text;
+	size_t length;
+} Statement;
+
+typedef struct {
+	objzContext ctx; // Worker copy of the load context, see arenaWorkerContext. Errors are reported by parsing the range again when merging.
+	File file;
+	Array positions, texcoords, normals;
+	Array rawIndices; // int32_t[3]
+	Array statements;
+	uint32_t numLines;
+	bool failed;
+	Thread thread;
+} ParseRange;
+
+static void parseRange(void *_data) {
+	ParseRange *range = (ParseRange *)_data;
+	objzContext *ctx = &range->ctx;
+	Lexer lexer;
+	initLexer(&lexer);
+	Token token;
+	for (;;) {
+		size_t lineLength;
+		const char *line = fileReadLine(&range->file, &lineLength);
+		if (!line)
+			break;
+		if (loadCancelled(ctx)) {
+			range->failed = true; // Parsing again to report the error stops at the first line.
+			break;
+		}
+		lexerSetLine(&lexer, line, lineLength, range->file.buffer + range->file.length);
+		tokenize(&lexer, &token, false);
+		const uint32_t keyword = lookupKeyword(&token);
+		if (keyword == OBJZ_KEYWORD_F) {
+			Statement statement;
+			statement.type = OBJZ_STATEMENT_FACE;
+			statement.line = lexer.line;
+			statement.firstIndex = range->rawIndices.length;
+			if (!parseFace(ctx, &lexer, &token, &range->rawIndices)) {
+				range->failed = true;
+				break;
 			}
-		} else if (OBJZ_STRICMP(token.text, "s") == 0) {
-			tokenize(&lexer, &token, false);
-			if (token.text[0] == 0) {
-				appendError("(%u:%u) Expected value after 's'", token.line, token.column);
-				goto error;
+			statement.numIndices = range->rawIndices.length - statement.firstIndex;
+			statement.numPositions = range->positions.length;
+			statement.numTexcoords = range->texcoords.length;
+			statement.numNormals = range->normals.length;
+			arrayAppend(&range->statements, &statement);
+		} else if (keyword == OBJZ_KEYWORD_V || keyword == OBJZ_KEYWORD_VN || keyword == OBJZ_KEYWORD_VT) {
+			Array *attribs = &range->positions;
+			if (keyword == OBJZ_KEYWORD_VN)
+				attribs = &range->normals;
+			else if (keyword == OBJZ_KEYWORD_VT)
+				attribs = &range->texcoords;
+			float value[3];
+			if (!parseFloats(ctx, &lexer, value, attribs->elementSize / sizeof(float))) {
+				range->failed = true;
+				break;
 			}
-			if (OBJZ_STRICMP(token.text, "off") == 0)
-				currentSmoothingGroup = 0;
-			else
-				currentSmoothingGroup = (uint16_t)atoi(token.text);
-		} else if (OBJZ_STRICMP(token.text, "usemtl") == 0) {
-			tokenize(&lexer, &token, false);
-			if (token.text[0] == 0) {
-				appendError("(%u:%u) Expected name after 'usemtl'", token.line, token.column);
-				goto error;
+			arrayAppend(attribs, value);
+		} else if (keyword == OBJZ_KEYWORD_G || keyword == OBJZ_KEYWORD_O || keyword == OBJZ_KEYWORD_MTLLIB || keyword == OBJZ_KEYWORD_S || keyword == OBJZ_KEYWORD_USEMTL) {
+			Statement statement;
+			statement.type = OBJZ_STATEMENT_LINE;
+			statement.line = lexer.line;
+			statement.text = line;
+			statement.length = lineLength;
+			arrayAppend(&range->statements, &statement);
+		}
+	}
+	range->numLines = lexer.line;
+}
+
+static bool parseRanges(objzParser *_parser, File *_file, uint32_t _numRanges) {
+	objzContext *ctx = _parser->ctx;
+	// Parse the statements before the first vertex or face now: usually 'mtllib', so material libraries load while the ranges are parsed.
+	Lexer lexer;
+	initLexer(&lexer);
+	Token token;
+	for (;;) {
+		const size_t lineStart = _file->pos;
+		size_t lineLength;
+		const char *line = fileReadLine(_file, &lineLength);
+		if (!line)
+			return true;
+		lexerSetLine(&lexer, line, lineLength, _file->buffer + _file->length);
+		tokenize(&lexer, &token, false);
+		const uint32_t keyword = lookupKeyword(&token);
+		if (keyword == OBJZ_KEYWORD_F || keyword == OBJZ_KEYWORD_V || keyword == OBJZ_KEYWORD_VN || keyword == OBJZ_KEYWORD_VT) {
+			_file->pos = lineStart;
+			break;
+		}
+		if (!parseLine(_parser, line, lineLength, _file->buffer + _file->length))
+			return false;
+	}
+	ParseRange *ranges = OBJZ_MALLOC(ctx, sizeof(ParseRange) * _numRanges);
+	// Split the rest into ranges of roughly equal size, ending after a newline.
+	const char *bufferEnd = _file->buffer + _file->length;
+	const char *rangesStart = _file->buffer + _file->pos;
+	const char *start = rangesStart;
+	uint32_t numRanges = 0;
+	for (uint32_t i = 0; i < _numRanges && start < bufferEnd; i++) {
+		const char *end = bufferEnd;
+		if (i + 1 < _numRanges) {
+			end = OBJZ_LARGEST(start, rangesStart + (size_t)(bufferEnd - rangesStart) / _numRanges * (i + 1));
+			const char *newline = findNewline(end, bufferEnd);
+			end = newline ? newline + 1 : bufferEnd;
+		}
+		ParseRange *range = &ranges[numRanges];
+		arenaWorkerContext(ctx, numRanges++, &range->ctx);
+		range->ctx.progressFunc = NULL;
+		fileOpenMemory(&range->file, start, (size_t)(end - start));
+		arrayInit(&range->positions, &range->ctx, sizeof(float) * 3, 1024);
+		arrayInit(&range->texcoords, &range->ctx, sizeof(float) * 2, 1024);
+		arrayInit(&range->normals, &range->ctx, sizeof(float) * 3, 1024);
+		arrayInit(&range->rawIndices, &range->ctx, sizeof(int32_t) * 3, 1024);
+		arrayInit(&range->statements, &range->ctx, sizeof(Statement), 1024);
+		range->numLines = 0;
+		range->failed = false;
+		start = end;
+	}
+	// The last range is parsed on this thread.
+	for (uint32_t i = 0; i + 1 < numRanges; i++)
+		threadStart(&ranges[i].thread, parseRange, &ranges[i]);
+	parseRange(&ranges[numRanges - 1]);
+	for (uint32_t i = 0; i + 1 < numRanges; i++)
+		threadJoin(&ranges[i].thread);
+	bool result = true;
+	uint32_t lineOffset = _parser->lexer.line;
+	uint32_t i;
+	for (i = 0; i < numRanges && result; i++) {
+		const ParseRange *range = &ranges[i];
+		if (range->failed)
+			break;
+		const uint32_t firstPosition = _parser->positions.length;
+		const uint32_t firstTexcoord = _parser->texcoords.length;
+		const uint32_t firstNormal = _parser->normals.length;
+		chunkedArrayAppendMany(&_parser->positions, range->positions.data, range->positions.length);
+		chunkedArrayAppendMany(&_parser->texcoords, range->texcoords.data, range->texcoords.length);
+		chunkedArrayAppendMany(&_parser->normals, range->normals.data, range->normals.length);
+		if (range->texcoords.length > 0)
+			_parser->flags |= OBJZ_FLAG_TEXCOORDS;
+		if (range->normals.length > 0)
+			_parser->flags |= OBJZ_FLAG_NORMALS;
+		for (uint32_t j = 0; j < range->statements.length; j++) {
+			if ((j & 4095) == 0 && checkCancelled(ctx)) {
+				result = false;
+				break;
 			}
-			currentMaterialIndex = -1;
-			for (uint32_t i = 0; i < materials.length; i++) {
-				const objzMaterial *mat = OBJZ_ARRAY_ELEMENT(materials, i);
-				if (OBJZ_STRICMP(mat->name, token.text) == 0) {
-					currentMaterialIndex = (int)i;
+			const Statement *statement = OBJZ_ARRAY_ELEMENT(range->statements, j);
+			if (statement->type == OBJZ_STATEMENT_FACE) {
+				const int32_t *rawIndices = OBJZ_ARRAY_ELEMENT(range->rawIndices, statement->firstIndex);
+				parserSetFaceIndices(_parser, rawIndices, statement->numIndices, firstPosition + statement->numPositions, firstTexcoord + statement->numTexcoords, firstNormal + statement->numNormals);
+				parserAddFace(_parser);
+			} else {
+				_parser->lexer.line = lineOffset + statement->line - 1;
+				if (!parseLine(_parser, statement->text, statement->length, statement->text + statement->length)) {
+					result = false;
 					break;
 				}
 			}
-		} else if (OBJZ_STRICMP(token.text, "v") == 0) {
-			float pos[3];
-			if (!parseFloats(&lexer, pos, 3))
-				goto error;
-			chunkedArrayAppend(&positions, pos);
-		} else if (OBJZ_STRICMP(token.text, "vn") == 0) {
-			float normal[3];
-			if (!parseFloats(&lexer, normal, 3))
-				goto error;
-			chunkedArrayAppend(&normals, normal);
-			flags |= OBJZ_FLAG_NORMALS;
-		} else if (OBJZ_STRICMP(token.text, "vt") == 0) {
-			float texcoord[2];
-			if (!parseFloats(&lexer, texcoord, 2))
-				goto error;
-			chunkedArrayAppend(&texcoords, texcoord);
-			flags |= OBJZ_FLAG_TEXCOORDS;
-		}
-	}
-	if (normals.length == 0)
-		generateNormals = true;
-	arrayDestroy(&materialLibs);
-	arrayDestroy(&faceIndices);
-	arrayDestroy(&tempFaceIndices);
-	fileClose(&file);
-	if (s_progress) {
-		progress = 75;
-		s_progress(_filename, progress);
-	}
-	// Do some post-processing of parsed data:
-	//   * generate normals
-	//   * find unique vertices from separately index vertex attributes (pos, texcoord, normal).
-	//   * build meshes by batching object faces by material
-	Array faceNormals;
-	arrayInit(&faceNormals, sizeof(vec3), faces.length); // Exact capacity
-	if (generateNormals) {
-		for (uint32_t i = 0; i < tempObjects.length; i++) {
-			const TempObject *tempObject = OBJZ_ARRAY_ELEMENT(tempObjects, i);
-			for (uint32_t j = 0; j < tempObject->numFaces; j++) {
-				const Face *face = chunkedArrayElement(&faces, tempObject->firstFace + j);
-				vec3 edge0, edge1;
-				vec3 normal;
-				const vec3 *p0 = chunkedArrayElement(&positions, face->indices[0].v);
-				const vec3 *p1 =  chunkedArrayElement(&positions, face->indices[1].v);
-				const vec3 *p2 = chunkedArrayElement(&positions, face->indices[2].v);
-				OBJZ_VEC3_SUB(edge0, *p1, *p0);
-				OBJZ_VEC3_SUB(edge1, *p2, *p0);
-				OBJZ_VEC3_CROSS(normal, edge0, edge1);
-				vec3Normalize(&normal, &normal);
-				arrayAppend(&faceNormals, &normal);
-			}
 		}
+		lineOffset += range->numLines;
 	}
-	Array meshes, objects, indices;
-	arrayInit(&meshes, sizeof(objzMesh), tempObjects.length * 4); // Guess capacity: 4 meshes per object
-	arrayInit(&objects, sizeof(objzObject), tempObjects.length); // Exact capacity
-	arrayInit(&indices, sizeof(uint32_t), faces.length * 3); // Exact capacity
-	VertexHashMap vertexHashMap;
-	vertexHashMapInit(&vertexHashMap, positions.length * 2); // Guess capacity
-	NormalHashMap normalHashMap; // Re-used for each object.
-	if (generateNormals) {
-		uint32_t maxObjectFaces = 0;
-		for (uint32_t i = 0; i < tempObjects.length; i++) {
-			const TempObject *tempObject = OBJZ_ARRAY_ELEMENT(tempObjects, i);
-			maxObjectFaces = OBJZ_LARGEST(maxObjectFaces, tempObject->numFaces);
-		}
-		normalHashMapInit(&normalHashMap, OBJZ_LARGEST(maxObjectFaces, 32), &normals); // Guess capacity.
-	}
-	for (uint32_t i = 0; i < tempObjects.length; i++) {
-		if (s_progress) {
-			const int newProgress = (int)(75.0f + (i / (float)tempObjects.length) * 25.0f);
-			if (newProgress > progress) {
-				progress = newProgress;
-				s_progress(_filename, progress);
-			}
+	if (result && i < numRanges) {
+		// Parse from the start of the range that failed to report the error.
+		File remaining;
+		fileOpenMemory(&remaining, ranges[i].file.buffer, (size_t)(bufferEnd - ranges[i].file.buffer));
+		_parser->lexer.line = lineOffset;
+		result = parseLines(_parser, &remaining, false);
+	}
+	for (i = 0; i < numRanges; i++) {
+		arrayDestroy(&ranges[i].positions);
+		arrayDestroy(&ranges[i].texcoords);
+		arrayDestroy(&ranges[i].normals);
+		arrayDestroy(&ranges[i].rawIndices);
+		arrayDestroy(&ranges[i].statements);
+	}
+	OBJZ_FREE(ctx, ranges);
+	return result;
+}
+
+// Closes _file.
+static objzModel *loadModel(objzContext *_ctx, File *_file, const char *_filename, objzMtllibResolveFunc _resolve, void *_userData) {
+	if (_ctx->progressFunc)
+		_ctx->progressFunc(_filename, 50);
+	if (!fileCheckEncoding(_ctx, _file, _filename)) {
+		fileClose(_ctx, _file);
+		return NULL;
+	}
+	objzParser parser;
+	parserInit(&parser, _ctx, _filename, _resolve, _userData);
+	if (OBJZ_PRESCAN) {
+		PrescanCounts counts;
+		prescan(_file->buffer, _file->buffer + _file->length, &counts);
+		parserReserve(&parser, &counts);
+	}
+	const uint32_t numRanges = OBJZ_THREADS ? (uint32_t)OBJZ_SMALLEST(_ctx->numThreads, _file->length / OBJZ_MIN_PARSE_RANGE_SIZE) : 1;
+	const bool result = numRanges > 1 ? parseRanges(&parser, _file, numRanges) : parseLines(&parser, _file, true);
+	fileClose(_ctx, _file);
+	if (!result) {
+		parserDestroy(&parser);
+		return NULL;
+	}
+	return parserFinish(&parser);
+}
+
+objzParser *objz_createParser(const char *_filename, objzMtllibResolveFunc _resolve, void *_userData) {
+	return objz_createParserEx(&s_defaultContext, _filename, _resolve, _userData);
+}
+
+objzParser *objz_createParserEx(objzContext *_ctx, const char *_filename, objzMtllibResolveFunc _resolve, void *_userData) {
+	_ctx->error[0] = 0;
+	if (!_filename) {
+		_filename = "<stream>";
+		if (!_resolve)
+			_resolve = nullMtllibResolve;
+	}
+	// Copy the filename, the parser may outlive it.
+	arenaBeginLoad(_ctx); // Ended by objz_parserFinish or objz_destroyParser.
+	const size_t filenameSize = strlen(_filename) + 1;
+	objzParser *parser = OBJZ_MALLOC(_ctx, sizeof(objzParser) + filenameSize);
+	char *filename = (char *)(parser + 1);
+	memcpy(filename, _filename, filenameSize);
+	parserInit(parser, _ctx, filename, _resolve, _userData);
+	if (_ctx->progressFunc)
+		_ctx->progressFunc(filename, 0);
+	return parser;
+}
+
+void objz_destroyParser(objzParser *_parser) {
+	if (!_parser)
+		return;
+	objzContext *ctx = _parser->ctx;
+	parserDestroy(_parser);
+	OBJZ_FREE(ctx, _parser);
+	arenaEndLoad(ctx);
+}
+
+bool objz_parserFeed(objzParser *_parser, const void *_data, size_t _size) {
+	if (_parser->failed)
+		return false;
+	const char *data = (const char *)_data;
+	const char *end = data + _size;
+	if (!_parser->checkedEncoding && _size > 0) {
+		File file;
+		fileOpenMemory(&file, data, _size);
+		if (!fileCheckEncoding(_parser->ctx, &file, _parser->filename)) {
+			_parser->failed = true;
+			return false;
 		}
-		const TempObject *tempObject = OBJZ_ARRAY_ELEMENT(tempObjects, i);
-		if (!tempObject->numFaces)
+		_parser->checkedEncoding = true;
+	}
+	while (data < end) {
+		const char *newline = findNewline(data, end);
+		if (!newline) {
+			// Incomplete line: keep it until the next chunk or objz_parserFinish.
+			for (; data < end; data++)
+				arrayAppend(&_parser->partialLine, data);
+			break;
+		}
+		const char *line = data;
+		size_t length = (size_t)(newline - data);
+		const char *bufferEnd = end;
+		data = newline + 1;
+		if (_parser->partialLine.length > 0) {
+			for (size_t i = 0; i < length; i++)
+				arrayAppend(&_parser->partialLine, &line[i]);
+			line = (const char *)_parser->partialLine.data;
+			length = _parser->partialLine.length;
+			bufferEnd = line + length;
+		}
+		if (length > 0 && line[length - 1] == '\r')
+			length--;
+		const bool result = parseLine(_parser, line, length, bufferEnd);
+		_parser->partialLine.length = 0;
+		if (!result) {
+			_parser->failed = true;
+			return false;
+		}
+	}
+	return true;
+}
+
+objzModel *objz_parserFinish(objzParser *_parser) {
+	if (!_parser->failed) {
+		const char *line = (const char *)_parser->partialLine.data;
+		size_t length = _parser->partialLine.length;
+		if (length > 0 && line[length - 1] == '\r')
+			length--;
+		if (length == 0 || parseLine(_parser, line, length, line + length)) {
+			objzContext *ctx = _parser->ctx;
+			objzModel *model = parserFinish(_parser);
+			OBJZ_FREE(ctx, _parser);
+			arenaEndLoad(ctx);
+			return model;
+		}
+	}
+	objz_destroyParser(_parser);
+	return NULL;
+}
+
+// Post-transform vertex cache optimization, with Tipsify: Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", 2007.
+// Objects are independent, so they are optimized in parallel. Triangles are only reordered within their mesh, and keep their winding.
+typedef struct {
+	uint32_t *indices; // The object's indices, relative to its first vertex.
+	uint32_t *offsets; // Vertex to triangle adjacency, compressed sparse row.
+	uint32_t *adjacentTriangles;
+	uint32_t *liveTriangles; // Per vertex: triangles of the current mesh not yet emitted.
+	uint32_t *cacheTimes; // Per vertex: when it last entered the cache.
+	uint8_t *emitted; // Per triangle.
+	uint32_t *deadEnds; // Stack of emitted vertices.
+	Array candidates; // uint32_t, vertices of the last fan.
+	objzContext ctx; // For candidates, see arenaWorkerContext.
+} VertexCacheWorker;
+
+typedef struct {
+	objzModel *model;
+	bool index32;
+	uint32_t cacheSize;
+	VertexCacheWorker *workers;
+} VertexCacheOptimizer;
+
+static uint32_t modelIndex(const objzModel *_model, bool _index32, uint32_t _i) {
+	return _index32 ? ((const uint32_t *)_model->indices)[_i] : ((const uint16_t *)_model->indices)[_i];
+}
+
+// The next vertex to fan around: the one from the last fan that will still be in the cache and has the most triangles left. Otherwise the most recent vertex with triangles left, or the next one in the mesh.
+static int64_t tipsifyNextVertex(VertexCacheWorker *_worker, uint32_t _time, uint32_t _cacheSize, uint32_t *_numDeadEnds, uint32_t *_cursor, uint32_t _end) {
+	int64_t best = -1;
+	uint32_t bestPriority = 0;
+	for (uint32_t i = 0; i < _worker->candidates.length; i++) {
+		const uint32_t v = *(const uint32_t *)OBJZ_ARRAY_ELEMENT(_worker->candidates, i);
+		if (!_worker->liveTriangles[v])
 			continue;
-		objzObject object;
-		strCopy(object.name, sizeof(object.name), tempObject->name, strLength(tempObject->name, sizeof(tempObject->name)));
-		if (generateNormals)
-			normalHashMapClear(&normalHashMap);
-		// Create one mesh per material. No material (-1) gets a mesh too.
-		object.firstMesh = meshes.length;
-		object.numMeshes = 0;
-		for (int32_t material = -1; material < (int32_t)materials.length; material++) {
-			objzMesh mesh;
-			mesh.firstIndex = indices.length;
-			mesh.numIndices = 0;
-			mesh.materialIndex = material;
-			for (uint32_t j = 0; j < tempObject->numFaces; j++) {
-				const Face *face = chunkedArrayElement(&faces, tempObject->firstFace + j);
-				if (face->materialIndex != (int16_t)material)
+		uint32_t priority = 0;
+		if (_time - _worker->cacheTimes[v] + 2 * _worker->liveTriangles[v] <= _cacheSize)
+			priority = _time - _worker->cacheTimes[v];
+		if (best < 0 || priority > bestPriority) {
+			best = v;
+			bestPriority = priority;
+		}
+	}
+	if (best >= 0)
+		return best;
+	while (*_numDeadEnds > 0) {
+		const uint32_t v = _worker->deadEnds[--(*_numDeadEnds)];
+		if (_worker->liveTriangles[v])
+			return v;
+	}
+	while (*_cursor < _end) {
+		const uint32_t v = _worker->indices[(*_cursor)++];
+		if (_worker->liveTriangles[v])
+			return v;
+	}
+	return -1;
+}
+
+// Task: reorder the triangles of one object's meshes.
+static void optimizeObjectVertexCache(TaskPool *_pool, uint32_t _task, uint32_t _worker) {
+	VertexCacheOptimizer *optimizer = (VertexCacheOptimizer *)_pool->data;
+	VertexCacheWorker *worker = &optimizer->workers[_worker];
+	objzModel *model = optimizer->model;
+	const objzObject *object = &model->objects[_task];
+	const uint32_t numTriangles = object->numIndices / 3;
+	for (uint32_t i = 0; i < numTriangles * 3; i++) {
+		const uint32_t index = modelIndex(model, optimizer->index32, object->firstIndex + i);
+		if (index < object->firstVertex || index - object->firstVertex >= object->numVertices)
+			return; // Not a valid object, leave it as it is.
+		worker->indices[i] = index - object->firstVertex;
+	}
+	memset(worker->offsets, 0, sizeof(uint32_t) * (object->numVertices + 1));
+	for (uint32_t i = 0; i < numTriangles * 3; i++)
+		worker->offsets[worker->indices[i] + 1]++;
+	for (uint32_t i = 0; i < object->numVertices; i++)
+		worker->offsets[i + 1] += worker->offsets[i];
+	for (uint32_t i = 0; i < numTriangles * 3; i++)
+		worker->adjacentTriangles[worker->offsets[worker->indices[i]]++] = i / 3;
+	// Filling advanced each offset to the next vertex's, shift them back.
+	for (uint32_t i = object->numVertices; i > 0; i--)
+		worker->offsets[i] = worker->offsets[i - 1];
+	worker->offsets[0] = 0;
+	memset(worker->liveTriangles, 0, sizeof(uint32_t) * object->numVertices);
+	memset(worker->cacheTimes, 0, sizeof(uint32_t) * object->numVertices);
+	memset(worker->emitted, 0, numTriangles);
+	const uint32_t cacheSize = optimizer->cacheSize;
+	uint32_t time = 0;
+	for (uint32_t m = 0; m < object->numMeshes; m++) {
+		const objzMesh *mesh = &model->meshes[object->firstMesh + m];
+		if (mesh->firstIndex < object->firstIndex)
+			continue;
+		const uint32_t first = mesh->firstIndex - object->firstIndex, end = first + mesh->numIndices / 3 * 3;
+		if (end > numTriangles * 3)
+			continue;
+		for (uint32_t i = first; i < end; i++)
+			worker->liveTriangles[worker->indices[i]]++;
+		// Each mesh is drawn separately, it starts with an empty cache.
+		time += cacheSize + 1;
+		uint32_t numDeadEnds = 0, cursor = first, numOutput = 0;
+		uint32_t *output = worker->deadEnds + (end - first); // After the dead end stack, which is never larger than the mesh.
+		int64_t fan = first < end ? (int64_t)worker->indices[first] : -1;
+		while (fan >= 0) {
+			worker->candidates.length = 0;
+			for (uint32_t i = worker->offsets[fan]; i < worker->offsets[fan + 1]; i++) {
+				const uint32_t t = worker->adjacentTriangles[i];
+				if (t < first / 3 || t >= end / 3 || worker->emitted[t])
 					continue;
-				uint32_t faceNormalIndex = UINT32_MAX;
-				if (generateNormals && face->smoothingGroup == 0) {
-					for (int k = 0; k < 3; k++) {
-						if (face->indices[k].vn >= normals.length) {
-							faceNormalIndex = normalHashMapInsert(&normalHashMap, OBJZ_ARRAY_ELEMENT(faceNormals, tempObject->firstFace + j));
-							break;
-						}
-					}
-				}
-				for (int k = 0; k < 3; k++) {
-					const IndexTriplet *triplet = &face->indices[k];
-					uint32_t vn = triplet->vn;
-					if (generateNormals) {
-						if (face->smoothingGroup > 0) {
-							vec3 normal = calculateSmoothNormal(triplet->v, &faces, &faceNormals, face->smoothingGroup);
-							vn = normalHashMapInsert(&normalHashMap, &normal);
-						} else if (faceNormalIndex != UINT32_MAX)
-							vn = faceNormalIndex;
-					}
-					const uint32_t index = vertexHashMapInsert(&vertexHashMap, i, triplet->v, triplet->vt, vn);
-					if (index > UINT16_MAX)
-						flags |= OBJZ_FLAG_INDEX32;
-					arrayAppend(&indices, &index);
-					mesh.numIndices++;
+				for (int j = 0; j < 3; j++) {
+					const uint32_t v = worker->indices[t * 3 + j];
+					output[numOutput++] = v;
+					worker->deadEnds[numDeadEnds++] = v;
+					arrayAppend(&worker->candidates, &v);
+					worker->liveTriangles[v]--;
+					if (time - worker->cacheTimes[v] > cacheSize)
+						worker->cacheTimes[v] = time++;
 				}
+				worker->emitted[t] = 1;
 			}
-			if (mesh.numIndices > 0) {
-				arrayAppend(&meshes, &mesh);
-				object.numMeshes++;
-			}
+			fan = tipsifyNextVertex(worker, time, cacheSize, &numDeadEnds, &cursor, end);
 		}
-		if (objects.length > 0) {
-			const objzObject *prev = OBJZ_ARRAY_ELEMENT(objects, objects.length - 1);
-			object.firstIndex = prev->firstIndex + prev->numIndices;
-			object.firstVertex = prev->firstVertex + prev->numVertices;
-		} else {
-			object.firstIndex = 0;
-			object.firstVertex = 0;
+		for (uint32_t i = 0; i < numOutput; i++) {
+			const uint32_t index = object->firstVertex + output[i];
+			if (optimizer->index32)
+				((uint32_t *)model->indices)[mesh->firstIndex + i] = index;
+			else
+				((uint16_t *)model->indices)[mesh->firstIndex + i] = (uint16_t)index;
 		}
-		object.numIndices = indices.length - object.firstIndex;
-		object.numVertices = vertexHashMap.vertices.length - object.firstVertex;
-		arrayAppend(&objects, &object);
 	}
-	if (generateNormals)
-		normalHashMapDestroy(&normalHashMap);
-	arrayDestroy(&tempObjects);
-	chunkedArrayDestroy(&faces);
-	arrayDestroy(&faceNormals);
-	// Build output data structure.
-	objzModel *model = OBJZ_MALLOC(sizeof(objzModel));
-	model->flags = flags;
-	if (s_indexFormat == OBJZ_INDEX_FORMAT_U32 || (flags & OBJZ_FLAG_INDEX32))
-		model->indices = indices.data;
-	else {
-		flags &= ~OBJZ_FLAG_INDEX32;
-		model->indices = OBJZ_MALLOC(sizeof(uint16_t) * indices.length);
-		for (uint32_t i = 0; i < indices.length; i++) {
-			uint32_t *index = (uint32_t *)OBJZ_ARRAY_ELEMENT(indices, i);
-			((uint16_t *)model->indices)[i] = (uint16_t)*index;
-		}
-		arrayDestroy(&indices);
-	}
-	model->numIndices = indices.length;
-	model->materials = (objzMaterial *)materials.data;
-	model->numMaterials = materials.length;
-	model->meshes = (objzMesh *)meshes.data;
-	model->numMeshes = meshes.length;
-	model->objects = (objzObject *)objects.data;
-	model->numObjects = objects.length;
-	model->vertices = OBJZ_MALLOC(s_vertexDecl.stride * vertexHashMap.vertices.length);
-	for (uint32_t i = 0; i < vertexHashMap.vertices.length; i++) {
-		uint8_t *vOut = &((uint8_t *)model->vertices)[i * s_vertexDecl.stride];
-		const HashedVertex *vIn = OBJZ_ARRAY_ELEMENT(vertexHashMap.vertices, i);
-		if (s_vertexDecl.positionOffset != SIZE_MAX)
-			memcpy(&vOut[s_vertexDecl.positionOffset], chunkedArrayElement(&positions, vIn->pos), sizeof(float) * 3);
-		if (s_vertexDecl.texcoordOffset != SIZE_MAX) {
-			if (vIn->texcoord == UINT32_MAX)
-				memset(&vOut[s_vertexDecl.texcoordOffset], 0, sizeof(float) * 2);
-			else
-				memcpy(&vOut[s_vertexDecl.texcoordOffset], chunkedArrayElement(&texcoords, vIn->texcoord), sizeof(float) * 2);
+}
+
+void objz_optimizeVertexCache(objzModel *_model, uint32_t _cacheSize) {
+	objz_optimizeVertexCacheEx(&s_defaultContext, _model, _cacheSize);
+}
+
+void objz_optimizeVertexCacheEx(objzContext *_ctx, objzModel *_model, uint32_t _cacheSize) {
+	uint32_t maxVertices = 0, maxIndices = 0;
+	for (uint32_t i = 0; i < _model->numObjects; i++) {
+		maxVertices = OBJZ_LARGEST(maxVertices, _model->objects[i].numVertices);
+		maxIndices = OBJZ_LARGEST(maxIndices, _model->objects[i].numIndices);
+	}
+	if (!maxIndices || !_cacheSize)
+		return;
+	arenaBeginLoad(_ctx);
+	VertexCacheOptimizer optimizer;
+	optimizer.model = _model;
+	optimizer.index32 = (_model->flags & OBJZ_FLAG_INDEX32) != 0;
+	optimizer.cacheSize = _cacheSize;
+	const uint32_t numWorkers = OBJZ_LARGEST(OBJZ_SMALLEST(_ctx->numThreads, _model->numObjects), 1);
+	optimizer.workers = OBJZ_MALLOC(_ctx, sizeof(VertexCacheWorker) * numWorkers);
+	for (uint32_t i = 0; i < numWorkers; i++) {
+		VertexCacheWorker *worker = &optimizer.workers[i];
+		worker->indices = OBJZ_MALLOC(_ctx, sizeof(uint32_t) * maxIndices);
+		worker->offsets = OBJZ_MALLOC(_ctx, sizeof(uint32_t) * (maxVertices + 1));
+		worker->adjacentTriangles = OBJZ_MALLOC(_ctx, sizeof(uint32_t) * maxIndices);
+		worker->liveTriangles = OBJZ_MALLOC(_ctx, sizeof(uint32_t) * OBJZ_LARGEST(maxVertices, 1));
+		worker->cacheTimes = OBJZ_MALLOC(_ctx, sizeof(uint32_t) * OBJZ_LARGEST(maxVertices, 1));
+		worker->emitted = OBJZ_MALLOC(_ctx, maxIndices / 3 + 1);
+		worker->deadEnds = OBJZ_MALLOC(_ctx, sizeof(uint32_t) * maxIndices * 2); // And the output.
+		arenaWorkerContext(_ctx, i, &worker->ctx);
+		arrayInit(&worker->candidates, &worker->ctx, sizeof(uint32_t), 64);
+	}
+	runTasks(_ctx, optimizeObjectVertexCache, &optimizer, _model->numObjects, numWorkers);
+	for (uint32_t i = 0; i < numWorkers; i++) {
+		VertexCacheWorker *worker = &optimizer.workers[i];
+		arrayDestroy(&worker->candidates);
+		OBJZ_FREE(_ctx, worker->deadEnds);
+		OBJZ_FREE(_ctx, worker->emitted);
+		OBJZ_FREE(_ctx, worker->cacheTimes);
+		OBJZ_FREE(_ctx, worker->liveTriangles);
+		OBJZ_FREE(_ctx, worker->adjacentTriangles);
+		OBJZ_FREE(_ctx, worker->offsets);
+		OBJZ_FREE(_ctx, worker->indices);
+	}
+	OBJZ_FREE(_ctx, optimizer.workers);
+	arenaEndLoad(_ctx);
+}
+
+float objz_getACMR(const objzModel *_model, uint32_t _cacheSize) {
+	return objz_getACMREx(&s_defaultContext, _model, _cacheSize);
+}
+
+// Simulates a FIFO cache: a vertex is in the cache if fewer than _cacheSize misses happened since it was added.
+float objz_getACMREx(objzContext *_ctx, const objzModel *_model, uint32_t _cacheSize) {
+	if (_model->numIndices < 3)
+		return 0.0f;
+	const bool index32 = (_model->flags & OBJZ_FLAG_INDEX32) != 0;
+	arenaBeginLoad(_ctx);
+	uint32_t *addedAt = OBJZ_MALLOC(_ctx, sizeof(uint32_t) * OBJZ_LARGEST(_model->numVertices, 1));
+	memset(addedAt, 0, sizeof(uint32_t) * _model->numVertices);
+	uint32_t misses = 0, numTriangles = 0, time = 0;
+	for (uint32_t m = 0; m < _model->numMeshes; m++) {
+		const objzMesh *mesh = &_model->meshes[m];
+		// Each mesh is drawn separately, it starts with an empty cache.
+		time += _cacheSize + 1;
+		for (uint32_t i = 0; i < mesh->numIndices / 3 * 3; i++) {
+			const uint32_t v = modelIndex(_model, index32, mesh->firstIndex + i);
+			if (v < _model->numVertices && time - addedAt[v] > _cacheSize) {
+				addedAt[v] = time++;
+				misses++;
+			}
 		}
-		if (s_vertexDecl.normalOffset != SIZE_MAX) {
-			if (vIn->normal == UINT32_MAX)
-				memset(&vOut[s_vertexDecl.normalOffset], 0, sizeof(float) * 3);
-			else
-			memcpy(&vOut[s_vertexDecl.normalOffset], chunkedArrayElement(&normals, vIn->normal), sizeof(float) * 3);
+		numTriangles += mesh->numIndices / 3;
+	}
+	OBJZ_FREE(_ctx, addedAt);
+	arenaEndLoad(_ctx);
+	return numTriangles ? misses / (float)numTriangles : 0.0f;
+}
+
+#define OBJZ_CACHE_MAGIC     0x5A4A424F // "OBJZ"; a cache written on a machine with different endianness doesn't match.
+#define OBJZ_CACHE_VERSION   2
+#define OBJZ_CACHE_ALIGNMENT 64
+
+#define OBJZ_CACHE_SECTION_INDICES   0
+#define OBJZ_CACHE_SECTION_MATERIALS 1
+#define OBJZ_CACHE_SECTION_MESHES    2
+#define OBJZ_CACHE_SECTION_OBJECTS   3
+#define OBJZ_CACHE_SECTION_VERTICES  4
+#define OBJZ_CACHE_NUM_SECTIONS      5
+
+// The start of a cache file. Each section (the objzModel arrays) follows at an OBJZ_CACHE_ALIGNMENT aligned offset, in the same layout as in memory.
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t fileSize;
+	uint64_t sourceSize, sourceModifiedTime, sourceHash; // All 0 if saved without a source file.
+	uint64_t vertexStride, positionOffset, texcoordOffset, normalOffset; // UINT64_MAX if not used.
+	uint32_t indexFormat; // Of the context that saved it, checked by objz_loadCache. The index width is OBJZ_FLAG_INDEX32 in flags.
+	uint32_t flags; // objzModel flags.
+	uint32_t numIndices, numMaterials, numMeshes, numObjects, numVertices;
+	uint32_t padding;
+	uint64_t sections[OBJZ_CACHE_NUM_SECTIONS]; // File offsets.
+} CacheHeader;
+
+// A model loaded from a cache: the arrays point into the file.
+typedef struct {
+	objzModel model; // First: objz_destroy gets a pointer to this.
+	File file;
+} CachedModel;
+
+static uint64_t cacheAlign(uint64_t _offset) {
+	return (_offset + OBJZ_CACHE_ALIGNMENT - 1) & ~(uint64_t)(OBJZ_CACHE_ALIGNMENT - 1);
+}
+
+static uint64_t cacheOffset(size_t _offset) {
+	return _offset == SIZE_MAX ? UINT64_MAX : (uint64_t)_offset;
+}
+
+static void cacheSectionSizes(const CacheHeader *_header, uint64_t *_sizes) {
+	const bool index32 = (_header->flags & OBJZ_FLAG_INDEX32) != 0;
+	_sizes[OBJZ_CACHE_SECTION_INDICES] = (uint64_t)_header->numIndices * (index32 ? sizeof(uint32_t) : sizeof(uint16_t));
+	_sizes[OBJZ_CACHE_SECTION_MATERIALS] = (uint64_t)_header->numMaterials * sizeof(objzMaterial);
+	_sizes[OBJZ_CACHE_SECTION_MESHES] = (uint64_t)_header->numMeshes * sizeof(objzMesh);
+	_sizes[OBJZ_CACHE_SECTION_OBJECTS] = (uint64_t)_header->numObjects * sizeof(objzObject);
+	_sizes[OBJZ_CACHE_SECTION_VERTICES] = (uint64_t)_header->numVertices * _header->vertexStride;
+}
+
+// Set the section offsets and file size from the counts.
+static void cacheLayout(CacheHeader *_header) {
+	uint64_t sizes[OBJZ_CACHE_NUM_SECTIONS];
+	cacheSectionSizes(_header, sizes);
+	uint64_t offset = cacheAlign(sizeof(CacheHeader));
+	for (uint32_t i = 0; i < OBJZ_CACHE_NUM_SECTIONS; i++) {
+		_header->sections[i] = offset;
+		offset = cacheAlign(offset + sizes[i]);
+	}
+	_header->fileSize = offset;
+}
+
+// Only the counts in the header are trusted: the section offsets and file size must match the layout they imply.
+static bool cacheHeaderValid(const CacheHeader *_header, size_t _fileLength) {
+	if (_header->magic != OBJZ_CACHE_MAGIC || _header->version != OBJZ_CACHE_VERSION || _header->fileSize != _fileLength || _header->vertexStride > UINT32_MAX)
+		return false;
+	uint64_t sizes[OBJZ_CACHE_NUM_SECTIONS];
+	cacheSectionSizes(_header, sizes);
+	for (uint32_t i = 0; i < OBJZ_CACHE_NUM_SECTIONS; i++) {
+		if (sizes[i] > _fileLength) // The layout can't overflow.
+			return false;
+	}
+	CacheHeader layout = *_header;
+	cacheLayout(&layout);
+	return memcmp(_header, &layout, sizeof(layout)) == 0;
+}
+
+// Mapped, or read into model memory.
+static void cacheFileClose(objzContext *_ctx, File *_file) {
+	if (_file->storage == OBJZ_FILE_STORAGE_MAPPED)
+		fileClose(_ctx, _file);
+	else
+		OBJZ_OUTPUT_FREE(_ctx, (void *)_file->buffer);
+}
+
+static bool hashFile(objzContext *_ctx, const char *_filename, uint64_t *_hash) {
+	File file;
+	if (!fileOpen(_ctx, &file, _filename))
+		return false;
+	*_hash = hashBytes(file.buffer, file.length);
+	fileClose(_ctx, &file);
+	return true;
+}
+
+// Same size and modification time, or same size and contents.
+// File times tick more slowly than they read (milliseconds, or seconds on some file systems), so the source could have been edited again within the tick it was saved in. The time is only trusted if the cache was written in a later tick, like git's "racily clean" check.
+static bool cacheSourceMatches(objzContext *_ctx, const CacheHeader *_header, const char *_filename, const char *_sourceFilename) {
+	uint64_t size, modifiedTime, cacheSize, cacheModifiedTime;
+	if (!fileStat(_sourceFilename, &size, &modifiedTime) || size != _header->sourceSize)
+		return false;
+	if (modifiedTime != 0 && modifiedTime == _header->sourceModifiedTime && fileStat(_filename, &cacheSize, &cacheModifiedTime) && modifiedTime < cacheModifiedTime)
+		return true;
+	uint64_t hash;
+	return hashFile(_ctx, _sourceFilename, &hash) && hash == _header->sourceHash;
+}
+
+bool objz_saveCache(const objzModel *_model, const char *_filename, const char *_sourceFilename) {
+	return objz_saveCacheEx(&s_defaultContext, _model, _filename, _sourceFilename);
+}
+
+bool objz_saveCacheEx(objzContext *_ctx, const objzModel *_model, const char *_filename, const char *_sourceFilename) {
+	_ctx->error[0] = 0;
+	CacheHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = OBJZ_CACHE_MAGIC;
+	header.version = OBJZ_CACHE_VERSION;
+	if (_sourceFilename && (!fileStat(_sourceFilename, &header.sourceSize, &header.sourceModifiedTime) || !hashFile(_ctx, _sourceFilename, &header.sourceHash))) {
+		appendError(_ctx, "Failed to read file '%s'", _sourceFilename);
+		return false;
+	}
+	header.vertexStride = _ctx->vertexDecl.stride;
+	header.positionOffset = cacheOffset(_ctx->vertexDecl.positionOffset);
+	header.texcoordOffset = cacheOffset(_ctx->vertexDecl.texcoordOffset);
+	header.normalOffset = cacheOffset(_ctx->vertexDecl.normalOffset);
+	header.indexFormat = _ctx->indexFormat;
+	header.flags = _model->flags & ~(uint32_t)OBJZ_FLAG_CACHED;
+	header.numIndices = _model->numIndices;
+	header.numMaterials = _model->numMaterials;
+	header.numMeshes = _model->numMeshes;
+	header.numObjects = _model->numObjects;
+	header.numVertices = _model->numVertices;
+	cacheLayout(&header);
+	const void *sections[OBJZ_CACHE_NUM_SECTIONS] = { _model->indices, _model->materials, _model->meshes, _model->objects, _model->vertices };
+	uint64_t sizes[OBJZ_CACHE_NUM_SECTIONS];
+	cacheSectionSizes(&header, sizes);
+	FILE *handle;
+	OBJZ_FOPEN(handle, _filename, "wb");
+	if (!handle) {
+		appendError(_ctx, "Failed to write file '%s'", _filename);
+		return false;
+	}
+	static const uint8_t padding[OBJZ_CACHE_ALIGNMENT] = { 0 };
+	bool result = fwrite(&header, sizeof(header), 1, handle) == 1;
+	uint64_t offset = sizeof(header);
+	for (uint32_t i = 0; i <= OBJZ_CACHE_NUM_SECTIONS && result; i++) {
+		const uint64_t sectionOffset = i < OBJZ_CACHE_NUM_SECTIONS ? header.sections[i] : header.fileSize;
+		const size_t paddingSize = (size_t)(sectionOffset - offset);
+		result = paddingSize == 0 || fwrite(padding, paddingSize, 1, handle) == 1;
+		if (i < OBJZ_CACHE_NUM_SECTIONS && sizes[i] > 0)
+			result = result && fwrite(sections[i], (size_t)sizes[i], 1, handle) == 1;
+		offset = sectionOffset + (i < OBJZ_CACHE_NUM_SECTIONS ? sizes[i] : 0);
+	}
+	if (fclose(handle) != 0)
+		result = false;
+	if (!result) {
+		appendError(_ctx, "Failed to write file '%s'", _filename);
+		remove(_filename);
+	}
+	return result;
+}
+
+objzModel *objz_loadCache(const char *_filename, const char *_sourceFilename) {
+	return objz_loadCacheEx(&s_defaultContext, _filename, _sourceFilename);
+}
+
+objzModel *objz_loadCacheEx(objzContext *_ctx, const char *_filename, const char *_sourceFilename) {
+	_ctx->error[0] = 0;
+	File file;
+	bool opened = false;
+#if OBJZ_MMAP
+	opened = fileMap(&file, _filename, true);
+#endif
+	if (!opened) {
+		// Read into model memory: the arena may be in use by a parser.
+		uint64_t size, modifiedTime;
+		FILE *handle;
+		OBJZ_FOPEN(handle, _filename, "rb");
+		if (handle && fileStat(_filename, &size, &modifiedTime) && size > 0 && size <= SIZE_MAX) {
+			char *buffer = OBJZ_OUTPUT_MALLOC(_ctx, (size_t)size);
+			if (fread(buffer, (size_t)size, 1, handle) == 1) {
+				file.buffer = buffer;
+				file.length = (size_t)size;
+				file.pos = 0;
+				file.storage = OBJZ_FILE_STORAGE_HEAP;
+				opened = true;
+			} else
+				OBJZ_OUTPUT_FREE(_ctx, buffer);
 		}
+		if (handle)
+			fclose(handle);
+	}
+	if (!opened) {
+		appendError(_ctx, "Failed to read file '%s'", _filename);
+		return NULL;
+	}
+	CacheHeader header;
+	bool valid = file.length >= sizeof(header);
+	if (valid) {
+		memcpy(&header, file.buffer, sizeof(header));
+		valid = cacheHeaderValid(&header, file.length);
+	}
+	if (!valid) {
+		appendError(_ctx, "'%s' isn't an objzero cache file, or was written by a different version", _filename);
+	} else if (header.vertexStride != _ctx->vertexDecl.stride || header.positionOffset != cacheOffset(_ctx->vertexDecl.positionOffset) || header.texcoordOffset != cacheOffset(_ctx->vertexDecl.texcoordOffset) || header.normalOffset != cacheOffset(_ctx->vertexDecl.normalOffset) || header.indexFormat != _ctx->indexFormat) {
+		appendError(_ctx, "Cache '%s' has a different vertex or index format", _filename);
+		valid = false;
+	} else if (_sourceFilename && !cacheSourceMatches(_ctx, &header, _filename, _sourceFilename)) {
+		appendError(_ctx, "Cache '%s' is out of date", _filename);
+		valid = false;
+	}
+	if (!valid) {
+		cacheFileClose(_ctx, &file);
+		return NULL;
 	}
-	model->numVertices = vertexHashMap.vertices.length;
-	chunkedArrayDestroy(&positions);
-	chunkedArrayDestroy(&texcoords);
-	chunkedArrayDestroy(&normals);
-	vertexHashMapDestroy(&vertexHashMap);
-	if (s_progress)
-		s_progress(_filename, 100);
+	// Point the model at the sections.
+	CachedModel *cached = OBJZ_OUTPUT_MALLOC(_ctx, sizeof(CachedModel));
+	cached->file = file;
+	char *base = (char *)file.buffer; // Writable: copy-on-write mapping or model memory.
+	uint64_t sizes[OBJZ_CACHE_NUM_SECTIONS];
+	cacheSectionSizes(&header, sizes);
+	void *sections[OBJZ_CACHE_NUM_SECTIONS];
+	for (uint32_t i = 0; i < OBJZ_CACHE_NUM_SECTIONS; i++)
+		sections[i] = sizes[i] > 0 ? base + header.sections[i] : NULL;
+	objzModel *model = &cached->model;
+	model->flags = header.flags | OBJZ_FLAG_CACHED;
+	model->indices = sections[OBJZ_CACHE_SECTION_INDICES];
+	model->numIndices = header.numIndices;
+	model->materials = (objzMaterial *)sections[OBJZ_CACHE_SECTION_MATERIALS];
+	model->numMaterials = header.numMaterials;
+	model->meshes = (objzMesh *)sections[OBJZ_CACHE_SECTION_MESHES];
+	model->numMeshes = header.numMeshes;
+	model->objects = (objzObject *)sections[OBJZ_CACHE_SECTION_OBJECTS];
+	model->numObjects = header.numObjects;
+	model->vertices = sections[OBJZ_CACHE_SECTION_VERTICES];
+	model->numVertices = header.numVertices;
 	return model;
-error:
-	fileClose(&file);
-	arrayDestroy(&materialLibs);
-	arrayDestroy(&materials);
-	arrayDestroy(&tempObjects);
-	chunkedArrayDestroy(&positions);
-	chunkedArrayDestroy(&texcoords);
-	chunkedArrayDestroy(&normals);
-	chunkedArrayDestroy(&faces);
-	arrayDestroy(&faceIndices);
-	arrayDestroy(&tempFaceIndices);
-	return NULL;
 }
 
 void objz_destroy(objzModel *_model) {
+	objz_destroyEx(&s_defaultContext, _model);
+}
+
+void objz_destroyEx(objzContext *_ctx, objzModel *_model) {
 	if (!_model)
 		return;
-	OBJZ_FREE(_model->indices);
-	OBJZ_FREE(_model->materials);
-	OBJZ_FREE(_model->meshes);
-	OBJZ_FREE(_model->objects);
-	OBJZ_FREE(_model->vertices);
-	OBJZ_FREE(_model);
+	if (_model->flags & OBJZ_FLAG_CACHED) {
+		cacheFileClose(_ctx, &((CachedModel *)_model)->file);
+		OBJZ_OUTPUT_FREE(_ctx, _model);
+		return;
+	}
+	OBJZ_OUTPUT_FREE(_ctx, _model->indices);
+	OBJZ_OUTPUT_FREE(_ctx, _model->materials);
+	OBJZ_OUTPUT_FREE(_ctx, _model->meshes);
+	OBJZ_OUTPUT_FREE(_ctx, _model->objects);
+	OBJZ_OUTPUT_FREE(_ctx, _model->vertices);
+	OBJZ_OUTPUT_FREE(_ctx, _model);
 }
 
 const char *objz_getError() {
-	if (s_error[0])
-		return s_error;
+	return objz_getErrorEx(&s_defaultContext);
+}
+
+const char *objz_getErrorEx(const objzContext *_ctx) {
+	if (_ctx->error[0])
+		return _ctx->error;
 	return NULL;
 }
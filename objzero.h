@@ -27,16 +27,30 @@ SOFTWARE.
 #define OBJZERO_H
 
 #include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/*
+A context holds all loader configuration and state, including the error buffer. Loads using different contexts can run concurrently on different threads. A context must not be used by more than one thread at a time.
+
+The functions without a context parameter use a global default context, e.g. objz_load(filename) is objz_loadEx(defaultContext, filename).
+*/
+typedef struct objzContext objzContext;
+
 typedef void *(*objzReallocFunc)(void *_ptr, size_t _size);
 void objz_setRealloc(objzReallocFunc _realloc);
 
+// _realloc is used for the context, all temporary allocations and the returned objzModel. NULL means use realloc.
+objzContext *objz_createContext(objzReallocFunc _realloc);
+void objz_destroyContext(objzContext *_ctx);
+
 typedef void (*objzProgressFunc)(const char *_filename, int _percent);
 void objz_setProgress(objzProgressFunc _progress);
+void objz_setProgressEx(objzContext *_ctx, objzProgressFunc _progress);
 
 #define OBJZ_INDEX_FORMAT_AUTO 0
 #define OBJZ_INDEX_FORMAT_U32  1
@@ -45,6 +59,7 @@ void objz_setProgress(objzProgressFunc _progress);
 // OBJZ_INDEX_FORMAT_U32: objzModel indices are always uint32_t.
 // Default is OBJZ_INDEX_FORMAT_AUTO.
 void objz_setIndexFormat(uint32_t _format);
+void objz_setIndexFormatEx(objzContext *_ctx, uint32_t _format);
 
 /*
 Default vertex data structure looks like this:
@@ -63,6 +78,42 @@ texcoordOffset - optional: set to SIZE_MAX to ignore
 normalOffset - optional: set to SIZE_MAX to ignore
 */
 void objz_setVertexFormat(size_t _stride, size_t _positionOffset, size_t _texcoordOffset, size_t _normalOffset);
+void objz_setVertexFormatEx(objzContext *_ctx, size_t _stride, size_t _positionOffset, size_t _texcoordOffset, size_t _normalOffset);
+
+/*
+Number of threads used to load a single obj file. Default is 1: load on the calling thread.
+Multi-threaded loading produces the same output. Only files over a minimum size are split between threads for parsing. Post-processing (normals, vertices and meshes) is split by object. Material libraries are loaded on other threads while the obj file is parsed.
+The realloc function (see objz_setRealloc and objz_createContext) must be thread-safe if this is greater than 1, and objzMtllibResolveFunc is called on other threads.
+*/
+void objz_setNumThreads(uint32_t _numThreads);
+void objz_setNumThreadsEx(objzContext *_ctx, uint32_t _numThreads);
+
+// Generated normals within this distance of each other, per component, are welded into one. Default is FLT_EPSILON. 0 only welds identical normals.
+void objz_setNormalWeldEpsilon(float _epsilon);
+void objz_setNormalWeldEpsilonEx(objzContext *_ctx, float _epsilon);
+
+/*
+Small temporary allocations for a load come from an arena: large blocks allocated with the realloc function. Freed allocations are reused by the same load, and everything is released at once when the load finishes. Worker threads have their own arenas, so they don't wait for each other. Larger temporary buffers use the realloc function directly.
+The arena keeps its memory for the next load with the same context. If a load needed more than one block, the next load allocates one block the size of the high-water mark instead, so loading files of a similar size after that doesn't allocate small temporary memory.
+objz_setArenaSize frees the arenas' memory and allocates one block of _size bytes, e.g. the high-water mark from an earlier run. 0 just frees it. Ignored while a parser created with the context exists.
+objz_getArenaHighWater returns the most arena memory used by one load, including the worker threads' arenas, in bytes.
+*/
+void objz_setArenaSize(size_t _size);
+void objz_setArenaSizeEx(objzContext *_ctx, size_t _size);
+size_t objz_getArenaHighWater();
+size_t objz_getArenaHighWaterEx(const objzContext *_ctx);
+
+/*
+By default, material libraries ('mtllib' files) are parsed by every load that uses them. A material cache keeps parsed libraries between loads, so obj files that share a library only parse it once.
+Libraries are found by path, or by name if they come from an objzMtllibResolveFunc, and are parsed again if they change: a different size, or different contents. The contents are only read again if the modification time has changed, isn't available, or was within a couple of seconds of the library being parsed.
+A cache can be used by any number of contexts, from any number of threads. Each model gets its own copy of the materials.
+_realloc is used for the cache's memory. NULL means use realloc.
+*/
+typedef struct objzMaterialCache objzMaterialCache;
+objzMaterialCache *objz_createMaterialCache(objzReallocFunc _realloc);
+void objz_destroyMaterialCache(objzMaterialCache *_cache); // The cache must not be set on any context.
+void objz_setMaterialCache(objzMaterialCache *_cache);
+void objz_setMaterialCacheEx(objzContext *_ctx, objzMaterialCache *_cache); // NULL: don't cache. Default is NULL.
 
 #define OBJZ_NAME_MAX 64
 
@@ -105,6 +156,7 @@ typedef struct {
 #define OBJZ_FLAG_TEXCOORDS (1<<0)
 #define OBJZ_FLAG_NORMALS   (1<<1)
 #define OBJZ_FLAG_INDEX32   (1<<2)
+#define OBJZ_FLAG_CACHED    (1<<3) // Loaded with objz_loadCache: the arrays are in one block of memory, a mapping of the cache file.
 
 typedef struct {
 	uint32_t flags;
@@ -125,8 +177,109 @@ typedef struct {
 } objzModel;
 
 objzModel *objz_load(const char *_filename);
+objzModel *objz_loadEx(objzContext *_ctx, const char *_filename);
+/*
+Resolves a material library referenced by an 'mtllib' statement to memory. Return false if it can't be found, which is treated as a warning. *_data must stay valid until objz_loadFromMemory returns.
+*/
+typedef bool (*objzMtllibResolveFunc)(const char *_name, const void **_data, size_t *_size, void *_userData);
+
+/*
+Parse an obj file that is already in memory. _data isn't copied or modified, and doesn't need to be null terminated.
+_resolve is optional: if NULL, 'mtllib' statements are ignored with a warning.
+*/
+objzModel *objz_loadFromMemory(const void *_data, size_t _size, objzMtllibResolveFunc _resolve, void *_userData);
+objzModel *objz_loadFromMemoryEx(objzContext *_ctx, const void *_data, size_t _size, objzMtllibResolveFunc _resolve, void *_userData);
+
+/*
+Load many obj files in parallel, on up to _numThreads threads. Each file is loaded on one thread (see objz_setNumThreads to split a single file between threads), with its own scratch memory that is reused for every file loaded on that thread. The threads' scratch memory is kept with _ctx, so later batches with the same context reuse it.
+Set filename to load a file, or data and size to load from memory like objz_loadFromMemory. The vertex format, index format, normal weld epsilon and material cache of _ctx are used.
+Every file gets model, or NULL on error, and error: the file's errors and warnings, or NULL if there are none. Returns the number of models loaded.
+The realloc function must be thread-safe if _numThreads is greater than 1. objz_destroyBatch destroys all the models and errors; set model to NULL first to keep it.
+*/
+typedef struct {
+	const char *filename;
+	const void *data;
+	size_t size;
+	objzMtllibResolveFunc resolve;
+	void *userData;
+	objzModel *model; // Output.
+	char *error; // Output.
+} objzBatchFile;
+
+uint32_t objz_loadBatch(objzBatchFile *_files, uint32_t _numFiles, uint32_t _numThreads);
+uint32_t objz_loadBatchEx(objzContext *_ctx, objzBatchFile *_files, uint32_t _numFiles, uint32_t _numThreads);
+void objz_destroyBatch(objzBatchFile *_files, uint32_t _numFiles);
+void objz_destroyBatchEx(objzContext *_ctx, objzBatchFile *_files, uint32_t _numFiles);
+
+/*
+Load an obj file on another thread, e.g. to keep a UI responsive. The handle can be polled, waited on or cancelled.
+The load uses a copy of _ctx's settings, and _ctx's temporary memory until it's finished: don't use _ctx for anything else until objz_asyncLoadPoll returns true or objz_asyncLoadWait returns. objz_getErrorEx(_ctx) has the errors after that.
+Only one async load can use a context at a time: objz_loadAsync returns NULL if another hasn't finished. Use a context per load to load files concurrently.
+_callback is optional. It's called on the loading thread when the load finishes, with the model, or NULL if it failed or was cancelled. The model is also returned by objz_asyncLoadWait: don't destroy it in the callback. The progress function (see objz_setProgress) is also called on the loading thread.
+objz_asyncLoadCancel makes the load fail with a "Load cancelled" error. Cancellation is checked while reading, parsing and post-processing, so it stops within milliseconds.
+objz_destroyAsyncLoad frees the handle, after waiting for the load to finish. If objz_asyncLoadWait wasn't called, the load is cancelled first and the model is destroyed.
+Without thread support (OBJZ_NO_THREADS), the file is loaded before objz_loadAsync returns.
+*/
+typedef struct objzAsyncLoad objzAsyncLoad;
+typedef void (*objzAsyncLoadFunc)(objzModel *_model, void *_userData);
+objzAsyncLoad *objz_loadAsync(const char *_filename, objzAsyncLoadFunc _callback, void *_userData);
+objzAsyncLoad *objz_loadAsyncEx(objzContext *_ctx, const char *_filename, objzAsyncLoadFunc _callback, void *_userData);
+bool objz_asyncLoadPoll(const objzAsyncLoad *_load); // True if the load is finished. Doesn't block.
+objzModel *objz_asyncLoadWait(objzAsyncLoad *_load); // Blocks until the load is finished. Returns the model, or NULL on error, see objz_getError.
+void objz_asyncLoadCancel(objzAsyncLoad *_load);
+void objz_destroyAsyncLoad(objzAsyncLoad *_load);
+
+/*
+Incremental parsing, for input that isn't available all at once, e.g. larger than memory, from a socket or a decompressor. Only the parsed data is kept, not the text.
+Feed the parser chunks of any size. Lines may be split across chunks.
+
+_filename is optional and isn't opened. It's used for progress and error messages, and if _resolve is NULL, to find material files. If both are NULL, 'mtllib' statements are ignored with a warning.
+
+objz_parserFeed returns false on error, see objz_getError. objz_parserFinish returns the model, or NULL on error, and destroys the parser.
+Use objz_destroyParser to abandon a parser without calling objz_parserFinish.
+*/
+typedef struct objzParser objzParser;
+objzParser *objz_createParser(const char *_filename, objzMtllibResolveFunc _resolve, void *_userData);
+objzParser *objz_createParserEx(objzContext *_ctx, const char *_filename, objzMtllibResolveFunc _resolve, void *_userData);
+void objz_destroyParser(objzParser *_parser);
+bool objz_parserFeed(objzParser *_parser, const void *_data, size_t _size);
+objzModel *objz_parserFinish(objzParser *_parser);
+
+/*
+A cache is a binary image of a model, loaded by mapping the file into memory: there's no parsing, and no per-element work.
+It records the vertex format and index format of the context used to save it, and objz_loadCache fails if they're different.
+
+_sourceFilename is optional. objz_saveCache records its size, modification time and a hash of its contents. objz_loadCache fails if the source file is a different size, or has different contents. The contents are only read again if the modification time has changed, or the source was modified shortly before the cache was saved.
+
+objzModel *model = objz_loadCache("model.objzc", "model.obj");
+if (!model) {
+	model = objz_load("model.obj");
+	if (model)
+		objz_saveCache(model, "model.objzc", "model.obj");
+}
+
+A cached model is writable: changes don't affect the file. Destroy it with objz_destroy as usual.
+*/
+bool objz_saveCache(const objzModel *_model, const char *_filename, const char *_sourceFilename);
+bool objz_saveCacheEx(objzContext *_ctx, const objzModel *_model, const char *_filename, const char *_sourceFilename); // _ctx must be the context used to load _model, or one with the same vertex format. Its index format is recorded, see above.
+objzModel *objz_loadCache(const char *_filename, const char *_sourceFilename);
+objzModel *objz_loadCacheEx(objzContext *_ctx, const char *_filename, const char *_sourceFilename);
+
+/*
+Reorder the triangles of each mesh for the GPU post-transform vertex cache, with Tipsify. Faces in files are often in an order that makes the GPU transform the same vertices many times.
+Triangles stay in their mesh and keep their winding. Vertices, meshes and objects don't change. Objects are optimized in parallel, see objz_setNumThreads.
+_cacheSize is the number of vertices in the cache, e.g. 16.
+objz_getACMR returns the average cache miss ratio: vertices transformed per triangle with a FIFO cache of _cacheSize vertices, and an empty cache at the start of each mesh. 0.5 is about the best possible for a large mesh, and 3 the worst.
+*/
+void objz_optimizeVertexCache(objzModel *_model, uint32_t _cacheSize);
+void objz_optimizeVertexCacheEx(objzContext *_ctx, objzModel *_model, uint32_t _cacheSize);
+float objz_getACMR(const objzModel *_model, uint32_t _cacheSize);
+float objz_getACMREx(objzContext *_ctx, const objzModel *_model, uint32_t _cacheSize);
+
 void objz_destroy(objzModel *_model);
+void objz_destroyEx(objzContext *_ctx, objzModel *_model); // _ctx must be the context used to load _model, or one with the same realloc function.
 const char *objz_getError(); // Includes warnings.
+const char *objz_getErrorEx(const objzContext *_ctx);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -38,7 +38,7 @@ project "example"
 	files { "example.c" }
 	links { "objzero" }
     filter "system:linux"
-        links { "m" }
+        links { "m", "pthread" }
 
 project "tests"
 	kind "ConsoleApp"
@@ -46,5 +46,12 @@ project "tests"
 	cdialect "C99"
 	files { "tests.c" }
     filter "system:linux"
-        links { "m" }
+        links { "m", "pthread" }
 
+project "benchmark"
+	kind "ConsoleApp"
+	language "C"
+	cdialect "C99"
+	files { "benchmark.c" }
+    filter "system:linux"
+        links { "m", "pthread" }
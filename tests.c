@@ -24,68 +24,1191 @@ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
 OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 */
+#include "objzero.c" // First, it sets feature test macros.
+#include <ctype.h>
 #include <stdio.h>
-#include "objzero.c"
 
 #define ASSERT(_condition) if (!(_condition)) printf("[FAIL] '%s' %s %d\n", #_condition, __FILE__, __LINE__);
 
+static Token makeToken(const char *_text) {
+	Token token;
+	token.text = _text;
+	token.length = (uint32_t)strlen(_text);
+	return token;
+}
+
+static bool resolveTestMtllib(const char *_name, const void **_data, size_t *_size, void *_userData) {
+	(void)_userData;
+	static const char *mtl = "newmtl red\nKd 1 0 0\n";
+	static const char *mtl2 = "newmtl a\nnewmtl b\n";
+	if (strcmp(_name, "test.mtl") == 0)
+		*_data = mtl;
+	else if (strcmp(_name, "test2.mtl") == 0)
+		*_data = mtl2;
+	else
+		return false;
+	*_size = strlen(*_data);
+	return true;
+}
+
+static uint32_t s_numAllocations = 0;
+
+static void *countingRealloc(void *_ptr, size_t _size) {
+	if (!_ptr && _size)
+		s_numAllocations++;
+	return realloc(_ptr, _size);
+}
+
+static void countTask(TaskPool *_pool, uint32_t _task, uint32_t _worker) {
+	(void)_worker;
+	((uint32_t *)_pool->data)[_task]++;
+}
+
+// _userData is the mtl file.
+static bool resolveUserDataMtllib(const char *_name, const void **_data, size_t *_size, void *_userData) {
+	(void)_name;
+	*_data = _userData;
+	*_size = strlen((const char *)_userData);
+	return true;
+}
+
+// "lib<n>.mtl" has materials "m<n>" and "shared". _userData is a char[16][64] buffer for the files. "bad.mtl" has an error.
+static bool resolveNumberedMtllib(const char *_name, const void **_data, size_t *_size, void *_userData) {
+	char (*files)[64] = (char (*)[64])_userData;
+	int n;
+	if (strcmp(_name, "bad.mtl") == 0)
+		*_data = "newmtl\n";
+	else if (sscanf(_name, "lib%d.mtl", &n) == 1 && n >= 0 && n < 16) {
+		sprintf(files[n], "newmtl m%d\nnewmtl shared\nKd %d 0 0\n", n, n);
+		*_data = files[n];
+	} else
+		return false;
+	*_size = strlen((const char *)*_data);
+	return true;
+}
+
+typedef struct {
+	objzMaterialCache *cache;
+	bool loaded[16];
+} MaterialCacheTaskData;
+
+// Load with a context per task, sharing the cache.
+static void materialCacheTask(TaskPool *_pool, uint32_t _task, uint32_t _worker) {
+	(void)_worker;
+	MaterialCacheTaskData *data = (MaterialCacheTaskData *)_pool->data;
+	objzContext *ctx = objz_createContext(NULL);
+	objz_setMaterialCacheEx(ctx, data->cache);
+	const char *obj = _task & 1 ? "mtllib test.mtl\nv 0 0 0\nusemtl red\nf 1 1 1" : "mtllib test2.mtl\nv 0 0 0\nusemtl b\nf 1 1 1";
+	objzModel *model = objz_loadFromMemoryEx(ctx, obj, strlen(obj), resolveTestMtllib, NULL);
+	data->loaded[_task] = model && model->meshes[0].materialIndex == (_task & 1 ? 0 : 1);
+	objz_destroyEx(ctx, model);
+	objz_destroyContext(ctx);
+}
+
+static int compareTriangles(const void *_a, const void *_b) {
+	const uint32_t *a = (const uint32_t *)_a, *b = (const uint32_t *)_b;
+	for (int i = 0; i < 3; i++) {
+		if (a[i] != b[i])
+			return a[i] < b[i] ? -1 : 1;
+	}
+	return 0;
+}
+
+static int32_t s_cancelFlag = 0;
+static int s_cancelPercent = 0;
+
+// Cancel the load when it gets to s_cancelPercent.
+static void cancelProgress(const char *_filename, int _percent) {
+	(void)_filename;
+	if (_percent >= s_cancelPercent)
+		atomicFlagSet(&s_cancelFlag);
+}
+
+#if OBJZ_THREADS
+static int32_t s_holdFlag = 0;
+
+// Keep the load waiting until s_holdFlag is cleared.
+static void holdProgress(const char *_filename, int _percent) {
+	(void)_filename;
+	(void)_percent;
+	while (atomicFlagGet(&s_holdFlag)) {}
+}
+#endif
+
+typedef struct {
+	objzModel *model;
+	uint32_t numCalls;
+} AsyncLoadResult;
+
+static void asyncLoadCallback(objzModel *_model, void *_userData) {
+	AsyncLoadResult *result = (AsyncLoadResult *)_userData;
+	result->model = _model;
+	result->numCalls++;
+}
+
+// Triangles of one mesh, rotated to start at their smallest index, and sorted.
+static uint32_t *sortedMeshTriangles(const objzModel *_model, const objzMesh *_mesh, bool _index32) {
+	const uint32_t numTriangles = _mesh->numIndices / 3;
+	uint32_t *triangles = malloc(sizeof(uint32_t) * 3 * numTriangles);
+	for (uint32_t i = 0; i < numTriangles; i++) {
+		uint32_t t[3];
+		for (int j = 0; j < 3; j++)
+			t[j] = modelIndex(_model, _index32, _mesh->firstIndex + i * 3 + j);
+		const int first = t[0] <= t[1] && t[0] <= t[2] ? 0 : (t[1] <= t[2] ? 1 : 2);
+		for (int j = 0; j < 3; j++)
+			triangles[i * 3 + j] = t[(first + j) % 3];
+	}
+	qsort(triangles, numTriangles, sizeof(uint32_t) * 3, compareTriangles);
+	return triangles;
+}
+
+// Bit exact comparison with strtof.
+static bool parseFloatMatchesStrtof(const char *_text) {
+	float value, expected = strtof(_text, NULL);
+	if (!parseFloat(_text, _text + strlen(_text), &value))
+		return false;
+	return memcmp(&value, &expected, sizeof(float)) == 0;
+}
+
 int main(int argc, char **argv) {
 	{
 		printf("parseVertexAttribIndices\n");
 		Token token;
 		int32_t triplet[3];
 		// optional texcoord and normal
-		snprintf(token.text, sizeof(token.text), "1/2/3");
+		token = makeToken("1/2/3");
 		ASSERT(parseVertexAttribIndices(&token, triplet));
 		ASSERT(triplet[0] == 1);
 		ASSERT(triplet[1] == 2);
 		ASSERT(triplet[2] == 3);
-		snprintf(token.text, sizeof(token.text), "1/2/");
+		token = makeToken("1/2/");
 		ASSERT(parseVertexAttribIndices(&token, triplet));
 		ASSERT(triplet[0] == 1);
 		ASSERT(triplet[1] == 2);
 		ASSERT(triplet[2] == INT_MAX);
-		snprintf(token.text, sizeof(token.text), "1/2");
+		token = makeToken("1/2");
 		ASSERT(parseVertexAttribIndices(&token, triplet));
 		ASSERT(triplet[0] == 1);
 		ASSERT(triplet[1] == 2);
 		ASSERT(triplet[2] == INT_MAX);
-		snprintf(token.text, sizeof(token.text), "1//");
+		token = makeToken("1//");
 		ASSERT(parseVertexAttribIndices(&token, triplet));
 		ASSERT(triplet[0] == 1);
 		ASSERT(triplet[1] == INT_MAX);
 		ASSERT(triplet[2] == INT_MAX);
-		snprintf(token.text, sizeof(token.text), "1/");
+		token = makeToken("1/");
 		ASSERT(parseVertexAttribIndices(&token, triplet));
 		ASSERT(triplet[0] == 1);
 		ASSERT(triplet[1] == INT_MAX);
 		ASSERT(triplet[2] == INT_MAX);
-		snprintf(token.text, sizeof(token.text), "1");
+		token = makeToken("1");
 		ASSERT(parseVertexAttribIndices(&token, triplet));
 		ASSERT(triplet[0] == 1);
 		ASSERT(triplet[1] == INT_MAX);
 		ASSERT(triplet[2] == INT_MAX);
-		snprintf(token.text, sizeof(token.text), "1//3");
+		token = makeToken("1//3");
 		ASSERT(parseVertexAttribIndices(&token, triplet));
 		ASSERT(triplet[0] == 1);
 		ASSERT(triplet[1] == INT_MAX);
 		ASSERT(triplet[2] == 3);
 		// position isn't optional
-		snprintf(token.text, sizeof(token.text), "/2/3");
+		token = makeToken("/2/3");
 		ASSERT(!parseVertexAttribIndices(&token, triplet));
-		snprintf(token.text, sizeof(token.text), "/2/");
+		token = makeToken("/2/");
 		ASSERT(!parseVertexAttribIndices(&token, triplet));
-		snprintf(token.text, sizeof(token.text), "/2");
+		token = makeToken("/2");
 		ASSERT(!parseVertexAttribIndices(&token, triplet));
-		snprintf(token.text, sizeof(token.text), "//3");
+		token = makeToken("//3");
 		ASSERT(!parseVertexAttribIndices(&token, triplet));
-		snprintf(token.text, sizeof(token.text), "//");
+		token = makeToken("//");
 		ASSERT(!parseVertexAttribIndices(&token, triplet));
-		snprintf(token.text, sizeof(token.text), "/");
+		token = makeToken("/");
 		ASSERT(!parseVertexAttribIndices(&token, triplet));
-        token.text[0] = 0;
+		token = makeToken("");
 		ASSERT(!parseVertexAttribIndices(&token, triplet));
 	}
+	{
+		printf("parseFace\n");
+		// Same triplets as parseVertexAttribIndices on each token, whether or not vertices match the shape of the first.
+		const char *lines[] = { "f 1 2 3", "f 1/2 3/4 5/6", "f 1//2 3//4 5//6", "f 1/2/3 4/5/6 7/8/9 10/11/12", "f -1/-1/-1 -2/-2/-2 -3/-3/-3", "f\t1/1\t2/2 \t3/3\r", "f 1/2/3 4/5 6//7 8", "f 1 2/3 4//5 6/7/8", "f 1/2/ 3/4/ 5/6/", "f 1x/2 3/4 5/6x", "f 1// 2// 3//", "f +1 +2 +3", "f 1/2 3/4 5/6/7", "f 4294967297 2 3" };
+		Array rawIndices;
+		arrayInit(&rawIndices, &s_defaultContext, sizeof(int32_t) * 3, 16);
+		for (size_t i = 0; i < OBJZ_RAW_ARRAY_LEN(lines); i++) {
+			Lexer lexer;
+			initLexer(&lexer);
+			lexerSetLine(&lexer, lines[i], strlen(lines[i]), lines[i] + strlen(lines[i]));
+			Token token;
+			tokenize(&lexer, &token, false);
+			rawIndices.length = 0;
+			ASSERT(parseFace(&s_defaultContext, &lexer, &token, &rawIndices));
+			initLexer(&lexer);
+			lexerSetLine(&lexer, lines[i], strlen(lines[i]), lines[i] + strlen(lines[i]));
+			tokenize(&lexer, &token, false);
+			for (uint32_t j = 0;; j++) {
+				tokenize(&lexer, &token, false);
+				if (token.length == 0) {
+					ASSERT(j == rawIndices.length);
+					break;
+				}
+				int32_t triplet[3];
+				ASSERT(parseVertexAttribIndices(&token, triplet));
+				ASSERT(j < rawIndices.length && memcmp(triplet, OBJZ_ARRAY_ELEMENT(rawIndices, j), sizeof(triplet)) == 0);
+			}
+		}
+		const char *invalidLines[] = { "f 1 2", "f 1/2 3/4 /5", "f 1//2 3//4 //5" };
+		for (size_t i = 0; i < OBJZ_RAW_ARRAY_LEN(invalidLines); i++) {
+			Lexer lexer;
+			initLexer(&lexer);
+			lexerSetLine(&lexer, invalidLines[i], strlen(invalidLines[i]), invalidLines[i] + strlen(invalidLines[i]));
+			Token token;
+			tokenize(&lexer, &token, false);
+			rawIndices.length = 0;
+			ASSERT(!parseFace(&s_defaultContext, &lexer, &token, &rawIndices));
+		}
+		arrayDestroy(&rawIndices);
+		s_defaultContext.error[0] = 0;
+	}
+	{
+		printf("tokenize\n");
+		// Tokens of any length, with the line at the end of the buffer and followed by more data.
+		char buffer[512];
+		for (size_t length = 1; length < 300; length++) {
+			for (int followed = 0; followed < 2; followed++) {
+				memset(buffer, 'x', sizeof(buffer));
+				memcpy(buffer, " \tf ", 4);
+				buffer[4 + length] = '\t';
+				memcpy(&buffer[5 + length], "1 ", 2);
+				const size_t lineLength = 7 + length;
+				Lexer lexer;
+				initLexer(&lexer);
+				lexerSetLine(&lexer, buffer, lineLength, followed ? buffer + sizeof(buffer) : buffer + lineLength);
+				Token token;
+				tokenize(&lexer, &token, false);
+				ASSERT(tokenEquals(&token, "f") && tokenColumn(&lexer, &token) == 3);
+				tokenize(&lexer, &token, false);
+				ASSERT(token.length == length && token.text == &buffer[4]);
+				tokenize(&lexer, &token, false);
+				ASSERT(tokenEquals(&token, "1") && tokenColumn(&lexer, &token) == 6 + length);
+				tokenize(&lexer, &token, false);
+				ASSERT(token.length == 0 && isEol(&lexer));
+			}
+		}
+	}
+	{
+		printf("lookupKeyword\n");
+		for (uint32_t i = 1; i < OBJZ_NUM_KEYWORDS; i++) {
+			const char *name = keywordName(i);
+			Token token = makeToken(name);
+			ASSERT(lookupKeyword(&token) == i);
+			char upper[32];
+			for (size_t j = 0; j <= strlen(name); j++)
+				upper[j] = (char)toupper(name[j]);
+			token = makeToken(upper);
+			ASSERT(lookupKeyword(&token) == i);
+		}
+		for (uint32_t i = 0; i < OBJZ_RAW_ARRAY_LEN(s_keywordHashTable); i++) {
+			const uint32_t keyword = s_keywordHashTable[i];
+			ASSERT(keyword < OBJZ_NUM_KEYWORDS);
+			if (keyword != OBJZ_KEYWORD_NONE)
+				ASSERT(keywordHash(keywordName(keyword), (uint32_t)strlen(keywordName(keyword))) == i);
+		}
+		const char *notKeywords[] = { "", "x", "vx", "ff", "map_", "map_K", "newmtll", "mtllib2", "-", "Kd2" };
+		for (size_t i = 0; i < OBJZ_RAW_ARRAY_LEN(notKeywords); i++) {
+			Token token = makeToken(notKeywords[i]);
+			ASSERT(lookupKeyword(&token) == OBJZ_KEYWORD_NONE);
+		}
+	}
+	{
+		printf("parseFloat\n");
+		const char *valid[] = { "0", "-0", "+3.1417e+2", "-0.0E-3", "1.0324", "-1.41", "11e2", ".5", "-.5234", "5.", "-12.345678", "0.1", "16777217", "3.4028235e38", "3.4028236e38", "1e39", "1.17549435e-38", "1.4e-45", "7e-46", "7.1e-46", "1e-50", "000000000000000000000000000001.5", "0.000000000000000000000000000000000000000000001401298464324817070923729583289916131280261941876515771757068283889791082685860601486638188362121582031250000001", "1.00000005960464477539062499999999999999999999999999999999" };
+		for (size_t i = 0; i < OBJZ_RAW_ARRAY_LEN(valid); i++)
+			ASSERT(parseFloatMatchesStrtof(valid[i]));
+		const char *invalid[] = { "", "-", "+", ".", "-.", "e5", "1e", "1e+", "x1", "nan", "inf" };
+		float value;
+		for (size_t i = 0; i < OBJZ_RAW_ARRAY_LEN(invalid); i++)
+			ASSERT(!parseFloat(invalid[i], invalid[i] + strlen(invalid[i]), &value));
+		// Stops at the end and at the first character that doesn't fit.
+		ASSERT(parseFloat("1.25", "1.25" + 3, &value) && value == 1.2f);
+		ASSERT(parseFloat("1.5/2", "1.5/2" + 5, &value) && value == 1.5f);
+		// Every float printed with enough digits to round trip, and halfway between it and the next float.
+		// Run "tests exhaustive" to check all of them, otherwise a sample is checked.
+		const uint64_t step = argc > 1 && strcmp(argv[1], "exhaustive") == 0 ? 1 : 4093;
+		char text[128];
+		bool ok = true;
+		for (uint64_t i = 0; i <= UINT32_MAX && ok; i += step) {
+			const uint32_t bits = (uint32_t)i;
+			float f;
+			memcpy(&f, &bits, sizeof(f));
+			if (isnan(f) || isinf(f))
+				continue;
+			snprintf(text, sizeof(text), "%.9g", f);
+			ok = parseFloatMatchesStrtof(text);
+			snprintf(text, sizeof(text), "%.17g", (double)f + ((double)nextafterf(f, INFINITY) - (double)f) * 0.5);
+			ok = ok && parseFloatMatchesStrtof(text);
+			if (!ok)
+				printf("   %s\n", text);
+		}
+		ASSERT(ok);
+		// Random digit strings, many too long for the fast path.
+		uint32_t seed = 1;
+		for (int i = 0; i < 100000 && ok; i++) {
+			int length = 0;
+			const int numDigits = 1 + (int)((seed = seed * 1664525 + 1013904223) >> 16) % 30;
+			const int point = (int)((seed = seed * 1664525 + 1013904223) >> 16) % (numDigits + 1);
+			if ((seed = seed * 1664525 + 1013904223) >> 31)
+				text[length++] = '-';
+			for (int j = 0; j < numDigits; j++) {
+				if (j == point)
+					text[length++] = '.';
+				text[length++] = (char)('0' + ((seed = seed * 1664525 + 1013904223) >> 16) % 10);
+			}
+			snprintf(&text[length], sizeof(text) - (size_t)length, "e%d", (int)(((seed = seed * 1664525 + 1013904223) >> 16) % 90) - 45);
+			ok = parseFloatMatchesStrtof(text);
+			if (!ok)
+				printf("   %s\n", text);
+		}
+		ASSERT(ok);
+		// Exactly halfway between two floats, and with a digit past 200 zeros that rounds it up: too long to round from the leading digits.
+		char longText[512];
+		snprintf(longText, sizeof(longText), "1.000000059604644775390625%0200d", 0);
+		ASSERT(parseFloat(longText, longText + strlen(longText), &value) && value == 1.0f && parseFloatMatchesStrtof(longText));
+		snprintf(longText, sizeof(longText), "1.000000059604644775390625%0200d", 1);
+		ASSERT(parseFloat(longText, longText + strlen(longText), &value) && value == nextafterf(1.0f, 2.0f) && parseFloatMatchesStrtof(longText));
+		snprintf(longText, sizeof(longText), "-7.00649232162408535461864791644958065640130970938257885878534141944895541342930300743319094181060791015625%0200de-46", 1);
+		ASSERT(parseFloat(longText, longText + strlen(longText), &value) && value == -nextafterf(0.0f, 1.0f) && parseFloatMatchesStrtof(longText));
+		snprintf(longText, sizeof(longText), "340282356779733661637539395458142568447.%0200d", 9);
+		ASSERT(parseFloat(longText, longText + strlen(longText), &value) && value == FLT_MAX && parseFloatMatchesStrtof(longText));
+		// Halfway points across the range, printed with 140 digits.
+		for (uint32_t i = 0; i < 20000 && ok; i++) {
+			const uint32_t bits = (seed = seed * 1664525 + 1013904223) & 0x7f7fffff;
+			float f;
+			memcpy(&f, &bits, sizeof(f));
+			if (isnan(f) || isinf(f))
+				continue;
+			const int length = snprintf(longText, sizeof(longText), "%.140e", (double)f + ((double)nextafterf(f, INFINITY) - (double)f) * 0.5);
+			char *exponent = strchr(longText, 'e');
+			ok = parseFloatMatchesStrtof(longText);
+			memmove(exponent + 60, exponent, (size_t)(longText + length + 1 - exponent));
+			memset(exponent, '0', 60);
+			exponent[59] = '1';
+			ok = ok && parseFloatMatchesStrtof(longText);
+			if (!ok)
+				printf("   %s\n", longText);
+		}
+		ASSERT(ok);
+	}
+	{
+		printf("objz_loadFromMemory\n");
+		const char *obj = "mtllib test.mtl\nv 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nusemtl red\nf 1 2 3 4";
+		objzModel *model = objz_loadFromMemory(obj, strlen(obj), resolveTestMtllib, NULL);
+		ASSERT(model);
+		if (model) {
+			ASSERT(model->numMaterials == 1);
+			ASSERT(model->numMeshes == 1);
+			ASSERT(model->meshes[0].materialIndex == 0);
+			ASSERT(model->numIndices == 6);
+			ASSERT(model->numVertices == 4);
+			ASSERT(model->materials[0].diffuse[0] == 1.0f && model->materials[0].diffuse[1] == 0.0f);
+			objz_destroy(model);
+		}
+		model = objz_loadFromMemory(obj, strlen(obj), NULL, NULL);
+		ASSERT(model && model->numMaterials == 0);
+		ASSERT(objz_getError() != NULL); // Missing mtllib warning.
+		objz_destroy(model);
+		// Not NUL terminated: the last token ends the buffer.
+		const char *unterminated = "v 0 0 0\nv 1 0 0\nv 1 1 0\nf 1 2 3\no name";
+		char *buffer = malloc(strlen(unterminated));
+		memcpy(buffer, unterminated, strlen(unterminated));
+		model = objz_loadFromMemory(buffer, strlen(unterminated), NULL, NULL);
+		ASSERT(model && model->numIndices == 3);
+		objz_destroy(model);
+		free(buffer);
+	}
+	{
+		printf("vertexHashMap\n");
+		// Starts far too small, so it has to grow. Indices are in insertion order and the same key gets the same index.
+		VertexHashMap map;
+		vertexHashMapInit(&map, &s_defaultContext, 1, 100001);
+		bool ok = true;
+		for (uint32_t pass = 0; pass < 2; pass++) {
+			for (uint32_t i = 0; i < 100000; i++) {
+				const uint32_t texcoord = i % 7 == 0 ? UINT32_MAX : i * 3;
+				ok = ok && vertexHashMapInsert(&map, i / 50000, i % 1000, texcoord, i) == i;
+			}
+		}
+		ASSERT(ok);
+		ASSERT(map.positions.length == 100000 && map.numSlots >= 200000 && (map.numSlots & (map.numSlots - 1)) == 0);
+		ASSERT(vertexHashMapInsert(&map, 1, 0, 0, 0) == 100000);
+		ASSERT(vertexHashMapInsert(&map, 0, 0, UINT32_MAX, 0) == 0);
+		vertexHashMapDestroy(&map);
+	}
+	{
+		printf("normalHashMap\n");
+		const float epsilons[] = { FLT_EPSILON, 0.01f, 0 };
+		for (size_t i = 0; i < OBJZ_RAW_ARRAY_LEN(epsilons); i++) {
+			objzContext *ctx = objz_createContext(NULL);
+			objz_setNormalWeldEpsilonEx(ctx, epsilons[i]);
+			ChunkedArray normals;
+			chunkedArrayInit(&normals, ctx, sizeof(vec3), 64);
+			NormalHashMap map;
+			normalHashMapInit(&map, ctx, 1, &normals);
+			// Many distinct normals, so the map has to grow. Any normal within epsilon, per component, is a match.
+			bool ok = true;
+			for (uint32_t j = 0; j < 1000; j++) {
+				vec3 n;
+				OBJZ_VEC3_SET(n, cosf(j * 0.1f) * 0.6f, sinf(j * 0.1f) * 0.6f, j * 0.0008f - 0.4f);
+				const uint32_t index = normalHashMapInsert(&map, &n);
+				ok = ok && index == j;
+				OBJZ_VEC3_SET(n, n.x + epsilons[i] * 0.9f, n.y - epsilons[i] * 0.9f, n.z);
+				ok = ok && normalHashMapInsert(&map, &n) == index;
+			}
+			ASSERT(ok);
+			// Close, but on either side of a cell boundary.
+			vec3 a, b, c;
+			OBJZ_VEC3_SET(a, 0.0199f, 0, 1);
+			OBJZ_VEC3_SET(b, 0.0201f, 0, 1);
+			OBJZ_VEC3_SET(c, 0.0301f, 0, 1);
+			const uint32_t ia = normalHashMapInsert(&map, &a);
+			ASSERT((normalHashMapInsert(&map, &b) == ia) == (epsilons[i] >= 0.01f));
+			ASSERT(normalHashMapInsert(&map, &c) != ia);
+			OBJZ_VEC3_SET(a, 0, 0, -1);
+			OBJZ_VEC3_SET(b, -0.0f, 0, -1);
+			ASSERT(normalHashMapInsert(&map, &a) == normalHashMapInsert(&map, &b));
+			normalHashMapClear(&map);
+			ASSERT(normalHashMapInsert(&map, &a) == normals.length - 1);
+			normalHashMapDestroy(&map);
+			chunkedArrayDestroy(&normals);
+			objz_destroyContext(ctx);
+		}
+	}
+	{
+		printf("meshes\n");
+		// Faces are batched by material in material order, no material first, keeping their order within each material.
+		const char *obj = "mtllib test2.mtl\nv 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nf 2 3 4\nusemtl b\nf 1 2 3\nusemtl a\nf 1 3 4\nusemtl b\nf 2 3 4\nusemtl a\nf 1 2 4\n";
+		const int32_t expectedMaterials[] = { -1, 0, 1 };
+		const uint32_t expectedPositions[] = { 2, 3, 4, 1, 3, 4, 1, 2, 4, 1, 2, 3, 2, 3, 4 };
+		const float positions[][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+		objzModel *model = objz_loadFromMemory(obj, strlen(obj), resolveTestMtllib, NULL);
+		ASSERT(model && model->numMaterials == 2 && model->numMeshes == 3 && model->numIndices == 15);
+		if (model && model->numMeshes == 3 && model->numIndices == 15) {
+			for (uint32_t i = 0; i < 3; i++) {
+				ASSERT(model->meshes[i].materialIndex == expectedMaterials[i]);
+				ASSERT(model->meshes[i].firstIndex == (i == 0 ? 0 : 3 + (i - 1) * 6) && model->meshes[i].numIndices == (i == 0 ? 3u : 6u));
+			}
+			for (uint32_t i = 0; i < 15; i++) {
+				const float *pos = &((const float *)model->vertices)[((const uint16_t *)model->indices)[i] * 8];
+				ASSERT(pos[0] == positions[expectedPositions[i] - 1][0] && pos[1] == positions[expectedPositions[i] - 1][1]);
+			}
+		}
+		objz_destroy(model);
+	}
+	{
+		printf("smoothing group normals\n");
+		// Corners sharing a position and smoothing group get the average normal of their faces.
+		const char *obj = "v 0 0 0\nv 1 0 0\nv 0 1 0\nv 0 0 1\ns 1\nf 1 2 3\nf 2 1 4\ns 2\nf 1 3 4\n";
+		const float h = 0.70710678f;
+		const float expected[9][3] = { { 0, h, h }, { 0, h, h }, { 0, 0, 1 }, { 0, h, h }, { 0, h, h }, { 0, 1, 0 }, { 1, 0, 0 }, { 1, 0, 0 }, { 1, 0, 0 } };
+		objzModel *model = objz_loadFromMemory(obj, strlen(obj), NULL, NULL);
+		ASSERT(model && model->numIndices == 9 && model->numVertices == 7);
+		if (model && model->numIndices == 9) {
+			for (uint32_t i = 0; i < 9; i++) {
+				const float *normal = &((const float *)model->vertices)[((const uint16_t *)model->indices)[i] * 8 + 5];
+				ASSERT(fabsf(normal[0] - expected[i][0]) < 1e-6f && fabsf(normal[1] - expected[i][1]) < 1e-6f && fabsf(normal[2] - expected[i][2]) < 1e-6f);
+			}
+		}
+		objz_destroy(model);
+	}
+	{
+		printf("objz_parserFeed\n");
+		const char *obj = "mtllib test.mtl\r\no a\nv 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nvt 0 0\nusemtl red\ns 1\nf 1/1 2/1 3/1 4/1\r\no b\nf -4 -3 -2";
+		objzModel *expected = objz_loadFromMemory(obj, strlen(obj), resolveTestMtllib, NULL);
+		ASSERT(expected);
+		// Split lines across chunks of every size.
+		for (size_t chunkSize = 1; expected && chunkSize <= 8; chunkSize++) {
+			objzParser *parser = objz_createParser(NULL, resolveTestMtllib, NULL);
+			for (size_t i = 0; i < strlen(obj); i += chunkSize)
+				ASSERT(objz_parserFeed(parser, &obj[i], OBJZ_SMALLEST(chunkSize, strlen(obj) - i)));
+			objzModel *model = objz_parserFinish(parser);
+			ASSERT(model);
+			if (!model)
+				continue;
+			ASSERT(model->numMaterials == expected->numMaterials);
+			ASSERT(model->numObjects == expected->numObjects);
+			ASSERT(model->numMeshes == expected->numMeshes && memcmp(model->meshes, expected->meshes, sizeof(objzMesh) * model->numMeshes) == 0);
+			ASSERT(model->numIndices == expected->numIndices && memcmp(model->indices, expected->indices, sizeof(uint16_t) * model->numIndices) == 0);
+			ASSERT(model->numVertices == expected->numVertices && memcmp(model->vertices, expected->vertices, sizeof(float) * 8 * model->numVertices) == 0);
+			objz_destroy(model);
+		}
+		objz_destroy(expected);
+		objzParser *parser = objz_createParser(NULL, NULL, NULL);
+		ASSERT(objz_parserFeed(parser, "v 0 0 0\nf 1 ", 12));
+		ASSERT(!objz_parserFeed(parser, "2\n", 2));
+		ASSERT(!objz_parserFinish(parser));
+	}
+	{
+		printf("parseRanges\n");
+		const char *obj = "mtllib test.mtl\no a\nv 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nvt 0 0\nusemtl red\ns 1\nf 1/1 2/1 3/1 4/1\no b\nv 0 0 1\nf -4 -3 -1\ng c\nusemtl red\nf 2 3 5\nv 1 1 1\nf -1 -2 -3\n";
+		objzModel *expected = objz_loadFromMemory(obj, strlen(obj), resolveTestMtllib, NULL);
+		ASSERT(expected);
+		// Ranges are small enough to split between most lines.
+		for (uint32_t numRanges = 2; expected && numRanges <= 16; numRanges++) {
+			objzParser *parser = objz_createParser(NULL, resolveTestMtllib, NULL);
+			File file;
+			fileOpenMemory(&file, obj, strlen(obj));
+			ASSERT(parseRanges(parser, &file, numRanges));
+			objzModel *model = objz_parserFinish(parser);
+			ASSERT(model);
+			if (!model)
+				continue;
+			ASSERT(model->numMaterials == expected->numMaterials);
+			ASSERT(model->numObjects == expected->numObjects);
+			for (uint32_t i = 0; i < model->numObjects && i < expected->numObjects; i++) {
+				ASSERT(strcmp(model->objects[i].name, expected->objects[i].name) == 0);
+				ASSERT(memcmp(&model->objects[i].firstMesh, &expected->objects[i].firstMesh, sizeof(uint32_t) * 6) == 0);
+			}
+			ASSERT(model->numMeshes == expected->numMeshes && memcmp(model->meshes, expected->meshes, sizeof(objzMesh) * model->numMeshes) == 0);
+			ASSERT(model->numIndices == expected->numIndices && memcmp(model->indices, expected->indices, sizeof(uint16_t) * model->numIndices) == 0);
+			ASSERT(model->numVertices == expected->numVertices && memcmp(model->vertices, expected->vertices, sizeof(float) * 8 * model->numVertices) == 0);
+			objz_destroy(model);
+		}
+		objz_destroy(expected);
+		// Errors are reported with the same line number as a serial parse.
+		const char *invalid = "v 0 0 0\nv 1 0 0\nv 1 1 0\nf 1 2 3\nf 1 2 3\nv 0 x 0\nf 1 2 3\n";
+		objzParser *parser = objz_createParser(NULL, NULL, NULL);
+		File file;
+		fileOpenMemory(&file, invalid, strlen(invalid));
+		ASSERT(!parseRanges(parser, &file, 4));
+		ASSERT(strncmp(objz_getError(), "(6:", 3) == 0);
+		objz_destroyParser(parser);
+		// Statements before the first vertex are parsed before splitting.
+		const char *invalidAfterHeader = "# comment\no a\n\nv 0 0 0\nv 1 0 0\nv 1 1 0\nf 1 2 3\nv 0 x 0\n";
+		parser = objz_createParser(NULL, NULL, NULL);
+		fileOpenMemory(&file, invalidAfterHeader, strlen(invalidAfterHeader));
+		ASSERT(!parseRanges(parser, &file, 3));
+		ASSERT(strncmp(objz_getError(), "(8:", 3) == 0);
+		objz_destroyParser(parser);
+	}
+	{
+		printf("runTasks\n");
+		uint32_t counts[1000];
+		for (uint32_t numWorkers = 1; numWorkers <= 8; numWorkers++) {
+			memset(counts, 0, sizeof(counts));
+			runTasks(&s_defaultContext, countTask, counts, 1000, numWorkers);
+			bool once = true;
+			for (uint32_t i = 0; i < 1000; i++)
+				once = once && counts[i] == 1;
+			ASSERT(once);
+		}
+	}
+	{
+		printf("post-processing threads\n");
+		// Objects of different sizes, some with normals, some smoothed, some empty.
+		char *obj = malloc(1 << 20);
+		size_t length = 0;
+		length += sprintf(&obj[length], "mtllib test2.mtl\nvn 0 0 1\n");
+		for (int i = 0; i < 40; i++) {
+			const int n = 1 + (i * 7919) % 30;
+			length += sprintf(&obj[length], "o obj%d\n", i);
+			if (i % 9 == 5)
+				continue;
+			length += sprintf(&obj[length], "s %d\nusemtl %s\n", i % 3, i % 2 ? "a" : "b");
+			for (int y = 0; y <= n; y++) {
+				for (int x = 0; x <= n; x++)
+					length += sprintf(&obj[length], "v %d %d %d\n", x, y, (x * y + i) % 5);
+			}
+			for (int y = 0; y < n; y++) {
+				for (int x = 0; x < n; x++) {
+					const int v = -(n + 1) * (n + 1) + y * (n + 1) + x;
+					if (i % 4 == 1)
+						length += sprintf(&obj[length], "f %d//1 %d//1 %d//1 %d//1\n", v, v + 1, v + n + 2, v + n + 1);
+					else
+						length += sprintf(&obj[length], "%sf %d %d %d %d\n", x == n / 2 ? "usemtl a\n" : "", v, v + 1, v + n + 2, v + n + 1);
+				}
+			}
+		}
+		objzModel *expected = objz_loadFromMemory(obj, length, resolveTestMtllib, NULL);
+		ASSERT(expected);
+		objzContext *ctx = objz_createContext(NULL);
+		for (uint32_t numThreads = 2; expected && numThreads <= 8; numThreads *= 2) {
+			objz_setNumThreadsEx(ctx, numThreads);
+			objzModel *model = objz_loadFromMemoryEx(ctx, obj, length, resolveTestMtllib, NULL);
+			ASSERT(model);
+			if (!model)
+				continue;
+			ASSERT(model->flags == expected->flags);
+			ASSERT(model->numObjects == expected->numObjects);
+			for (uint32_t i = 0; i < model->numObjects && i < expected->numObjects; i++) {
+				ASSERT(strcmp(model->objects[i].name, expected->objects[i].name) == 0);
+				ASSERT(memcmp(&model->objects[i].firstMesh, &expected->objects[i].firstMesh, sizeof(uint32_t) * 6) == 0);
+			}
+			ASSERT(model->numMeshes == expected->numMeshes && memcmp(model->meshes, expected->meshes, sizeof(objzMesh) * model->numMeshes) == 0);
+			ASSERT(model->numIndices == expected->numIndices && memcmp(model->indices, expected->indices, sizeof(uint16_t) * model->numIndices) == 0);
+			ASSERT(model->numVertices == expected->numVertices && memcmp(model->vertices, expected->vertices, sizeof(float) * 8 * model->numVertices) == 0);
+			objz_destroyEx(ctx, model);
+		}
+		objz_destroyContext(ctx);
+		objz_destroy(expected);
+		free(obj);
+	}
+	{
+		printf("calculateFaceNormals\n");
+		ChunkedArray positions, faces;
+		chunkedArrayInit(&positions, &s_defaultContext, sizeof(vec3), 64);
+		chunkedArrayInit(&faces, &s_defaultContext, sizeof(Face), 16);
+		srand(1);
+		for (uint32_t i = 0; i < 300; i++) {
+			vec3 pos;
+			OBJZ_VEC3_SET(pos, (float)(rand() % 2000 - 1000) / 7.0f, (float)(rand() % 2000 - 1000) / 3.0f, (float)(rand() % 10));
+			chunkedArrayAppend(&positions, &pos);
+		}
+		for (uint32_t i = 0; i < 103; i++) {
+			Face face;
+			memset(&face, 0, sizeof(face));
+			for (int k = 0; k < 3; k++)
+				face.indices[k].v = (uint32_t)rand() % positions.length;
+			if (i % 10 == 3)
+				face.indices[2].v = face.indices[1].v; // Degenerate: zero length normal.
+			chunkedArrayAppend(&faces, &face);
+		}
+		vec3 normals[103];
+		calculateFaceNormals(&faces, &positions, normals);
+		bool same = true;
+		for (uint32_t i = 0; i < faces.length; i++) {
+			const Face *face = chunkedArrayElement(&faces, i);
+			const vec3 *p0 = chunkedArrayElement(&positions, face->indices[0].v);
+			const vec3 *p1 = chunkedArrayElement(&positions, face->indices[1].v);
+			const vec3 *p2 = chunkedArrayElement(&positions, face->indices[2].v);
+			vec3 edge0, edge1, expected;
+			OBJZ_VEC3_SUB(edge0, *p1, *p0);
+			OBJZ_VEC3_SUB(edge1, *p2, *p0);
+			OBJZ_VEC3_CROSS(expected, edge0, edge1);
+			vec3Normalize(&expected, &expected);
+			same = same && memcmp(&normals[i], &expected, sizeof(vec3)) == 0;
+		}
+		ASSERT(same);
+		chunkedArrayDestroy(&positions);
+		chunkedArrayDestroy(&faces);
+	}
+	{
+		printf("writeVertices\n");
+		// The default vertex format is written differently, compare it with the same format padded to 40 bytes.
+		const char *obj = "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nvt 0 0\nvt 1 1\nvn 0 0 1\nf 1/1/1 2/2/1 3/1/1 4\nf 1 3 2\nf 4/9 3 2\n";
+		objzModel *expected = objz_loadFromMemory(obj, strlen(obj), NULL, NULL);
+		ASSERT(expected);
+		objzContext *ctx = objz_createContext(NULL);
+		objz_setVertexFormatEx(ctx, sizeof(float) * 10, 0, sizeof(float) * 3, sizeof(float) * 5);
+		objzModel *model = objz_loadFromMemoryEx(ctx, obj, strlen(obj), NULL, NULL);
+		ASSERT(model);
+		if (expected && model) {
+			ASSERT(model->numVertices == expected->numVertices);
+			for (uint32_t i = 0; i < model->numVertices && i < expected->numVertices; i++)
+				ASSERT(memcmp(&((const float *)model->vertices)[i * 10], &((const float *)expected->vertices)[i * 8], sizeof(float) * 8) == 0);
+		}
+		objz_destroyEx(ctx, model);
+		objz_destroyContext(ctx);
+		objz_destroy(expected);
+	}
+	{
+		printf("arena\n");
+		objzContext *ctx = objz_createContext(countingRealloc);
+		arenaBeginLoad(ctx);
+		uint8_t *a = OBJZ_MALLOC(ctx, 100);
+		memset(a, 1, 100);
+		ASSERT(((uintptr_t)a & (OBJZ_ARENA_ALIGNMENT - 1)) == 0);
+		ASSERT(arenaClassSize(arenaSizeClass(100)) == 112 && arenaClassSize(arenaSizeClass(OBJZ_ARENA_MAX_ALLOCATION)) == OBJZ_ARENA_MAX_ALLOCATION && arenaSizeClass(OBJZ_ARENA_MAX_ALLOCATION) == OBJZ_ARENA_NUM_SIZES - 1);
+		ASSERT(OBJZ_REALLOC(ctx, a, 112) == a); // Still fits its size class.
+		a = OBJZ_REALLOC(ctx, a, 1000); // Copied.
+		ASSERT(a[0] == 1 && a[99] == 1);
+		ASSERT(OBJZ_MALLOC(ctx, 100) == a - 112 - OBJZ_ARENA_HEADER_SIZE); // The first allocation, reused.
+		const size_t used = ctx->arena->used;
+		OBJZ_FREE(ctx, a);
+		ASSERT(OBJZ_MALLOC(ctx, 1000) == a && ctx->arena->used == used);
+		// Large allocations don't come from the arena.
+		s_numAllocations = 0;
+		uint8_t *b = OBJZ_MALLOC(ctx, OBJZ_ARENA_MAX_ALLOCATION + 1);
+		ASSERT(s_numAllocations == 1 && ctx->arena->used == used);
+		b = OBJZ_REALLOC(ctx, b, OBJZ_ARENA_MAX_ALLOCATION * 2);
+		OBJZ_FREE(ctx, b);
+		for (int i = 0; i < OBJZ_ARENA_MIN_BLOCK_SIZE / OBJZ_ARENA_MAX_ALLOCATION; i++)
+			OBJZ_MALLOC(ctx, OBJZ_ARENA_MAX_ALLOCATION); // Another block.
+		ASSERT(ctx->arena->blocks->next != NULL);
+		// Workers allocate from their own arenas.
+		objzContext worker;
+		arenaWorkerContext(ctx, 1, &worker);
+		ASSERT(worker.arena != ctx->arena && worker.arena == ctx->arena->nextWorker->nextWorker && worker.arena->numLoads == 1);
+		uint8_t *c = OBJZ_MALLOC(&worker, 100);
+		ASSERT(worker.arena->used > 0);
+		OBJZ_FREE(ctx, c); // To the arena it came from.
+		ASSERT(worker.arena->freeLists[arenaSizeClass(100)] == c);
+		arenaEndLoad(ctx);
+		ASSERT(!ctx->arena->blocks && ctx->arena->used == 0 && ctx->arena->nextBlockSize > OBJZ_ARENA_MIN_BLOCK_SIZE);
+		ASSERT(worker.arena->numLoads == 0 && worker.arena->used == 0);
+		ASSERT(objz_getArenaHighWaterEx(ctx) > OBJZ_ARENA_MIN_BLOCK_SIZE);
+		// The first load needs more than one block, the second allocates one block, the third only allocates the model.
+		const char *obj = "mtllib test.mtl\nv 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nusemtl red\nf 1 2 3 4\n";
+		objz_setArenaSizeEx(ctx, 0);
+		for (int i = 0; i < 3; i++) {
+			s_numAllocations = 0;
+			objzModel *model = objz_loadFromMemoryEx(ctx, obj, strlen(obj), resolveTestMtllib, NULL);
+			ASSERT(model && model->numMaterials == 1 && model->numIndices == 6);
+			objz_destroyEx(ctx, model);
+			if (i == 2 && OBJZ_PRESCAN)
+				ASSERT(s_numAllocations == 6); // Without the prescan, the guessed array sizes are too large for the arena.
+		}
+		// Streaming parsers keep the arena until they are finished or destroyed.
+		objzParser *parser = objz_createParserEx(ctx, NULL, NULL, NULL);
+		ASSERT(ctx->arena->numLoads == 1);
+		objz_destroyParser(parser);
+		ASSERT(ctx->arena->numLoads == 0);
+		objz_destroyContext(ctx);
+	}
+	{
+		printf("prescan\n");
+		const char *obj = "# comment\nv 0 0 0\n  v 1 0 0\r\nv\t1 1 0\nv 0 1 0\nvt 0 0\nvt 1 1\nvn 0 0 1\no a\nf 1 2 3\n\tf 1/1/1   2/2/1 3/1/1 4/2/1\r\ng b\nf  1 2\t3   4 \r\nusemtl x\nvp 1\nfo 1\nf 1 2 3";
+		objzParser parser;
+		parserInit(&parser, &s_defaultContext, "prescan", nullMtllibResolve, NULL);
+		File file;
+		fileOpenMemory(&file, obj, strlen(obj));
+		ASSERT(parseLines(&parser, &file, false));
+		PrescanCounts counts;
+		prescan(obj, obj + strlen(obj), &counts);
+		ASSERT(counts.positions == parser.positions.length);
+		ASSERT(counts.texcoords == parser.texcoords.length);
+		ASSERT(counts.normals == parser.normals.length);
+		ASSERT(counts.faces == parser.faces.length);
+		ASSERT(counts.objects == 2);
+		parserDestroy(&parser);
+		// Token counting across vector boundaries.
+		const char *tokens[] = { "", " ", "a", " a", "a ", "a b", "  aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa b  c\t\td ", "aaaaaaaaaaaaaaaa bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb cccccccccccccccc d e f g h i j k l m n o p q r s t u v w x y z" };
+		const uint32_t expected[] = { 0, 0, 1, 1, 1, 2, 4, 26 };
+		for (uint32_t i = 0; i < OBJZ_RAW_ARRAY_LEN(tokens); i++) {
+			const size_t length = strlen(tokens[i]);
+			ASSERT(countTokens(tokens[i], tokens[i] + length, tokens[i] + length) == expected[i]);
+			// Readable past the end of the line.
+			char buffer[256];
+			memset(buffer, 'x', sizeof(buffer));
+			memcpy(buffer, tokens[i], length);
+			ASSERT(countTokens(buffer, buffer + length, buffer + sizeof(buffer)) == expected[i]);
+		}
+		// Exact count: one chunk. More than reserved: still grows.
+		ChunkedArray array;
+		chunkedArrayInit(&array, &s_defaultContext, sizeof(uint32_t), 4);
+		chunkedArrayReserve(&array, 100);
+		for (uint32_t i = 0; i < 100; i++)
+			chunkedArrayAppend(&array, &i);
+		ASSERT(array.chunks.length == 1);
+		for (uint32_t i = 100; i < 1000; i++)
+			chunkedArrayAppend(&array, &i);
+		for (uint32_t i = 0; i < 1000; i++)
+			ASSERT(*(uint32_t *)chunkedArrayElement(&array, i) == i);
+		chunkedArrayDestroy(&array);
+	}
+	{
+		printf("cache\n");
+		const char *obj = "mtllib test.mtl\no a\nv 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nvt 0 0\nusemtl red\nf 1/1 2/1 3/1 4/1\no b\nf 1 3 4";
+		const char *sourceFilename = "objz_test_cache.obj", *cacheFilename = "objz_test_cache.objzc";
+		FILE *file = fopen(sourceFilename, "wb");
+		fwrite(obj, strlen(obj), 1, file);
+		fclose(file);
+		objzModel *model = objz_loadFromMemory(obj, strlen(obj), resolveTestMtllib, NULL);
+		ASSERT(objz_saveCache(model, cacheFilename, sourceFilename));
+		objzModel *cached = objz_loadCache(cacheFilename, sourceFilename);
+		ASSERT(cached);
+		if (cached) {
+			ASSERT(cached->flags == (model->flags | OBJZ_FLAG_CACHED));
+			ASSERT(cached->numIndices == model->numIndices && memcmp(cached->indices, model->indices, model->numIndices * sizeof(uint16_t)) == 0);
+			ASSERT(cached->numMaterials == 1 && memcmp(cached->materials, model->materials, sizeof(objzMaterial)) == 0);
+			ASSERT(cached->numMeshes == model->numMeshes && memcmp(cached->meshes, model->meshes, model->numMeshes * sizeof(objzMesh)) == 0);
+			ASSERT(cached->numObjects == 2 && strcmp(cached->objects[1].name, "b") == 0 && cached->objects[1].numIndices == 3);
+			ASSERT(cached->numVertices == model->numVertices && memcmp(cached->vertices, model->vertices, model->numVertices * sizeof(float) * 8) == 0);
+			ASSERT(!OBJZ_MMAP || ((uintptr_t)cached->vertices & (OBJZ_CACHE_ALIGNMENT - 1)) == 0); // Mapped files are page aligned.
+			cached->objects[0].name[0] = 'x'; // Writable, but the file doesn't change.
+			objz_destroy(cached);
+		}
+		cached = objz_loadCache(cacheFilename, NULL);
+		ASSERT(cached && cached->objects[0].name[0] == 'a');
+		objz_destroy(cached);
+		// A different index format.
+		objz_setIndexFormat(OBJZ_INDEX_FORMAT_U32);
+		ASSERT(!objz_loadCache(cacheFilename, sourceFilename) && objz_getError());
+		objz_setIndexFormat(OBJZ_INDEX_FORMAT_AUTO);
+		// The same size, edited straight after saving: within the same second, and maybe the same file time tick.
+		ASSERT(objz_saveCache(model, cacheFilename, sourceFilename));
+		file = fopen(sourceFilename, "wb");
+		fwrite(obj, strlen(obj) - 1, 1, file);
+		fputc('3', file);
+		fclose(file);
+		ASSERT(!objz_loadCache(cacheFilename, sourceFilename) && objz_getError());
+		// The source has changed.
+		file = fopen(sourceFilename, "ab");
+		fputs("\nf 1 2 3", file);
+		fclose(file);
+		ASSERT(!objz_loadCache(cacheFilename, sourceFilename) && objz_getError());
+		// Not a cache file.
+		ASSERT(!objz_loadCache(sourceFilename, NULL) && objz_getError());
+		// A truncated cache file.
+		objz_saveCache(model, cacheFilename, NULL);
+		file = fopen(cacheFilename, "r+b");
+		fseek(file, 0, SEEK_END);
+		const long length = ftell(file);
+		fseek(file, 0, SEEK_SET);
+		char *data = malloc((size_t)length);
+		fread(data, (size_t)length, 1, file);
+		fclose(file);
+		file = fopen(cacheFilename, "wb");
+		fwrite(data, (size_t)length - 1, 1, file);
+		fclose(file);
+		free(data);
+		ASSERT(!objz_loadCache(cacheFilename, NULL) && objz_getError());
+		objz_destroy(model);
+		remove(sourceFilename);
+		remove(cacheFilename);
+	}
+	{
+		printf("material cache\n");
+		const char *mtlFilename = "objz_test_mtlcache.mtl", *objFilename = "objz_test_mtlcache.obj";
+		FILE *file = fopen(objFilename, "wb");
+		fputs("mtllib objz_test_mtlcache.mtl\nv 0 0 0\nv 1 0 0\nv 1 1 0\nusemtl red\nf 1 2 3", file);
+		fclose(file);
+		file = fopen(mtlFilename, "wb");
+		fputs("newmtl red\nKd 1 0 0\n", file);
+		fclose(file);
+		objzMaterialCache *cache = objz_createMaterialCache(NULL);
+		objz_setMaterialCache(cache);
+		for (int i = 0; i < 2; i++) {
+			objzModel *model = objz_load(objFilename);
+			ASSERT(model && model->numMaterials == 1 && strcmp(model->materials[0].name, "red") == 0 && model->materials[0].diffuse[0] == 1.0f && model->meshes[0].materialIndex == 0);
+			objz_destroy(model);
+			ASSERT(cache->libraries && !cache->libraries->next);
+		}
+		// A changed library is parsed again, and replaces the old one.
+		file = fopen(mtlFilename, "wb");
+		fputs("newmtl green\nKd 0 1 0\nnewmtl red\nKd 0.5 0 0\n", file);
+		fclose(file);
+		objzModel *model = objz_load(objFilename);
+		ASSERT(model && model->numMaterials == 2 && model->materials[1].diffuse[0] == 0.5f && model->meshes[0].materialIndex == 1);
+		objz_destroy(model);
+		ASSERT(cache->libraries && !cache->libraries->next && cache->libraries->numMaterials == 2);
+		// The same size and, on Linux, the same modification time: edited straight after it was parsed.
+#if OBJZ_MMAP && defined(__linux__)
+		struct stat st;
+		stat(mtlFilename, &st);
+#endif
+		file = fopen(mtlFilename, "wb");
+		fputs("newmtl green\nKd 0 1 0\nnewmtl red\nKd 0.2 0 0\n", file);
+		fclose(file);
+#if OBJZ_MMAP && defined(__linux__)
+		const struct timespec times[2] = { st.st_atim, st.st_mtim };
+		utimensat(AT_FDCWD, mtlFilename, times, 0);
+#endif
+		model = objz_load(objFilename);
+		ASSERT(model && model->numMaterials == 2 && model->materials[1].diffuse[0] == 0.2f);
+		objz_destroy(model);
+		// From memory: keyed by name and contents.
+		const char *obj = "mtllib test.mtl\nv 0 0 0\nusemtl red\nf 1 1 1";
+		for (int i = 0; i < 2; i++) {
+			model = objz_loadFromMemory(obj, strlen(obj), resolveTestMtllib, NULL);
+			ASSERT(model && model->numMaterials == 1 && model->materials[0].diffuse[0] == 1.0f);
+			objz_destroy(model);
+		}
+		ASSERT(cache->libraries && cache->libraries->next && !cache->libraries->next->next);
+		objz_setMaterialCache(NULL);
+		objz_destroyMaterialCache(cache);
+		remove(objFilename);
+		remove(mtlFilename);
+		// Shared by loads on different threads.
+		for (uint32_t numWorkers = 1; numWorkers <= 8; numWorkers *= 2) {
+			MaterialCacheTaskData data;
+			data.cache = objz_createMaterialCache(NULL);
+			runTasks(&s_defaultContext, materialCacheTask, &data, OBJZ_RAW_ARRAY_LEN(data.loaded), numWorkers);
+			bool loaded = true;
+			for (uint32_t i = 0; i < OBJZ_RAW_ARRAY_LEN(data.loaded); i++)
+				loaded = loaded && data.loaded[i];
+			ASSERT(loaded);
+			objz_destroyMaterialCache(data.cache);
+		}
+	}
+	{
+		printf("material index\n");
+		const uint32_t numMaterials = 33000; // More than INT16_MAX.
+		char *mtl = malloc(numMaterials * 32 + 256);
+		size_t length = 0;
+		for (uint32_t i = 0; i < numMaterials; i++)
+			length += sprintf(&mtl[length], "newmtl Mat%u\n", i);
+		length += sprintf(&mtl[length], "newmtl mat7\nnewmtl %s\n", "a_name_longer_than_OBJZ_NAME_MAX_is_truncated_so_usemtl_never_matches_it");
+		char *obj = malloc(numMaterials * 40 + 1024);
+		length = sprintf(obj, "mtllib a.mtl\nmtllib A.MTL\nv 0 0 0\n");
+		for (uint32_t i = 0; i < numMaterials; i++)
+			length += sprintf(&obj[length], "o %u\nusemtl %s%u\nf 1 1 1\n", i, i & 1 ? "MAT" : "mat", numMaterials - 1 - i);
+		length += sprintf(&obj[length], "o a\nusemtl missing\nf 1 1 1\no b\nusemtl %s\nf 1 1 1\n", "a_name_longer_than_OBJZ_NAME_MAX_is_truncated_so_usemtl_never_matches_it");
+		objzModel *model = objz_loadFromMemory(obj, length, resolveUserDataMtllib, mtl);
+		ASSERT(model && model->numMaterials == numMaterials + 2); // The library is only loaded once.
+		if (model) {
+			bool matched = true;
+			for (uint32_t i = 0; i < numMaterials; i++)
+				matched = matched && model->meshes[model->objects[i].firstMesh].materialIndex == (int32_t)(numMaterials - 1 - i); // The first 'mat7', not the duplicate.
+			ASSERT(matched);
+			ASSERT(model->meshes[model->objects[numMaterials].firstMesh].materialIndex == -1);
+			ASSERT(model->meshes[model->objects[numMaterials + 1].firstMesh].materialIndex == -1);
+		}
+		objz_destroy(model);
+		// One object, with every material used in turn: one mesh per material.
+		length = sprintf(obj, "mtllib a.mtl\nv 0 0 0\n");
+		for (uint32_t i = 0; i < numMaterials; i++)
+			length += sprintf(&obj[length], "usemtl Mat%u\nf 1 1 1\n", numMaterials - 1 - i);
+		model = objz_loadFromMemory(obj, length, resolveUserDataMtllib, mtl);
+		ASSERT(model && model->numMeshes == numMaterials);
+		if (model) {
+			bool matched = true;
+			for (uint32_t i = 0; i < numMaterials; i++)
+				matched = matched && model->meshes[i].materialIndex == (int32_t)i;
+			ASSERT(matched);
+		}
+		objz_destroy(model);
+		free(obj);
+		free(mtl);
+		// More than UINT16_MAX distinct usemtl names before the last one.
+		obj = malloc(UINT16_MAX * 24 + 1024);
+		length = sprintf(obj, "mtllib a.mtl\nv 0 0 0\nusemtl blue\n");
+		for (uint32_t i = 0; i < UINT16_MAX; i++)
+			length += sprintf(&obj[length], "usemtl missing%u\n", i);
+		length += sprintf(&obj[length], "usemtl red\nf 1 1 1\n");
+		model = objz_loadFromMemory(obj, length, resolveUserDataMtllib, "newmtl red\nKd 1 0 0\nnewmtl blue\nKd 0 0 1\n");
+		ASSERT(model && model->numMeshes == 1 && model->meshes[0].materialIndex == 0 && strcmp(model->materials[0].name, "red") == 0);
+		objz_destroy(model);
+		free(obj);
+	}
+	{
+		printf("material library threads\n");
+		char files[16][64];
+		char obj[4096];
+		size_t length = sprintf(obj, "v 0 0 0\no before\nusemtl m3\nf 1 1 1\n");
+		for (int i = 0; i < 12; i++)
+			length += sprintf(&obj[length], "mtllib lib%d.mtl\no o%d\nusemtl m%d\nf 1 1 1\nusemtl shared\nf 1 1 1\nusemtl m%d\nf 1 1 1\n", i, i, i, i + 1);
+		length += sprintf(&obj[length], "mtllib missing.mtl\n");
+		objzModel *models[2];
+		char errors[2][OBJZ_MAX_ERROR_LENGTH];
+		for (uint32_t i = 0; i < 2; i++) {
+			objzContext *ctx = objz_createContext(NULL);
+			objz_setNumThreadsEx(ctx, i == 0 ? 1 : 4);
+			models[i] = objz_loadFromMemoryEx(ctx, obj, length, resolveNumberedMtllib, files);
+			strcpy(errors[i], objz_getErrorEx(ctx) ? objz_getErrorEx(ctx) : "");
+			if (i == 1)
+				ASSERT(models[0] && models[1] && models[1]->numMaterials == models[0]->numMaterials && memcmp(models[1]->materials, models[0]->materials, sizeof(objzMaterial) * models[0]->numMaterials) == 0 && models[1]->numMeshes == models[0]->numMeshes && memcmp(models[1]->meshes, models[0]->meshes, sizeof(objzMesh) * models[0]->numMeshes) == 0 && strcmp(errors[1], errors[0]) == 0);
+			// Errors in material files fail the load, on any thread.
+			const char *badObj = "v 0 0 0\nmtllib bad.mtl\nf 1 1 1\n";
+			ASSERT(!objz_loadFromMemoryEx(ctx, badObj, strlen(badObj), resolveNumberedMtllib, files) && objz_getErrorEx(ctx));
+			objz_destroyContext(ctx);
+		}
+		ASSERT(strstr(errors[0], "missing.mtl"));
+		// Only materials from earlier libraries match, the first 'shared' is in lib0. Meshes are sorted by material.
+		const int32_t expected[] = { -1, -1, 0, 1, -1, 1, 2 };
+		for (uint32_t i = 0; i < OBJZ_RAW_ARRAY_LEN(expected); i++)
+			ASSERT(models[0]->meshes[i].materialIndex == expected[i]);
+		objz_destroy(models[0]);
+		objz_destroy(models[1]);
+	}
+	{
+		printf("loadBatch\n");
+		char objs[16][1024];
+		objzBatchFile files[18];
+		memset(files, 0, sizeof(files));
+		for (uint32_t i = 0; i < 16; i++) {
+			size_t length = 0;
+			for (uint32_t j = 0; j <= i; j++)
+				length += sprintf(&objs[i][length], "v %u 0 0\nv 0 %u 0\nv 0 0 1\nf -3 -2 -1\n", j, i);
+			files[i].data = objs[i];
+			files[i].size = length;
+		}
+		files[3].resolve = resolveTestMtllib;
+		sprintf(objs[3], "mtllib test.mtl\nv 0 0 0\nusemtl red\nf 1 1 1\n");
+		files[3].size = strlen(objs[3]);
+		sprintf(objs[5], "mtllib test.mtl\nv 0 0 0\nf 1 1 1\n"); // No resolve function: a warning.
+		files[5].size = strlen(objs[5]);
+		sprintf(objs[7], "v 0 0 0\nf 1 1\n"); // An error.
+		files[7].size = strlen(objs[7]);
+		sprintf(objs[11], "v 0 0 0\nf 1 2 3\n"); // Out of range positions are zero.
+		files[11].size = strlen(objs[11]);
+		const char *filename = "objzero_test_batch.obj";
+		FILE *file = fopen(filename, "wb");
+		fputs(objs[9], file);
+		fclose(file);
+		files[16].filename = filename;
+		files[17].filename = "objzero_test_batch_missing.obj";
+		for (uint32_t numThreads = 1; numThreads <= 8; numThreads *= 2) {
+			ASSERT(objz_loadBatch(files, OBJZ_RAW_ARRAY_LEN(files), numThreads) == 16);
+			for (uint32_t i = 0; i < OBJZ_RAW_ARRAY_LEN(files); i++) {
+				const objzBatchFile *f = &files[i];
+				objzModel *model = f->filename ? objz_load(f->filename) : objz_loadFromMemory(f->data, f->size, f->resolve, f->userData);
+				const char *error = objz_getError();
+				ASSERT((f->model != NULL) == (model != NULL) && (f->error != NULL) == (error != NULL) && (!error || strcmp(f->error, error) == 0));
+				if (f->model && model)
+					ASSERT(f->model->numMaterials == model->numMaterials && f->model->numVertices == model->numVertices && memcmp(f->model->vertices, model->vertices, model->numVertices * sizeof(float) * 8) == 0 && f->model->numIndices == model->numIndices && memcmp(f->model->indices, model->indices, model->numIndices * sizeof(uint16_t)) == 0);
+				objz_destroy(model);
+			}
+			ASSERT(files[3].model && files[3].model->numMaterials == 1 && !files[3].error);
+			ASSERT(files[5].model && files[5].error && files[7].error && files[17].error);
+			objz_destroyBatch(files, OBJZ_RAW_ARRAY_LEN(files));
+			ASSERT(!files[0].model && !files[5].error);
+		}
+		// The worker contexts and their arenas are kept for the next batch. One thread: countingRealloc isn't thread-safe.
+		objzContext *ctx = objz_createContext(countingRealloc);
+		uint32_t numAllocations[2];
+		for (int i = 0; i < 2; i++) {
+			s_numAllocations = 0;
+			ASSERT(objz_loadBatchEx(ctx, files, 16, 1) == 15);
+			numAllocations[i] = s_numAllocations;
+			objz_destroyBatchEx(ctx, files, 16);
+		}
+		ASSERT(ctx->numBatchWorkers == 1 && numAllocations[1] < numAllocations[0]);
+		objz_destroyContext(ctx);
+		remove(filename);
+	}
+	{
+		printf("loadAsync\n");
+		// 8 objects in smoothing group 1, so post-processing generates normals.
+		const uint32_t gridSize = 200;
+		char *obj = malloc(gridSize * gridSize * 64 + 1024);
+		size_t length = sprintf(obj, "s 1\n");
+		for (uint32_t y = 0; y <= gridSize; y++) {
+			for (uint32_t x = 0; x <= gridSize; x++)
+				length += sprintf(&obj[length], "v %u %u %u\n", x, y, (x * y) % 7);
+		}
+		for (uint32_t y = 0; y < gridSize; y++) {
+			if (y % (gridSize / 8) == 0)
+				length += sprintf(&obj[length], "o %u\n", y);
+			for (uint32_t x = 0; x < gridSize; x++) {
+				const uint32_t a = y * (gridSize + 1) + x + 1;
+				length += sprintf(&obj[length], "f %u %u %u %u\n", a, a + 1, a + gridSize + 2, a + gridSize + 1);
+			}
+		}
+		const char *filename = "objzero_test_async.obj";
+		FILE *file = fopen(filename, "wb");
+		fwrite(obj, 1, length, file);
+		fclose(file);
+		objzContext *ctx = objz_createContext(NULL);
+		objzModel *expected = objz_loadEx(ctx, filename);
+		ASSERT(expected && expected->numObjects == 8 && !(expected->flags & OBJZ_FLAG_INDEX32));
+		for (uint32_t numThreads = 1; numThreads <= 4; numThreads *= 4) {
+			objz_setNumThreadsEx(ctx, numThreads);
+			AsyncLoadResult result = { NULL, 0 };
+			objzAsyncLoad *load = objz_loadAsyncEx(ctx, filename, asyncLoadCallback, &result);
+			objzModel *model = objz_asyncLoadWait(load);
+			ASSERT(objz_asyncLoadPoll(load) && result.numCalls == 1 && result.model == model);
+			ASSERT(model && expected && model->numVertices == expected->numVertices && memcmp(model->vertices, expected->vertices, expected->numVertices * sizeof(float) * 8) == 0 && model->numIndices == expected->numIndices && memcmp(model->indices, expected->indices, expected->numIndices * sizeof(uint16_t)) == 0);
+			objz_destroyAsyncLoad(load);
+			objz_destroyEx(ctx, model);
+			// Destroying the handle without waiting cancels the load, and destroys the model if it finished first.
+			objz_destroyAsyncLoad(objz_loadAsyncEx(ctx, filename, NULL, NULL));
+			load = objz_loadAsyncEx(ctx, filename, NULL, NULL);
+			objz_asyncLoadCancel(load);
+			model = objz_asyncLoadWait(load);
+			ASSERT(model || strcmp(objz_getErrorEx(ctx), "Load cancelled") == 0);
+			objz_destroyAsyncLoad(load);
+			objz_destroyEx(ctx, model);
+			// Cancelled while reading, parsing, generating normals and building the objects.
+			objz_setProgressEx(ctx, cancelProgress);
+			const int percents[] = { 0, 50, 60, 75, 80 };
+			for (uint32_t i = 0; i < OBJZ_RAW_ARRAY_LEN(percents); i++) {
+				s_cancelFlag = 0;
+				s_cancelPercent = percents[i];
+				ctx->cancel = &s_cancelFlag;
+				model = objz_loadEx(ctx, filename);
+				ASSERT(!model && strcmp(objz_getErrorEx(ctx), "Load cancelled") == 0);
+				model = objz_loadFromMemoryEx(ctx, obj, length, NULL, NULL);
+				ASSERT(!model && strcmp(objz_getErrorEx(ctx), "Load cancelled") == 0);
+			}
+			ctx->cancel = NULL;
+			objz_setProgressEx(ctx, NULL);
+		}
+#if OBJZ_THREADS
+		// One async load at a time on a context. The first is held at 0% until the second has been rejected.
+		s_holdFlag = 1;
+		objz_setProgressEx(ctx, holdProgress);
+		objzAsyncLoad *load = objz_loadAsyncEx(ctx, filename, NULL, NULL);
+		ASSERT(load && !objz_loadAsyncEx(ctx, filename, NULL, NULL));
+		atomicFlagClear(&s_holdFlag);
+		objzModel *model = objz_asyncLoadWait(load);
+		objz_setProgressEx(ctx, NULL);
+		ASSERT(model && model->numIndices == expected->numIndices);
+		objz_destroyAsyncLoad(load);
+		objz_destroyEx(ctx, model);
+		// Finished, so another can start. Errors are copied to the context.
+		load = objz_loadAsyncEx(ctx, "objzero_test_missing.obj", NULL, NULL);
+		ASSERT(load && !objz_asyncLoadWait(load) && objz_getErrorEx(ctx)[0]);
+		objz_destroyAsyncLoad(load);
+#endif
+		objz_destroyEx(ctx, expected);
+		objz_destroyContext(ctx);
+		remove(filename);
+		free(obj);
+	}
+	{
+		printf("optimizeVertexCache\n");
+		// Two objects, the top and bottom of a grid of quads, in a random order. Quads on the left and right have different materials.
+		const uint32_t gridSize = 64;
+		char *obj = malloc(gridSize * gridSize * 64 + 1024);
+		size_t length = sprintf(obj, "mtllib test2.mtl\n");
+		for (uint32_t y = 0; y <= gridSize; y++) {
+			for (uint32_t x = 0; x <= gridSize; x++)
+				length += sprintf(&obj[length], "v %u %u 0\n", x, y);
+		}
+		const uint32_t numObjectQuads = gridSize * gridSize / 2;
+		uint32_t *quads = malloc(sizeof(uint32_t) * numObjectQuads);
+		uint32_t random = 1;
+		for (uint32_t o = 0; o < 2; o++) {
+			for (uint32_t i = 0; i < numObjectQuads; i++)
+				quads[i] = o * numObjectQuads + i;
+			for (uint32_t i = numObjectQuads - 1; i > 0; i--) {
+				random = random * 1664525 + 1013904223;
+				const uint32_t j = (random >> 8) % (i + 1), swap = quads[i];
+				quads[i] = quads[j];
+				quads[j] = swap;
+			}
+			length += sprintf(&obj[length], "o %u\n", o);
+			for (uint32_t i = 0; i < numObjectQuads; i++) {
+				const uint32_t x = quads[i] % gridSize, a = quads[i] / gridSize * (gridSize + 1) + x + 1;
+				length += sprintf(&obj[length], "usemtl %s\nf %u %u %u %u\n", x < gridSize / 2 ? "a" : "b", a, a + 1, a + gridSize + 2, a + gridSize + 1);
+			}
+		}
+		for (uint32_t format = OBJZ_INDEX_FORMAT_AUTO; format <= OBJZ_INDEX_FORMAT_U32; format++) {
+			objzContext *ctx = objz_createContext(NULL);
+			objz_setIndexFormatEx(ctx, format);
+			objz_setNumThreadsEx(ctx, 2);
+			objzModel *model = objz_loadFromMemoryEx(ctx, obj, length, resolveTestMtllib, NULL);
+			objzModel *original = objz_loadFromMemoryEx(ctx, obj, length, resolveTestMtllib, NULL);
+			ASSERT(model && original && model->numObjects == 2 && model->numMeshes == 4);
+			const float before = objz_getACMREx(ctx, model, 16);
+			objz_optimizeVertexCacheEx(ctx, model, 16);
+			const float after = objz_getACMREx(ctx, model, 16);
+			ASSERT(before > 1.5f && after < 0.8f);
+			// The index width is in the model flags: the default context, with OBJZ_INDEX_FORMAT_AUTO, gives the same results.
+			const bool index32 = format == OBJZ_INDEX_FORMAT_U32;
+			ASSERT(((model->flags & OBJZ_FLAG_INDEX32) != 0) == index32);
+			objzModel *plain = objz_loadFromMemoryEx(ctx, obj, length, resolveTestMtllib, NULL);
+			ASSERT(plain && objz_getACMR(plain, 16) == before);
+			objz_optimizeVertexCache(plain, 16);
+			ASSERT(plain && objz_getACMR(plain, 16) == after && memcmp(plain->indices, model->indices, model->numIndices * (index32 ? sizeof(uint32_t) : sizeof(uint16_t))) == 0);
+			objz_destroyEx(ctx, plain);
+			// The same triangles in each mesh, and the same meshes and objects.
+			ASSERT(memcmp(model->meshes, original->meshes, sizeof(objzMesh) * model->numMeshes) == 0);
+			for (uint32_t i = 0; i < model->numObjects; i++)
+				ASSERT(model->objects[i].firstIndex == original->objects[i].firstIndex && model->objects[i].numIndices == original->objects[i].numIndices && model->objects[i].firstVertex == original->objects[i].firstVertex && model->objects[i].numVertices == original->objects[i].numVertices);
+			ASSERT(memcmp(model->indices, original->indices, model->numIndices * (index32 ? sizeof(uint32_t) : sizeof(uint16_t))) != 0);
+			for (uint32_t i = 0; i < model->numMeshes; i++) {
+				uint32_t *triangles = sortedMeshTriangles(model, &model->meshes[i], index32);
+				uint32_t *originalTriangles = sortedMeshTriangles(original, &original->meshes[i], index32);
+				ASSERT(memcmp(triangles, originalTriangles, sizeof(uint32_t) * model->meshes[i].numIndices) == 0);
+				free(triangles);
+				free(originalTriangles);
+			}
+			objz_destroyEx(ctx, model);
+			objz_destroyEx(ctx, original);
+			objz_destroyContext(ctx);
+		}
+		free(quads);
+		free(obj);
+	}
 	printf("Done\n");
 	return 0;
 }